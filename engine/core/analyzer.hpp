@@ -0,0 +1,188 @@
+#ifndef CORE_ANALYZER_HPP
+#define CORE_ANALYZER_HPP
+
+#include "rope.hpp"
+#include "thread_pool.hpp"
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <stop_token>
+
+namespace rope {
+
+// the versions of a buffer are numbered from 1 as analyzer_t::update() sees them change, 0 is no version
+using analysis_version_t = uint64_t;
+
+template <typename rope_type>
+class analyzer_t;
+
+// a pass registered with analyzer_t, a function run on a worker thread over an immutable snapshot of the buffer
+// a pass only ever has one run in flight, a newer snapshot arriving stops the run (through the stop token it is given, it should
+// check it every chunk or so) and the run starts over on the newest one once it returns, so a slow pass never queues up behind
+// fast typing
+// the results go through 2 slots, the worker fills the finished one and analyzer_t::publish() moves it to the published one on the
+// ui thread, so what the ui reads only changes between frames and is never half written
+template <typename rope_type, typename result_t>
+class analysis_pass_t {
+public:
+    using snapshot_t = typename rope_type::snapshot_t;
+    using function_t = std::function<result_t(const snapshot_t&, std::stop_token)>;
+
+    explicit analysis_pass_t(function_t function) : _function(std::move(function)) {}
+
+    // ui thread, nullptr till the first run is published
+    const result_t *result() const { return _published.get(); }
+    // the version result() was computed for, behind analyzer_t::version() while a newer run is on its way
+    analysis_version_t version() const { return _published_version; }
+
+private:
+    friend class analyzer_t<rope_type>;
+
+    struct pending_t {
+        snapshot_t snapshot;
+        analysis_version_t version;
+    };
+
+    // the analysis_pass_t is kept alive by its runs, so the analyzer (and its pool) can go away while a run is stopping
+    static void start(const std::shared_ptr<analysis_pass_t>& pass, core::thread_pool_t& pool, const snapshot_t& snapshot, analysis_version_t version) {
+        std::lock_guard<std::mutex> lock(pass->_mutex);
+        pass->_pending.emplace(pending_t{ snapshot, version });
+        pass->_stop.request_stop();
+        if (pass->_in_flight) return;
+        pass->_in_flight = true;
+        pool.submit([pass] { pass->run(); });
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.reset();
+        _stop.request_stop();
+    }
+
+    void run() {
+        while (true) {
+            std::optional<pending_t> pending;
+            std::stop_token stop;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_pending) {
+                    _in_flight = false;
+                    return;
+                }
+                pending.swap(_pending);
+                _stop = std::stop_source{};
+                stop = _stop.get_token();
+            }
+            auto result = std::make_shared<const result_t>(_function(pending->snapshot, stop));
+            // stopped runs are thrown away, the result can be anything
+            if (stop.stop_requested()) continue;
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished = std::move(result);
+            _finished_version = pending->version;
+        }
+    }
+
+    // doesnt wait for the worker, if it is storing a result right now that result is published next frame
+    bool publish() {
+        std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !_finished) return false;
+        _published = std::move(_finished);
+        _published_version = _finished_version;
+        return true;
+    }
+
+    function_t _function;
+    std::mutex _mutex;  // everything from here to _published
+    std::optional<pending_t> _pending;  // the snapshot the next run takes
+    std::stop_source _stop;  // of the run in flight
+    bool _in_flight = false;
+    std::shared_ptr<const result_t> _finished;
+    analysis_version_t _finished_version = 0;
+    // only touched by the ui thread
+    std::shared_ptr<const result_t> _published;
+    analysis_version_t _published_version = 0;
+};
+
+// the analysis passes of a buffer (highlighting, word count, bracket matching, search), run off the ui thread
+// the ui thread calls update() and publish() once a frame, neither of them waits on a worker: update() takes a snapshot if the text
+// changed and hands it to every pass, which stops whatever run it has in flight, publish() makes the runs that finished visible
+template <typename rope_type>
+class analyzer_t {
+public:
+    using snapshot_t = typename rope_type::snapshot_t;
+
+    explicit analyzer_t(core::thread_pool_t& pool) : _pool(pool) {}
+
+    // stops the runs in flight, they finish on their own but nothing they produce is published
+    ~analyzer_t() {
+        for (const auto& pass : _passes) pass->stop();
+    }
+
+    analyzer_t(const analyzer_t&) = delete;
+    analyzer_t& operator=(const analyzer_t&) = delete;
+
+    // function(snapshot, stop_token) -> result_t, runs on the current snapshot right away if there is one
+    template <typename result_t, typename function_t>
+    std::shared_ptr<analysis_pass_t<rope_type, result_t>> add(function_t&& function) {
+        using pass_t = analysis_pass_t<rope_type, result_t>;
+        auto pass = std::make_shared<pass_t>(typename pass_t::function_t(std::forward<function_t>(function)));
+        _passes.push_back(std::make_unique<pass_slot_t<result_t>>(pass));
+        if (_snapshot) pass_t::start(pass, _pool, *_snapshot, _version);
+        return pass;
+    }
+
+    // restarts every pass on a snapshot of rope if its text changed since the last one, returns true if it did
+    // O(1) while the rope isnt edited (it still shares its root with the snapshot), see rope_t::equals() for the cost after an edit
+    bool update(const rope_type& rope) {
+        if (_snapshot && rope.equals(*_snapshot)) return false;
+        _snapshot = rope.snapshot();
+        _version++;
+        for (const auto& pass : _passes) pass->start(_pool, *_snapshot, _version);
+        return true;
+    }
+
+    // once a frame on the ui thread, returns how many passes got a new result
+    size_t publish() {
+        size_t published = 0;
+        for (const auto& pass : _passes) published += pass->publish();
+        return published;
+    }
+
+    // the version of the last snapshot handed to the passes
+    analysis_version_t version() const { return _version; }
+
+private:
+    // the passes without their result type
+    struct slot_t {
+        virtual ~slot_t() = default;
+        virtual void start(core::thread_pool_t& pool, const snapshot_t& snapshot, analysis_version_t version) = 0;
+        virtual void stop() = 0;
+        virtual bool publish() = 0;
+    };
+
+    template <typename result_t>
+    struct pass_slot_t : slot_t {
+        using pass_t = analysis_pass_t<rope_type, result_t>;
+
+        explicit pass_slot_t(std::shared_ptr<pass_t> pass) : pass(std::move(pass)) {}
+
+        void start(core::thread_pool_t& pool, const snapshot_t& snapshot, analysis_version_t version) override { pass_t::start(pass, pool, snapshot, version); }
+        void stop() override { pass->stop(); }
+        bool publish() override { return pass->publish(); }
+
+        std::shared_ptr<pass_t> pass;
+    };
+
+    core::thread_pool_t& _pool;
+    std::vector<std::unique_ptr<slot_t>> _passes;
+    std::optional<snapshot_t> _snapshot;
+    analysis_version_t _version = 0;
+};
+
+} // namespace rope
+
+#endif
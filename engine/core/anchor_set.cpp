@@ -0,0 +1,184 @@
+#include "anchor_set.hpp"
+
+#include <algorithm>
+
+namespace rope {
+
+anchor_set_t::anchor_id_t anchor_set_t::insert(size_t offset, gravity_t gravity) {
+    anchor_id_t anchor;
+    if (!_free.empty()) {
+        anchor = _free.back();
+        _free.pop_back();
+    } else {
+        anchor = anchor_id_t(_nodes.size());
+        assert(anchor != nil);  // overflow
+        _nodes.emplace_back();
+    }
+    _random ^= _random << 13;
+    _random ^= _random >> 7;
+    _random ^= _random << 17;
+    _nodes[anchor].priority = uint32_t(_random >> 32);
+    _nodes[anchor].gravity = gravity;
+    link(anchor, offset);
+    _size++;
+    return anchor;
+}
+
+void anchor_set_t::erase(anchor_id_t anchor) {
+    unlink(anchor);
+    _free.push_back(anchor);
+    _size--;
+}
+
+void anchor_set_t::move(anchor_id_t anchor, size_t offset) {
+    unlink(anchor);
+    link(anchor, offset);
+}
+
+size_t anchor_set_t::offset(anchor_id_t anchor) const {
+    size_t offset = _nodes[anchor].offset;
+    for (anchor_id_t t = anchor; t != nil; t = _nodes[t].parent) offset += _nodes[t].shift;
+    return offset;
+}
+
+void anchor_set_t::edit(size_t pos, size_t n, size_t size) {
+    if (_root == nil) return;
+    // the anchors from (pos + n, right) on are shifted, along the walk down to the first of them, the nodes where the walk goes
+    // left are shifted with their right subtree
+    _stack.clear();
+    anchor_id_t previous = nil;  // the last anchor before (pos + n, right)
+    for (anchor_id_t t = _root; t != nil;) {
+        push(t);
+        if (!less(t, pos + n, gravity_t::right)) {
+            _stack.push_back(t);
+            t = _nodes[t].left;
+        } else {
+            previous = t;
+            t = _nodes[t].right;
+        }
+    }
+    // nothing from (pos, right) to (pos + n, left), always the case for an insert, so typing is just that walk
+    if (previous == nil || less(previous, pos, gravity_t::right)) {
+        for (anchor_id_t t : _stack) {
+            _nodes[t].offset += size - n;
+            if (_nodes[t].right != nil) _nodes[_nodes[t].right].shift += size - n;
+        }
+        return;
+    }
+    auto [before, rest] = split(_root, pos, gravity_t::right);
+    auto [landed, after] = split(rest, pos + n, gravity_t::right);
+    if (after != nil) _nodes[after].shift += size - n;
+    set_root(merge(merge(before, regroup(landed, pos, n, size)), after));
+}
+
+void anchor_set_t::push(anchor_id_t t) {
+    node_t& node = _nodes[t];
+    if (!node.shift) return;
+    node.offset += node.shift;
+    if (node.left != nil) _nodes[node.left].shift += node.shift;
+    if (node.right != nil) _nodes[node.right].shift += node.shift;
+    node.shift = 0;
+}
+
+void anchor_set_t::push_path(anchor_id_t t) {
+    _stack.clear();
+    for (; t != nil; t = _nodes[t].parent) _stack.push_back(t);
+    for (auto itr = _stack.rbegin(); itr != _stack.rend(); ++itr) push(*itr);
+}
+
+void anchor_set_t::set_left(anchor_id_t t, anchor_id_t child) {
+    _nodes[t].left = child;
+    if (child != nil) _nodes[child].parent = t;
+}
+
+void anchor_set_t::set_right(anchor_id_t t, anchor_id_t child) {
+    _nodes[t].right = child;
+    if (child != nil) _nodes[child].parent = t;
+}
+
+void anchor_set_t::set_root(anchor_id_t t) {
+    _root = t;
+    if (t != nil) _nodes[t].parent = nil;
+}
+
+std::pair<anchor_set_t::anchor_id_t, anchor_set_t::anchor_id_t> anchor_set_t::split(anchor_id_t t, size_t offset, gravity_t gravity) {
+    if (t == nil) return { nil, nil };
+    push(t);
+    if (less(t, offset, gravity)) {
+        auto [left, right] = split(_nodes[t].right, offset, gravity);
+        set_right(t, left);
+        return { t, right };
+    }
+    auto [left, right] = split(_nodes[t].left, offset, gravity);
+    set_left(t, right);
+    return { left, t };
+}
+
+anchor_set_t::anchor_id_t anchor_set_t::merge(anchor_id_t a, anchor_id_t b) {
+    if (a == nil) return b;
+    if (b == nil) return a;
+    if (_nodes[a].priority > _nodes[b].priority) {
+        push(a);
+        set_right(a, merge(_nodes[a].right, b));
+        return a;
+    }
+    push(b);
+    set_left(b, merge(a, _nodes[b].left));
+    return b;
+}
+
+void anchor_set_t::link(anchor_id_t anchor, size_t offset) {
+    node_t& node = _nodes[anchor];
+    node.offset = offset;
+    node.shift = 0;
+    node.left = node.right = nil;
+    auto [before, after] = split(_root, offset, node.gravity);
+    set_root(merge(merge(before, anchor), after));
+}
+
+void anchor_set_t::unlink(anchor_id_t anchor) {
+    push_path(anchor);
+    node_t& node = _nodes[anchor];
+    anchor_id_t parent = node.parent, children = merge(node.left, node.right);
+    if (parent == nil) set_root(children);
+    else if (_nodes[parent].left == anchor) set_left(parent, children);
+    else set_right(parent, children);
+    node.parent = nil;
+}
+
+anchor_set_t::anchor_id_t anchor_set_t::regroup(anchor_id_t t, size_t pos, size_t n, size_t size) {
+    _scratch.clear();
+    collect(t);
+    for (anchor_id_t anchor : _scratch) {
+        node_t& node = _nodes[anchor];
+        // (pos, right) stays before the replaced range and (pos + n, left) after it, gravity decides for the ones inside
+        if (node.offset == pos + n) node.offset = pos + size;
+        else if (node.offset != pos) node.offset = node.gravity == gravity_t::left ? pos : pos + size;
+    }
+    std::stable_sort(_scratch.begin(), _scratch.end(), [this](anchor_id_t a, anchor_id_t b) { return less(a, _nodes[b].offset, _nodes[b].gravity); });
+    // the order is known, so the treap is built in one pass (a cartesian tree on the priorities) instead of n inserts
+    _stack.clear();
+    for (anchor_id_t anchor : _scratch) {
+        node_t& node = _nodes[anchor];
+        node.right = nil;
+        anchor_id_t last = nil;
+        while (!_stack.empty() && _nodes[_stack.back()].priority < node.priority) {
+            last = _stack.back();
+            _stack.pop_back();
+        }
+        set_left(anchor, last);
+        if (!_stack.empty()) set_right(_stack.back(), anchor);
+        _stack.push_back(anchor);
+    }
+    return _stack.front();
+}
+
+void anchor_set_t::collect(anchor_id_t t) {
+    if (t == nil) return;
+    push(t);
+    collect(_nodes[t].left);
+    _scratch.push_back(t);
+    collect(_nodes[t].right);
+}
+
+} // namespace rope
@@ -0,0 +1,116 @@
+#ifndef CORE_ANCHOR_SET_HPP
+#define CORE_ANCHOR_SET_HPP
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <utility>
+
+namespace rope {
+
+// offsets into a rope (carets, selection ends, bookmarks, diagnostics) that follow the text through edits
+// kept next to the rope like undo_tree_t, every edit made to the rope has to be passed to edit() (or apply()) as well
+// the anchors are a treap ordered by (offset, gravity) where a node only holds part of its offset, the rest is a shift pending on
+// it and its ancestors, so an edit shifts every anchor after it by touching O(log n) nodes, only the anchors a replace lands on
+// are visited one by one
+// an anchor exactly at an insert stays before the new text with left gravity and goes after it with right gravity, ex: a caret
+// is right so typing pushes it along, the start of a selection is right and its end left so text typed at either edge stays
+// outside of it
+// anchors strictly inside a replaced range do the same, the ones on its edges stay on their side of it
+class anchor_set_t {
+public:
+    using anchor_id_t = uint32_t;
+
+    enum class gravity_t : uint8_t {
+        left,
+        right,
+    };
+
+    // O(log n), ids of erased anchors get reused
+    anchor_id_t insert(size_t offset, gravity_t gravity = gravity_t::left);
+    void erase(anchor_id_t anchor);
+    // O(log n), keeps the id
+    void move(anchor_id_t anchor, size_t offset);
+
+    // O(log n)
+    size_t offset(anchor_id_t anchor) const;
+    gravity_t gravity(anchor_id_t anchor) const { return _nodes[anchor].gravity; }
+
+    // [pos, pos + n) of the text was replaced by size bytes, O(log n + anchors in the replaced range or at the insert)
+    void edit(size_t pos, size_t n, size_t size);
+
+    // the batch handed to rope_t::apply(), sorted and with positions from before any of them, so they are applied back to front
+    template <typename edit_t>
+    void apply(std::span<const edit_t> edits) {
+        for (auto itr = edits.rbegin(); itr != edits.rend(); ++itr) edit(itr->pos, itr->n, itr->text.size());
+    }
+
+    // callback(anchor, offset) for the anchors in [begin, end) in order, ex: the diagnostics on the visible lines
+    template <typename callback_t>
+    void for_each(size_t begin, size_t end, callback_t&& callback) const {
+        for_each_impl(_root, 0, begin, end, callback);
+    }
+
+    size_t size() const { return _size; }
+    size_t memory_usage() const { return _nodes.capacity() * sizeof(node_t) + (_free.capacity() + _scratch.capacity() + _stack.capacity()) * sizeof(anchor_id_t); }
+
+private:
+    static constexpr anchor_id_t nil = ~anchor_id_t{ 0 };
+
+    struct node_t {
+        size_t offset;  // the real offset is this plus the shift of the node and of all its ancestors
+        size_t shift;  // pending for the whole subtree, shifts to the left wrap around
+        anchor_id_t left, right, parent;
+        uint32_t priority;  // max heap
+        gravity_t gravity;
+    };
+
+    // moves the pending shift of t down to its children
+    void push(anchor_id_t t);
+    // every ancestor of t pushed, so the offset of t is exact
+    void push_path(anchor_id_t t);
+    void set_left(anchor_id_t t, anchor_id_t child);
+    void set_right(anchor_id_t t, anchor_id_t child);
+    void set_root(anchor_id_t t);
+
+    bool less(anchor_id_t t, size_t offset, gravity_t gravity) const {
+        return _nodes[t].offset < offset || (_nodes[t].offset == offset && _nodes[t].gravity < gravity);
+    }
+
+    // anchors before (offset, gravity) go to the first tree, the returned roots can still point at their old parents
+    std::pair<anchor_id_t, anchor_id_t> split(anchor_id_t t, size_t offset, gravity_t gravity);
+    // every anchor in a has to come before every anchor in b
+    anchor_id_t merge(anchor_id_t a, anchor_id_t b);
+
+    void link(anchor_id_t anchor, size_t offset);
+    void unlink(anchor_id_t anchor);
+
+    // moves the anchors of t, the ones from (pos, right) to (pos + n, left), to where the edit puts them and rebuilds the tree in
+    // their new order, O(size of t)
+    anchor_id_t regroup(anchor_id_t t, size_t pos, size_t n, size_t size);
+    // in order, pushed on the way so the offsets are exact
+    void collect(anchor_id_t t);
+
+    template <typename callback_t>
+    void for_each_impl(anchor_id_t t, size_t shift, size_t begin, size_t end, callback_t& callback) const {
+        if (t == nil) return;
+        const node_t& node = _nodes[t];
+        shift += node.shift;
+        size_t offset = node.offset + shift;
+        if (offset >= begin) for_each_impl(node.left, shift, begin, end, callback);
+        if (offset >= begin && offset < end) callback(t, offset);
+        if (offset < end) for_each_impl(node.right, shift, begin, end, callback);
+    }
+
+    std::vector<node_t> _nodes;
+    std::vector<anchor_id_t> _free;
+    std::vector<anchor_id_t> _scratch, _stack;  // kept to not allocate on every regroup()
+    anchor_id_t _root = nil;
+    size_t _size = 0;
+    uint64_t _random = 0x9e3779b97f4a7c15;  // xorshift state for the priorities
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,714 @@
+#ifndef CORE_BTREE_ROPE_HPP
+#define CORE_BTREE_ROPE_HPP
+
+#include "rope.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cassert>
+#include <ostream>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace rope {
+
+// b-tree variant of rope_t, internal nodes have FANOUT / 2 to FANOUT children (the root can have less) and all the leaves are at
+// the same depth, so the tree is log(n) / log(FANOUT) deep instead of ~1.44 log2(n)
+// internal nodes dont hold any text, only the count and newlines of every child in compact arrays next to the child pointers, so
+// a descent reads one small node per level and picks the child from the arrays without touching the children
+// leaves are kept atleast half full, edits merge or rebalance a leaf with its neighbour when they drop below that
+// it has the reading and editing api of rope_t (chunks, slice, insert, erase, set_slice, lines), so the searches and the benchmarks
+// can take either, snapshots, cursors, summaries and mapped files are only in rope_t
+// nodes are reference counted and copy on write like in rope_t, copying a rope is O(1) but copies have to stay on one thread
+template <size_t BUFFER_LENGTH, size_t FANOUT = 16, template <typename type> typename allocator = std::allocator>
+class btree_rope_t {
+    static_assert(BUFFER_LENGTH > 0);
+    static_assert(FANOUT >= 4);
+public:
+    struct node_t {
+        size_t refs;
+    };
+
+    struct leaf_t : node_t {
+        size_t count;
+        char text[BUFFER_LENGTH];
+    };
+
+    struct internal_t : node_t {
+        size_t child_count;
+        size_t counts[FANOUT];  // chars in the subtree of each child
+        size_t newlines[FANOUT];
+        node_t *children[FANOUT];
+    };
+
+    // a leaf shorter than this gets merged with (or takes text from) a neighbour, the root is the only leaf allowed to be shorter
+    static constexpr size_t min_leaf_length = BUFFER_LENGTH / 2;
+    static constexpr size_t min_children = FANOUT / 2;
+
+    struct node_pool_t {
+        leaf_t *allocate_leaf() {
+            leaf_t *leaf = leaf_allocator.allocate(1);
+            leaf->refs = 1;
+            leaf->count = 0;
+            leaves++;
+            return leaf;
+        }
+
+        internal_t *allocate_internal() {
+            internal_t *internal = internal_allocator.allocate(1);
+            internal->refs = 1;
+            internal->child_count = 0;
+            internals++;
+            return internal;
+        }
+
+        void deallocate(leaf_t *leaf) {
+            leaves--;
+            leaf_allocator.deallocate(leaf, 1);
+        }
+
+        void deallocate(internal_t *internal) {
+            internals--;
+            internal_allocator.deallocate(internal, 1);
+        }
+
+        size_t memory_usage() const {
+            return leaves * sizeof(leaf_t) + internals * sizeof(internal_t);
+        }
+
+        allocator<leaf_t> leaf_allocator;
+        allocator<internal_t> internal_allocator;
+        size_t leaves = 0;
+        size_t internals = 0;
+    };
+
+    // same as rope_t::chunk_iterator_t, keeps the root to leaf path as (node, child index) pairs
+    class chunk_iterator_t {
+    public:
+        using value_type = std::string_view;
+        using reference = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+
+        static constexpr size_t max_depth = 64;
+
+        chunk_iterator_t() = default;
+
+        // pos == end is the end iterator
+        chunk_iterator_t(const node_t *root_node, size_t height, size_t begin, size_t end, size_t pos) : _root_node(root_node), _height(height), _begin(begin), _end(end) {
+            if (pos < end) descend(pos);
+        }
+
+        std::string_view operator*() const {
+            size_t from = offset(), to = std::min(_end, _leaf_start + _leaf->count);
+            return { _leaf->text + (from - _leaf_start), to - from };
+        }
+
+        size_t offset() const {
+            return std::max(_begin, _leaf_start);
+        }
+
+        chunk_iterator_t& operator++() {
+            assert(_leaf);  // cant go past the end
+            _leaf_start += _leaf->count;
+            if (_leaf_start >= _end) {
+                _leaf = nullptr;
+                return *this;
+            }
+            // climb till a node has a child after the one we came from, then take the leftmost leaf under it
+            size_t level = _height - 1;
+            while (_indices[level - 1] + 1 == _path[level - 1]->child_count) level--;
+            _indices[level - 1]++;
+            leftmost(level);
+            return *this;
+        }
+
+        chunk_iterator_t operator++(int) {
+            chunk_iterator_t itr = *this;
+            ++*this;
+            return itr;
+        }
+
+        chunk_iterator_t& operator--() {
+            if (!_leaf) {
+                assert(_begin < _end);  // cant go before the begining
+                descend(_end - 1);
+                return *this;
+            }
+            assert(_leaf_start > _begin);  // cant go before the begining
+            size_t level = _height - 1;
+            while (!_indices[level - 1]) level--;
+            _indices[level - 1]--;
+            for (; level < _height - 1; level++) {
+                _path[level] = static_cast<const internal_t *>(_path[level - 1]->children[_indices[level - 1]]);
+                _indices[level] = _path[level]->child_count - 1;
+            }
+            _leaf = static_cast<const leaf_t *>(_path[level - 1]->children[_indices[level - 1]]);
+            _leaf_start -= _leaf->count;
+            return *this;
+        }
+
+        chunk_iterator_t operator--(int) {
+            chunk_iterator_t itr = *this;
+            --*this;
+            return itr;
+        }
+
+        bool operator==(const chunk_iterator_t& other) const {
+            return _leaf == other._leaf;
+        }
+
+    private:
+        void descend(size_t pos) {
+            _leaf_start = 0;
+            const node_t *node = _root_node;
+            for (size_t level = 0; level + 1 < _height; level++) {
+                const internal_t *internal = static_cast<const internal_t *>(node);
+                size_t i = 0;
+                while (pos >= internal->counts[i]) {
+                    pos -= internal->counts[i];
+                    _leaf_start += internal->counts[i++];
+                }
+                _path[level] = internal;
+                _indices[level] = i;
+                node = internal->children[i];
+            }
+            _leaf = static_cast<const leaf_t *>(node);
+        }
+
+        // walks down the first children from the child picked at level - 1
+        void leftmost(size_t level) {
+            for (; level < _height - 1; level++) {
+                _path[level] = static_cast<const internal_t *>(_path[level - 1]->children[_indices[level - 1]]);
+                _indices[level] = 0;
+            }
+            _leaf = static_cast<const leaf_t *>(_path[level - 1]->children[_indices[level - 1]]);
+        }
+
+        const node_t *_root_node = nullptr;
+        size_t _height = 0;
+        size_t _begin = 0, _end = 0;
+        size_t _leaf_start = 0;
+        const leaf_t *_leaf = nullptr;  // null is the end iterator
+        const internal_t *_path[max_depth];
+        size_t _indices[max_depth];
+    };
+
+    class chunks_t : public std::ranges::view_interface<chunks_t> {
+    public:
+        chunks_t() = default;
+        chunks_t(const node_t *root_node, size_t height, size_t begin, size_t end) : _root_node(root_node), _height(height), _begin(begin), _end(end) {}
+
+        chunk_iterator_t begin() const { return { _root_node, _height, _begin, _end, _begin }; }
+        chunk_iterator_t end() const { return { _root_node, _height, _begin, _end, _end }; }
+
+    private:
+        const node_t *_root_node = nullptr;
+        size_t _height = 0;
+        size_t _begin = 0, _end = 0;
+    };
+
+    btree_rope_t(const std::string& str) : _node_pool(std::make_shared<node_pool_t>()) {
+        // evenly filled leaves, then evenly filled levels on top of them till there is one node left
+        std::vector<entry_t> entries;
+        size_t leaves = std::max(size_t(1), (str.size() + BUFFER_LENGTH - 1) / BUFFER_LENGTH);
+        entries.reserve(leaves);
+        for (size_t i = 0, pos = 0; i < leaves; i++) {
+            size_t count = str.size() / leaves + (i < str.size() % leaves);
+            entries.push_back(new_leaf(str.data() + pos, count, *_node_pool));
+            pos += count;
+        }
+        _height = 1;
+        for (; entries.size() > 1; _height++) entries = group(entries.data(), entries.size(), nullptr, *_node_pool);
+        _root_node = entries[0].node;
+    }
+
+    // O(1), both ropes share all the nodes until one of them gets edited
+    btree_rope_t(const btree_rope_t& other) : _node_pool(other._node_pool), _root_node(other._root_node), _height(other._height) {
+        _root_node->refs++;
+    }
+
+    btree_rope_t& operator=(btree_rope_t other) {
+        std::swap(_node_pool, other._node_pool);
+        std::swap(_root_node, other._root_node);
+        std::swap(_height, other._height);
+        return *this;
+    }
+
+    ~btree_rope_t() {
+        release(_root_node, _height, *_node_pool);
+    }
+
+    void slice(size_t pos, size_t n, char *o_str) const {
+        for (std::string_view chunk : chunks(pos, n)) {
+            std::memcpy(o_str, chunk.data(), chunk.size());
+            o_str += chunk.size();
+        }
+    }
+
+    void set_slice(const char *str, size_t size, size_t pos, size_t n) {
+        erase(pos, n);
+        insert(str, size, pos);
+    }
+
+    void insert(const char *str, size_t size, size_t pos) {
+        assert(pos <= this->size());  // bounds check
+        if (!size) return;
+        std::vector<entry_t> extra;
+        _root_node = insert_impl(_root_node, _height, str, size, utils::count_newlines(str, size), pos, extra, *_node_pool);
+        // the root split, the tree grows a level (or more for a big insert)
+        while (!extra.empty()) {
+            extra.insert(extra.begin(), entry_t{ _root_node, node_count(_root_node, _height), node_newlines(_root_node, _height) });
+            extra = group(extra.data(), extra.size(), nullptr, *_node_pool);
+            _height++;
+            _root_node = extra[0].node;
+            if (extra.size() == 1) extra.clear();
+            else extra.erase(extra.begin());
+        }
+    }
+
+    void erase(size_t pos, size_t n) {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        if (!n) return;
+        if (n == size()) {
+            release(_root_node, _height, *_node_pool);
+            _root_node = _node_pool->allocate_leaf();
+            _height = 1;
+            return;
+        }
+        size_t newlines = 0;
+        _root_node = erase_impl(_root_node, _height, pos, n, newlines, *_node_pool);
+        // the root is allowed to be underfull, but a root with a single child is just an extra level
+        while (_height > 1 && static_cast<internal_t *>(_root_node)->child_count == 1) {
+            internal_t *root = static_cast<internal_t *>(_root_node);
+            _root_node = root->children[0];
+            if (root->refs == 1) {
+                _node_pool->deallocate(root);
+            } else {
+                _root_node->refs++;
+                root->refs--;
+            }
+            _height--;
+        }
+    }
+
+    chunks_t chunks() const {
+        return chunks(0, size());
+    }
+
+    chunks_t chunks(size_t pos, size_t n) const {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        return { _root_node, _height, pos, pos + n };
+    }
+
+    std::string to_string() const {
+        std::string str;
+        str.resize(size());
+        slice(0, size(), str.data());
+        return str;
+    }
+
+    size_t size() const {
+        return node_count(_root_node, _height);
+    }
+
+    size_t line_count() const {
+        return node_newlines(_root_node, _height) + 1;
+    }
+
+    size_t line_to_offset(size_t line) const {
+        assert(line < line_count());  // bounds check
+        if (!line) return 0;
+        size_t offset = 0;
+        const node_t *node = _root_node;
+        for (size_t height = _height; height > 1; height--) {
+            const internal_t *internal = static_cast<const internal_t *>(node);
+            size_t i = 0;
+            while (line > internal->newlines[i]) {
+                line -= internal->newlines[i];
+                offset += internal->counts[i++];
+            }
+            node = internal->children[i];
+        }
+        const leaf_t *leaf = static_cast<const leaf_t *>(node);
+        return offset + utils::find_newline(leaf->text, leaf->count, line) + 1;
+    }
+
+    size_t offset_to_line(size_t pos) const {
+        assert(pos <= size());  // bounds check
+        size_t line = 0;
+        const node_t *node = _root_node;
+        for (size_t height = _height; height > 1; height--) {
+            const internal_t *internal = static_cast<const internal_t *>(node);
+            size_t i = 0;
+            while (pos > internal->counts[i]) {
+                pos -= internal->counts[i];
+                line += internal->newlines[i++];
+            }
+            node = internal->children[i];
+        }
+        return line + utils::count_newlines(static_cast<const leaf_t *>(node)->text, pos);
+    }
+
+    // height of the tree, a lone leaf is 1
+    size_t depth() const {
+        return _height;
+    }
+
+    // bytes taken by the nodes of this rope and every copy sharing nodes with it
+    size_t memory_usage() const {
+        return _node_pool->memory_usage();
+    }
+
+    // text bytes / bytes allocated for the nodes of this rope, O(nodes)
+    double fill_ratio() const {
+        size_t allocated = 0;
+        usage(_root_node, _height, allocated);
+        return allocated ? double(size()) / double(allocated) : 1.0;
+    }
+
+private:
+    // a child as its parent sees it
+    struct entry_t {
+        node_t *node;
+        size_t count;
+        size_t newlines;
+    };
+
+    static size_t node_count(const node_t *node, size_t height) {
+        if (height == 1) return static_cast<const leaf_t *>(node)->count;
+        const internal_t *internal = static_cast<const internal_t *>(node);
+        size_t count = 0;
+        for (size_t i = 0; i < internal->child_count; i++) count += internal->counts[i];
+        return count;
+    }
+
+    static size_t node_newlines(const node_t *node, size_t height) {
+        if (height == 1) return utils::count_newlines(static_cast<const leaf_t *>(node)->text, static_cast<const leaf_t *>(node)->count);
+        const internal_t *internal = static_cast<const internal_t *>(node);
+        size_t newlines = 0;
+        for (size_t i = 0; i < internal->child_count; i++) newlines += internal->newlines[i];
+        return newlines;
+    }
+
+    static bool underfull(const node_t *node, size_t height) {
+        if (height == 1) return static_cast<const leaf_t *>(node)->count < min_leaf_length;
+        return static_cast<const internal_t *>(node)->child_count < min_children;
+    }
+
+    static void release(node_t *node, size_t height, node_pool_t& node_pool) {
+        if (--node->refs) return;
+        if (height == 1) {
+            node_pool.deallocate(static_cast<leaf_t *>(node));
+            return;
+        }
+        internal_t *internal = static_cast<internal_t *>(node);
+        for (size_t i = 0; i < internal->child_count; i++) release(internal->children[i], height - 1, node_pool);
+        node_pool.deallocate(internal);
+    }
+
+    // copy on write, same as rope_node_t::mutable_node
+    static leaf_t *mutable_leaf(node_t *node, node_pool_t& node_pool) {
+        leaf_t *leaf = static_cast<leaf_t *>(node);
+        if (leaf->refs == 1) return leaf;
+        leaf_t *copy = node_pool.allocate_leaf();
+        copy->count = leaf->count;
+        std::memcpy(copy->text, leaf->text, leaf->count);
+        leaf->refs--;
+        return copy;
+    }
+
+    static internal_t *mutable_internal(node_t *node, node_pool_t& node_pool) {
+        internal_t *internal = static_cast<internal_t *>(node);
+        if (internal->refs == 1) return internal;
+        internal_t *copy = node_pool.allocate_internal();
+        copy->child_count = internal->child_count;
+        std::copy_n(internal->counts, internal->child_count, copy->counts);
+        std::copy_n(internal->newlines, internal->child_count, copy->newlines);
+        std::copy_n(internal->children, internal->child_count, copy->children);
+        for (size_t i = 0; i < copy->child_count; i++) copy->children[i]->refs++;
+        internal->refs--;
+        return copy;
+    }
+
+    static entry_t new_leaf(const char *str, size_t count, node_pool_t& node_pool) {
+        leaf_t *leaf = node_pool.allocate_leaf();
+        leaf->count = count;
+        if (count) std::memcpy(leaf->text, str, count);
+        return { leaf, count, utils::count_newlines(str, count) };
+    }
+
+    // spreads n entries evenly over ceil(n / FANOUT) new internal nodes, first (if not null) is reused for the first of them
+    // every node gets atleast FANOUT / 2 children as long as n > FANOUT
+    static std::vector<entry_t> group(const entry_t *entries, size_t n, internal_t *first, node_pool_t& node_pool) {
+        size_t k = (n + FANOUT - 1) / FANOUT;
+        std::vector<entry_t> groups;
+        groups.reserve(k);
+        for (size_t g = 0; g < k; g++) {
+            internal_t *internal = g || !first ? node_pool.allocate_internal() : first;
+            entry_t group{ internal, 0, 0 };
+            internal->child_count = n / k + (g < n % k);
+            for (size_t i = 0; i < internal->child_count; i++, entries++) {
+                internal->children[i] = entries->node;
+                internal->counts[i] = entries->count;
+                internal->newlines[i] = entries->newlines;
+                group.count += entries->count;
+                group.newlines += entries->newlines;
+            }
+            groups.push_back(group);
+        }
+        return groups;
+    }
+
+    static void remove_child(internal_t *internal, size_t i) {
+        size_t after = internal->child_count - i - 1;
+        std::copy_n(internal->counts + i + 1, after, internal->counts + i);
+        std::copy_n(internal->newlines + i + 1, after, internal->newlines + i);
+        std::copy_n(internal->children + i + 1, after, internal->children + i);
+        internal->child_count--;
+    }
+
+    // inserts into the subtree of node, returns it and appends the nodes that have to go right after it (if it split) to o_extra
+    // newlines is the newline count of str, counts on the way up are fixed with deltas so leaves arent scanned again
+    static node_t *insert_impl(node_t *node, size_t height, const char *str, size_t size, size_t newlines, size_t pos, std::vector<entry_t>& o_extra, node_pool_t& node_pool) {
+        if (height == 1) return insert_leaf(node, str, size, pos, o_extra, node_pool);
+        internal_t *internal = mutable_internal(node, node_pool);
+        // prefer the left child on the boundary, appending to a leaf is preferred over prepending
+        size_t i = 0;
+        while (i + 1 < internal->child_count && pos > internal->counts[i]) pos -= internal->counts[i++];
+        std::vector<entry_t> extra;
+        internal->children[i] = insert_impl(internal->children[i], height - 1, str, size, newlines, pos, extra, node_pool);
+        internal->counts[i] += size;
+        internal->newlines[i] += newlines;
+        if (extra.empty()) return internal;
+        for (const entry_t& entry : extra) {
+            internal->counts[i] -= entry.count;
+            internal->newlines[i] -= entry.newlines;
+        }
+        size_t count = internal->child_count, added = extra.size();
+        if (count + added <= FANOUT) {
+            std::copy_backward(internal->counts + i + 1, internal->counts + count, internal->counts + count + added);
+            std::copy_backward(internal->newlines + i + 1, internal->newlines + count, internal->newlines + count + added);
+            std::copy_backward(internal->children + i + 1, internal->children + count, internal->children + count + added);
+            for (size_t j = 0; j < added; j++) {
+                internal->counts[i + 1 + j] = extra[j].count;
+                internal->newlines[i + 1 + j] = extra[j].newlines;
+                internal->children[i + 1 + j] = extra[j].node;
+            }
+            internal->child_count += added;
+            return internal;
+        }
+        // too many children, split this node evenly too
+        std::vector<entry_t> entries;
+        entries.reserve(count + added);
+        for (size_t j = 0; j < count; j++) {
+            entries.push_back({ internal->children[j], internal->counts[j], internal->newlines[j] });
+            if (j == i) entries.insert(entries.end(), extra.begin(), extra.end());
+        }
+        std::vector<entry_t> groups = group(entries.data(), entries.size(), internal, node_pool);
+        o_extra.insert(o_extra.end(), groups.begin() + 1, groups.end());
+        return internal;
+    }
+
+    static node_t *insert_leaf(node_t *node, const char *str, size_t size, size_t pos, std::vector<entry_t>& o_extra, node_pool_t& node_pool) {
+        leaf_t *leaf = mutable_leaf(node, node_pool);
+        if (leaf->count + size <= BUFFER_LENGTH) {
+            std::memmove(leaf->text + pos + size, leaf->text + pos, leaf->count - pos);
+            std::memcpy(leaf->text + pos, str, size);
+            leaf->count += size;
+            return leaf;
+        }
+        // spread over as few leaves as it fits in, evenly, so none of them is less than half full
+        std::string text;
+        text.reserve(leaf->count + size);
+        text.append(leaf->text, pos).append(str, size).append(leaf->text + pos, leaf->count - pos);
+        size_t k = (text.size() + BUFFER_LENGTH - 1) / BUFFER_LENGTH;
+        leaf->count = text.size() / k + (0 < text.size() % k);
+        std::memcpy(leaf->text, text.data(), leaf->count);
+        for (size_t i = 1, at = leaf->count; i < k; i++) {
+            size_t count = text.size() / k + (i < text.size() % k);
+            o_extra.push_back(new_leaf(text.data() + at, count, node_pool));
+            at += count;
+        }
+        return leaf;
+    }
+
+    // erases [pos, pos + n) from the subtree of node, which has to keep some of its text, adds the newlines erased to o_newlines
+    // the children on the edges of the erased range get merged with their neighbours if they end up underfull, the node itself
+    // can end up underfull, its parent takes care of that
+    static node_t *erase_impl(node_t *node, size_t height, size_t pos, size_t n, size_t& o_newlines, node_pool_t& node_pool) {
+        if (height == 1) {
+            leaf_t *leaf = mutable_leaf(node, node_pool);
+            o_newlines += utils::count_newlines(leaf->text + pos, n);
+            std::memmove(leaf->text + pos, leaf->text + pos + n, leaf->count - pos - n);
+            leaf->count -= n;
+            return leaf;
+        }
+        internal_t *internal = mutable_internal(node, node_pool);
+        size_t first = 0, offset = 0;
+        while (pos >= offset + internal->counts[first]) offset += internal->counts[first++];
+        size_t end = pos + n, last = first;
+        for (; last < internal->child_count && offset < end; last++) {
+            size_t count = internal->counts[last];
+            size_t from = std::max(pos, offset), to = std::min(end, offset + count);
+            if (from == offset && to == offset + count) {
+                o_newlines += internal->newlines[last];
+                release(internal->children[last], height - 1, node_pool);
+                internal->children[last] = nullptr;
+            } else {
+                size_t newlines = 0;
+                internal->children[last] = erase_impl(internal->children[last], height - 1, from - offset, to - from, newlines, node_pool);
+                internal->counts[last] -= to - from;
+                internal->newlines[last] -= newlines;
+                o_newlines += newlines;
+            }
+            offset += count;
+        }
+        // only the first and last child touched can be left, one after the other
+        size_t kept = 0;
+        for (size_t i = last; i-- > first;) {
+            if (internal->children[i]) kept++;
+            else remove_child(internal, i);
+        }
+        if (kept == 2) fix(internal, height, first + 1, node_pool);
+        if (kept) fix(internal, height, first, node_pool);
+        return internal;
+    }
+
+    // merges child i with a neighbour till it isnt underfull anymore, unless it is the only child, then the parent of internal is
+    // underfull and merging that fixes this one too
+    static void fix(internal_t *internal, size_t height, size_t i, node_pool_t& node_pool) {
+        while (i < internal->child_count && internal->child_count > 1 && underfull(internal->children[i], height - 1)) {
+            size_t j = i ? i - 1 : i;
+            if (!merge(internal, height, j, node_pool)) fix(internal, height, j + 1, node_pool);
+            i = j;
+        }
+    }
+
+    // merges children j and j + 1 into one if they fit, returns false if they didnt and got rebalanced instead
+    static bool merge(internal_t *internal, size_t height, size_t j, node_pool_t& node_pool) {
+        size_t count = internal->counts[j] + internal->counts[j + 1], newlines = internal->newlines[j] + internal->newlines[j + 1];
+        if (height - 1 == 1) {
+            leaf_t *a = mutable_leaf(internal->children[j], node_pool), *b = mutable_leaf(internal->children[j + 1], node_pool);
+            internal->children[j] = a;
+            internal->children[j + 1] = b;
+            if (count <= BUFFER_LENGTH) {
+                std::memcpy(a->text + a->count, b->text, b->count);
+                a->count = count;
+                node_pool.deallocate(b);
+                remove_child(internal, j + 1);
+                internal->counts[j] = count;
+                internal->newlines[j] = newlines;
+                return true;
+            }
+            // move text across the seam till both have half
+            size_t half = count / 2;
+            if (a->count < half) {
+                size_t m = half - a->count;
+                std::memcpy(a->text + a->count, b->text, m);
+                std::memmove(b->text, b->text + m, b->count - m);
+                a->count += m;
+                b->count -= m;
+            } else {
+                size_t m = a->count - half;
+                std::memmove(b->text + m, b->text, b->count);
+                std::memcpy(b->text, a->text + half, m);
+                a->count -= m;
+                b->count += m;
+            }
+            internal->counts[j] = a->count;
+            internal->newlines[j] = utils::count_newlines(a->text, a->count);
+            internal->counts[j + 1] = b->count;
+            internal->newlines[j + 1] = newlines - internal->newlines[j];
+            return false;
+        }
+        internal_t *a = mutable_internal(internal->children[j], node_pool), *b = mutable_internal(internal->children[j + 1], node_pool);
+        internal->children[j] = a;
+        internal->children[j + 1] = b;
+        size_t seam = a->child_count, total = a->child_count + b->child_count;
+        if (total <= FANOUT) {
+            std::copy_n(b->counts, b->child_count, a->counts + seam);
+            std::copy_n(b->newlines, b->child_count, a->newlines + seam);
+            std::copy_n(b->children, b->child_count, a->children + seam);
+            a->child_count = total;
+            node_pool.deallocate(b);
+            remove_child(internal, j + 1);
+            internal->counts[j] = count;
+            internal->newlines[j] = newlines;
+            // the underfull grandchild that got a and b here can only be on the seam
+            fix(a, height - 1, seam, node_pool);
+            fix(a, height - 1, seam - 1, node_pool);
+            return true;
+        }
+        size_t half = total / 2;
+        if (seam < half) {
+            size_t m = half - seam;
+            std::copy_n(b->counts, m, a->counts + seam);
+            std::copy_n(b->newlines, m, a->newlines + seam);
+            std::copy_n(b->children, m, a->children + seam);
+            remove_children(b, m);
+        } else {
+            size_t m = seam - half;
+            std::copy_backward(b->counts, b->counts + b->child_count, b->counts + b->child_count + m);
+            std::copy_backward(b->newlines, b->newlines + b->child_count, b->newlines + b->child_count + m);
+            std::copy_backward(b->children, b->children + b->child_count, b->children + b->child_count + m);
+            std::copy_n(a->counts + half, m, b->counts);
+            std::copy_n(a->newlines + half, m, b->newlines);
+            std::copy_n(a->children + half, m, b->children);
+            b->child_count += m;
+        }
+        a->child_count = half;
+        // the seam children are either next to each other in one of them, or one is the last of a and the other the first of b
+        if (seam < half) {
+            fix(a, height - 1, seam, node_pool);
+            fix(a, height - 1, seam - 1, node_pool);
+        } else if (seam > half) {
+            fix(b, height - 1, seam - half, node_pool);
+            fix(b, height - 1, seam - half - 1, node_pool);
+        } else {
+            fix(b, height - 1, 0, node_pool);
+            fix(a, height - 1, half - 1, node_pool);
+        }
+        internal->counts[j] = node_count(a, height - 1);
+        internal->newlines[j] = node_newlines(a, height - 1);
+        internal->counts[j + 1] = count - internal->counts[j];
+        internal->newlines[j + 1] = newlines - internal->newlines[j];
+        return false;
+    }
+
+    // drops the first m children, they were moved elsewhere
+    static void remove_children(internal_t *internal, size_t m) {
+        size_t after = internal->child_count - m;
+        std::copy_n(internal->counts + m, after, internal->counts);
+        std::copy_n(internal->newlines + m, after, internal->newlines);
+        std::copy_n(internal->children + m, after, internal->children);
+        internal->child_count = after;
+    }
+
+    static void usage(const node_t *node, size_t height, size_t& allocated) {
+        if (height == 1) {
+            allocated += sizeof(leaf_t);
+            return;
+        }
+        const internal_t *internal = static_cast<const internal_t *>(node);
+        allocated += sizeof(internal_t);
+        for (size_t i = 0; i < internal->child_count; i++) usage(internal->children[i], height - 1, allocated);
+    }
+
+    std::shared_ptr<node_pool_t> _node_pool;
+    node_t *_root_node;
+    size_t _height;
+};
+
+} // namespace rope
+
+template <size_t BUFFER_LENGTH, size_t FANOUT, template <typename type> typename allocator>
+std::ostream& operator <<(std::ostream& o, const rope::btree_rope_t<BUFFER_LENGTH, FANOUT, allocator>& rope) {
+    for (std::string_view chunk : rope.chunks()) o << chunk;
+    return o;
+}
+
+#endif
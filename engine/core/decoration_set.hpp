@@ -0,0 +1,339 @@
+#ifndef CORE_DECORATION_SET_HPP
+#define CORE_DECORATION_SET_HPP
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+
+namespace rope {
+
+// byte ranges of a rope with a value attached (syntax colours, search highlights, selections) that follow the text through edits
+// kept next to the rope like anchor_set_t, every edit made to the rope has to be passed to edit() (or apply()) as well
+// the ranges are a treap ordered by begin and augmented with the largest end in every subtree, so the k ranges overlapping a
+// viewport are found without looking at the rest of the document, in O((k + 1) log n) expected and not O(log n + k): subtrees are
+// only pruned by their largest end, so every range reported can cost its own path from the root (a range covering the whole
+// viewport, like a selection, counts toward k like the ones inside it)
+// like anchor_set_t the nodes only hold part of their offsets, an edit shifts every range after it by touching O(log n) nodes,
+// the ranges the edit lands in or straddles are the only ones visited, each at the cost of its path like in a query
+// text typed at the edges of an exclusive range stays outside of it (begin has right gravity, end left), an inclusive range
+// grows instead, a range whose text gets erased is left empty where the text was
+template <typename value_t>
+class decoration_set_t {
+public:
+    using decoration_id_t = uint32_t;
+
+    // O(log n), ids of erased decorations get reused
+    decoration_id_t insert(size_t begin, size_t end, value_t value, bool inclusive = false) {
+        assert(begin <= end);
+        decoration_id_t decoration;
+        if (!_free.empty()) {
+            decoration = _free.back();
+            _free.pop_back();
+        } else {
+            decoration = decoration_id_t(_nodes.size());
+            assert(decoration != nil);  // overflow
+            _nodes.emplace_back();
+        }
+        _random ^= _random << 13;
+        _random ^= _random >> 7;
+        _random ^= _random << 17;
+        node_t& node = _nodes[decoration];
+        node.begin = begin;
+        node.end = node.max_end = end;
+        node.shift = 0;
+        node.left = node.right = nil;
+        node.priority = uint32_t(_random >> 32);
+        node.inclusive = inclusive;
+        node.value = std::move(value);
+        auto [before, after] = split(_root, begin, begin_gravity(decoration));
+        set_root(merge(merge(before, decoration), after));
+        _size++;
+        return decoration;
+    }
+
+    // O(log n)
+    void erase(decoration_id_t decoration) {
+        push_path(decoration);
+        node_t& node = _nodes[decoration];
+        decoration_id_t parent = node.parent, children = merge(node.left, node.right);
+        if (parent == nil) set_root(children);
+        else if (_nodes[parent].left == decoration) set_left(parent, children);
+        else set_right(parent, children);
+        for (decoration_id_t t = parent; t != nil; t = _nodes[t].parent) update(t);
+        node.value = value_t{};
+        _free.push_back(decoration);
+        _size--;
+    }
+
+    void clear() {
+        _nodes.clear();
+        _free.clear();
+        _root = nil;
+        _size = 0;
+    }
+
+    // [begin, end) right now, O(log n)
+    std::pair<size_t, size_t> range(decoration_id_t decoration) const {
+        size_t shift = 0;
+        for (decoration_id_t t = decoration; t != nil; t = _nodes[t].parent) shift += _nodes[t].shift;
+        return { _nodes[decoration].begin + shift, _nodes[decoration].end + shift };
+    }
+
+    const value_t& value(decoration_id_t decoration) const { return _nodes[decoration].value; }
+    value_t& value(decoration_id_t decoration) { return _nodes[decoration].value; }
+
+    // [pos, pos + n) of the text was replaced by size bytes, O((k + 1) log n + m log m) expected for k ranges beginning before the
+    // edit and ending in or after it, and m beginning in it (moved, sorted and rebuilt into a subtree)
+    void edit(size_t pos, size_t n, size_t size) {
+        if (_root == nil) return;
+        // only the ends move for the ranges beginning before the edit, the ranges beginning in it are moved and put back in order,
+        // the ones after it are shifted as a whole
+        // the walk down to the first range beginning from (pos + n, right) on shifts the nodes where it goes left with their right
+        // subtree and moves the ends of the nodes where it goes right and of their left subtree
+        _stack.clear();
+        decoration_id_t previous = nil;  // the last range beginning before (pos + n, right)
+        for (decoration_id_t t = _root; t != nil;) {
+            push(t);
+            _stack.push_back(t);
+            if (less(t, pos + n, gravity_t::right)) {
+                previous = t;
+                t = _nodes[t].right;
+            } else {
+                t = _nodes[t].left;
+            }
+        }
+        // nothing begins from (pos, right) to (pos + n, left), always the case for an insert, so typing is just that walk and the
+        // ranges around the caret
+        if (previous == nil || less(previous, pos, gravity_t::right)) {
+            for (decoration_id_t t : _stack) {
+                node_t& node = _nodes[t];
+                if (less(t, pos + n, gravity_t::right)) {
+                    node.end = map(node.end, end_gravity(t), pos, n, size);
+                    move_ends(node.left, pos, n, size);
+                } else {
+                    node.begin += size - n;
+                    node.end += size - n;
+                    if (node.right != nil) _nodes[node.right].shift += size - n;
+                }
+            }
+            for (auto itr = _stack.rbegin(); itr != _stack.rend(); ++itr) update(*itr);
+            return;
+        }
+        auto [before, rest] = split(_root, pos, gravity_t::right);
+        auto [landed, after] = split(rest, pos + n, gravity_t::right);
+        if (after != nil) _nodes[after].shift += size - n;
+        move_ends(before, pos, n, size);
+        if (landed != nil) landed = regroup(landed, pos, n, size);
+        set_root(merge(merge(before, landed), after));
+    }
+
+    // the batch handed to rope_t::apply(), sorted and with positions from before any of them, so they are applied back to front
+    template <typename edit_t>
+    void apply(std::span<const edit_t> edits) {
+        for (auto itr = edits.rbegin(); itr != edits.rend(); ++itr) edit(itr->pos, itr->n, itr->text.size());
+    }
+
+    // callback(decoration, begin, end, value) for the ranges overlapping [begin, end) by begin, empty ranges count if they are
+    // inside it, O((k + 1) log n) expected for k of them
+    template <typename callback_t>
+    void query(size_t begin, size_t end, callback_t&& callback) const {
+        query_impl(_root, 0, begin, end, callback);
+    }
+
+    size_t size() const { return _size; }
+    size_t memory_usage() const { return _nodes.capacity() * sizeof(node_t) + (_free.capacity() + _scratch.capacity() + _stack.capacity()) * sizeof(decoration_id_t); }
+
+private:
+    static constexpr decoration_id_t nil = ~decoration_id_t{ 0 };
+
+    // same as anchor_set_t::gravity_t, for the edges of the ranges
+    enum class gravity_t : uint8_t {
+        left,
+        right,
+    };
+
+    struct node_t {
+        // the real offsets are these plus the shift of the node and of all its ancestors
+        size_t begin, end;
+        size_t max_end;  // of the subtree
+        size_t shift;  // pending for the whole subtree, shifts to the left wrap around
+        decoration_id_t left, right, parent;
+        uint32_t priority;  // max heap
+        bool inclusive;
+        value_t value;
+    };
+
+    gravity_t begin_gravity(decoration_id_t t) const { return _nodes[t].inclusive ? gravity_t::left : gravity_t::right; }
+    gravity_t end_gravity(decoration_id_t t) const { return _nodes[t].inclusive ? gravity_t::right : gravity_t::left; }
+
+    bool less(decoration_id_t t, size_t offset, gravity_t gravity) const {
+        return _nodes[t].begin < offset || (_nodes[t].begin == offset && begin_gravity(t) < gravity);
+    }
+
+    // where offset ends up after [pos, pos + n) is replaced by size bytes, see anchor_set_t::edit()
+    static size_t map(size_t offset, gravity_t gravity, size_t pos, size_t n, size_t size) {
+        if (offset < pos || (offset == pos && (n || gravity == gravity_t::left))) return offset;
+        if (offset > pos + n || (offset == pos + n && (n || gravity == gravity_t::right))) return offset - n + size;
+        return gravity == gravity_t::left ? pos : pos + size;
+    }
+
+    // moves the pending shift of t down to its children
+    void push(decoration_id_t t) {
+        node_t& node = _nodes[t];
+        if (!node.shift) return;
+        node.begin += node.shift;
+        node.end += node.shift;
+        node.max_end += node.shift;
+        if (node.left != nil) _nodes[node.left].shift += node.shift;
+        if (node.right != nil) _nodes[node.right].shift += node.shift;
+        node.shift = 0;
+    }
+
+    // every ancestor of t pushed, so the offsets of t are exact
+    void push_path(decoration_id_t t) {
+        _stack.clear();
+        for (; t != nil; t = _nodes[t].parent) _stack.push_back(t);
+        for (auto itr = _stack.rbegin(); itr != _stack.rend(); ++itr) push(*itr);
+    }
+
+    // t has to be pushed, its children can still have a pending shift
+    void update(decoration_id_t t) {
+        node_t& node = _nodes[t];
+        node.max_end = node.end;
+        if (node.left != nil) node.max_end = std::max(node.max_end, _nodes[node.left].max_end + _nodes[node.left].shift);
+        if (node.right != nil) node.max_end = std::max(node.max_end, _nodes[node.right].max_end + _nodes[node.right].shift);
+    }
+
+    void set_left(decoration_id_t t, decoration_id_t child) {
+        _nodes[t].left = child;
+        if (child != nil) _nodes[child].parent = t;
+    }
+
+    void set_right(decoration_id_t t, decoration_id_t child) {
+        _nodes[t].right = child;
+        if (child != nil) _nodes[child].parent = t;
+    }
+
+    void set_root(decoration_id_t t) {
+        _root = t;
+        if (t != nil) _nodes[t].parent = nil;
+    }
+
+    // ranges beginning before (offset, gravity) go to the first tree, the returned roots can still point at their old parents
+    std::pair<decoration_id_t, decoration_id_t> split(decoration_id_t t, size_t offset, gravity_t gravity) {
+        if (t == nil) return { nil, nil };
+        push(t);
+        if (less(t, offset, gravity)) {
+            auto [left, right] = split(_nodes[t].right, offset, gravity);
+            set_right(t, left);
+            update(t);
+            return { t, right };
+        }
+        auto [left, right] = split(_nodes[t].left, offset, gravity);
+        set_left(t, right);
+        update(t);
+        return { left, t };
+    }
+
+    // every range in a has to come before every range in b
+    decoration_id_t merge(decoration_id_t a, decoration_id_t b) {
+        if (a == nil) return b;
+        if (b == nil) return a;
+        if (_nodes[a].priority > _nodes[b].priority) {
+            push(a);
+            set_right(a, merge(_nodes[a].right, b));
+            update(a);
+            return a;
+        }
+        push(b);
+        set_left(b, merge(a, _nodes[b].left));
+        update(b);
+        return b;
+    }
+
+    // the ranges of t all begin before the edit, the ones ending in or after it get their end moved, subtrees ending before pos
+    // are skipped
+    void move_ends(decoration_id_t t, size_t pos, size_t n, size_t size) {
+        if (t == nil) return;
+        push(t);
+        node_t& node = _nodes[t];
+        if (node.max_end < pos) return;
+        move_ends(node.left, pos, n, size);
+        move_ends(node.right, pos, n, size);
+        node.end = map(node.end, end_gravity(t), pos, n, size);
+        update(t);
+    }
+
+    // moves the ranges of t, the ones beginning from (pos, right) to (pos + n, left), to where the edit puts them and rebuilds the
+    // tree in their new order, O(size of t)
+    decoration_id_t regroup(decoration_id_t t, size_t pos, size_t n, size_t size) {
+        _scratch.clear();
+        collect(t);
+        for (decoration_id_t decoration : _scratch) {
+            node_t& node = _nodes[decoration];
+            node.begin = map(node.begin, begin_gravity(decoration), pos, n, size);
+            node.end = std::max(node.begin, map(node.end, end_gravity(decoration), pos, n, size));
+        }
+        std::stable_sort(_scratch.begin(), _scratch.end(), [this](decoration_id_t a, decoration_id_t b) { return less(a, _nodes[b].begin, begin_gravity(b)); });
+        // the order is known, so the treap is built in one pass (a cartesian tree on the priorities) instead of n inserts
+        _stack.clear();
+        for (decoration_id_t decoration : _scratch) {
+            _nodes[decoration].right = nil;
+            decoration_id_t last = nil;
+            while (!_stack.empty() && _nodes[_stack.back()].priority < _nodes[decoration].priority) {
+                last = _stack.back();
+                _stack.pop_back();
+            }
+            set_left(decoration, last);
+            if (!_stack.empty()) set_right(_stack.back(), decoration);
+            _stack.push_back(decoration);
+        }
+        decoration_id_t root = _stack.front();
+        fix_max_end(root);
+        return root;
+    }
+
+    // in order, pushed on the way so the offsets are exact
+    void collect(decoration_id_t t) {
+        if (t == nil) return;
+        push(t);
+        collect(_nodes[t].left);
+        _scratch.push_back(t);
+        collect(_nodes[t].right);
+    }
+
+    void fix_max_end(decoration_id_t t) {
+        if (t == nil) return;
+        fix_max_end(_nodes[t].left);
+        fix_max_end(_nodes[t].right);
+        update(t);
+    }
+
+    template <typename callback_t>
+    void query_impl(decoration_id_t t, size_t shift, size_t begin, size_t end, callback_t& callback) const {
+        if (t == nil) return;
+        const node_t& node = _nodes[t];
+        shift += node.shift;
+        if (node.max_end + shift < begin) return;
+        query_impl(node.left, shift, begin, end, callback);
+        size_t node_begin = node.begin + shift, node_end = node.end + shift;
+        // everything to the right begins after this one
+        if (node_begin >= end) return;
+        if (node_end > begin || (node_begin == node_end && node_begin >= begin)) callback(t, node_begin, node_end, node.value);
+        query_impl(node.right, shift, begin, end, callback);
+    }
+
+    std::vector<node_t> _nodes;
+    std::vector<decoration_id_t> _free;
+    std::vector<decoration_id_t> _scratch, _stack;  // kept to not allocate on every regroup()
+    decoration_id_t _root = nil;
+    size_t _size = 0;
+    uint64_t _random = 0x9e3779b97f4a7c15;  // xorshift state for the priorities
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,115 @@
+#include "file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <string>
+
+namespace core {
+
+std::shared_ptr<mapped_file_t> mapped_file_t::open(const std::filesystem::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t size = file_stat.st_size;
+    const char *data = nullptr;
+    // mmap doesnt accept empty mappings
+    if (size) {
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        data = static_cast<const char *>(mapping);
+    }
+    ::close(fd);  // the mapping stays valid after the file is closed
+
+    return std::make_shared<mapped_file_t>(data, size);
+}
+
+mapped_file_t::~mapped_file_t() {
+    if (_data) munmap(const_cast<char *>(_data), _size);
+}
+
+std::unique_ptr<atomic_file_writer_t> atomic_file_writer_t::open(const std::filesystem::path& path) {
+    // same directory as the destination, rename is only atomic within a filesystem
+    std::string temp_path = path.string() + ".XXXXXX";
+    int fd = mkstemp(temp_path.data());
+    if (fd < 0) return nullptr;
+
+    // mkstemp creates the file as 0600, keep the permissions of the file being replaced
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0) fchmod(fd, file_stat.st_mode & 07777);
+
+    return std::make_unique<atomic_file_writer_t>(fd, path, temp_path);
+}
+
+atomic_file_writer_t::~atomic_file_writer_t() {
+    if (_fd < 0) return;
+    ::close(_fd);
+    unlink(_temp_path.c_str());
+}
+
+bool atomic_file_writer_t::write(const std::string_view *chunks, size_t count) {
+    if (_fd < 0) return false;
+    iovec iov[max_chunks];
+    size_t iov_count = 0;
+    for (size_t i = 0; i < count && iov_count < max_chunks; i++) {
+        if (chunks[i].empty()) continue;
+        iov[iov_count++] = { const_cast<char *>(chunks[i].data()), chunks[i].size() };
+    }
+
+    iovec *next = iov;
+    while (iov_count) {
+        ssize_t written = writev(_fd, next, int(iov_count));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // partial write, skip what made it and continue from the middle of the chunk it stopped in
+        size_t left = written;
+        while (iov_count && left >= next->iov_len) {
+            left -= next->iov_len;
+            next++;
+            iov_count--;
+        }
+        if (iov_count) {
+            next->iov_base = static_cast<char *>(next->iov_base) + left;
+            next->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+bool atomic_file_writer_t::commit(bool sync) {
+    if (_fd < 0) return false;
+    if (sync && fsync(_fd) < 0) return false;
+    if (::close(_fd) < 0) return false;  // some filesystems only report write errors on close
+    _fd = -1;
+    if (rename(_temp_path.c_str(), _path.c_str()) < 0) {
+        unlink(_temp_path.c_str());
+        return false;
+    }
+    if (sync) {
+        // the rename is only durable once the directory entry is
+        std::filesystem::path directory = _path.parent_path();
+        int directory_fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (directory_fd < 0) return false;
+        bool synced = fsync(directory_fd) == 0;
+        ::close(directory_fd);
+        return synced;
+    }
+    return true;
+}
+
+} // namespace core
@@ -0,0 +1,59 @@
+#ifndef CORE_FILE_HPP
+#define CORE_FILE_HPP
+
+#include <memory>
+#include <filesystem>
+#include <string_view>
+
+namespace core {
+
+// read only memory mapping of a whole file, pages are only read from disk when they are touched
+class mapped_file_t {
+public:
+    // nullptr if the file cant be opened or mapped
+    static std::shared_ptr<mapped_file_t> open(const std::filesystem::path& path);
+
+    mapped_file_t(const char *data, size_t size) : _data(data), _size(size) {}
+    ~mapped_file_t();
+
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const char *_data;
+    size_t _size;
+};
+
+// writes a file through a temp file in the same directory that is renamed over the destination by commit()
+// a crash or a failed write leaves the old file untouched, never a partially written one
+class atomic_file_writer_t {
+public:
+    // nullptr if the temp file cant be created
+    static std::unique_ptr<atomic_file_writer_t> open(const std::filesystem::path& path);
+
+    atomic_file_writer_t(int fd, std::filesystem::path path, std::filesystem::path temp_path) : _fd(fd), _path(std::move(path)), _temp_path(std::move(temp_path)) {}
+    ~atomic_file_writer_t();  // removes the temp file if it wasnt committed
+
+    atomic_file_writer_t(const atomic_file_writer_t&) = delete;
+    atomic_file_writer_t& operator=(const atomic_file_writer_t&) = delete;
+
+    // a single writev (or more on partial writes), count can be upto max_chunks
+    bool write(const std::string_view *chunks, size_t count);
+
+    // replaces the destination with everything written so far, sync waits for the data (and the rename) to reach the disk
+    bool commit(bool sync);
+
+    static constexpr size_t max_chunks = 1024;  // IOV_MAX on linux
+
+private:
+    int _fd;
+    std::filesystem::path _path;
+    std::filesystem::path _temp_path;
+};
+
+} // namespace core
+
+#endif
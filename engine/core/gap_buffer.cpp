@@ -0,0 +1,87 @@
+#include "gap_buffer.hpp"
+
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+namespace rope {
+
+gap_buffer_t::gap_buffer_t(std::string_view str) : _buffer(new char[str.size() + min_gap]), _capacity(str.size() + min_gap), _gap_begin(str.size()), _gap_end(_capacity) {
+    if (!str.empty()) std::memcpy(_buffer.get(), str.data(), str.size());
+}
+
+gap_buffer_t::gap_buffer_t(const gap_buffer_t& other) : _buffer(new char[other._capacity]), _capacity(other._capacity), _gap_begin(other._gap_begin), _gap_end(other._gap_end) {
+    std::memcpy(_buffer.get(), other._buffer.get(), _gap_begin);
+    std::memcpy(_buffer.get() + _gap_end, other._buffer.get() + _gap_end, _capacity - _gap_end);
+}
+
+gap_buffer_t& gap_buffer_t::operator=(gap_buffer_t other) {
+    std::swap(_buffer, other._buffer);
+    std::swap(_capacity, other._capacity);
+    std::swap(_gap_begin, other._gap_begin);
+    std::swap(_gap_end, other._gap_end);
+    std::swap(_moved, other._moved);
+    return *this;
+}
+
+void gap_buffer_t::slice(size_t pos, size_t n, char *o_str) const {
+    assert(pos <= size() && pos + n <= size());  // bounds check
+    if (pos < _gap_begin) {
+        size_t before = std::min(n, _gap_begin - pos);
+        std::memcpy(o_str, _buffer.get() + pos, before);
+        o_str += before;
+        pos += before;
+        n -= before;
+    }
+    if (n) std::memcpy(o_str, _buffer.get() + _gap_end + (pos - _gap_begin), n);
+}
+
+void gap_buffer_t::set_slice(const char *str, size_t size, size_t pos, size_t n) {
+    assert(pos <= this->size() && pos + n <= this->size());  // bounds check
+    move_gap(pos);
+    // the erased text is right after the gap now, it just joins it
+    _gap_end += n;
+    if (_gap_end - _gap_begin < size) {
+        // grows by atleast half, so a file typed in from scratch is O(n) copies overall
+        size_t after = _capacity - _gap_end;
+        size_t capacity = std::max(_capacity + _capacity / 2, _gap_begin + size + after + min_gap);
+        std::unique_ptr<char[]> buffer(new char[capacity]);
+        std::memcpy(buffer.get(), _buffer.get(), _gap_begin);
+        std::memcpy(buffer.get() + capacity - after, _buffer.get() + _gap_end, after);
+        _buffer = std::move(buffer);
+        _capacity = capacity;
+        _gap_end = capacity - after;
+    }
+    if (size) std::memcpy(_buffer.get() + _gap_begin, str, size);
+    _gap_begin += size;
+}
+
+std::string gap_buffer_t::to_string() const {
+    std::string str;
+    str.reserve(size());
+    str.append(_buffer.get(), _gap_begin).append(_buffer.get() + _gap_end, _capacity - _gap_end);
+    return str;
+}
+
+std::string_view gap_buffer_t::segment(size_t i) const {
+    if (i || !_gap_begin) return { _buffer.get() + _gap_end, _capacity - _gap_end };
+    return { _buffer.get(), _gap_begin };
+}
+
+void gap_buffer_t::move_gap(size_t pos) {
+    if (pos < _gap_begin) {
+        size_t n = _gap_begin - pos;
+        std::memmove(_buffer.get() + _gap_end - n, _buffer.get() + pos, n);
+        _gap_begin -= n;
+        _gap_end -= n;
+        _moved += n;
+    } else if (pos > _gap_begin) {
+        size_t n = pos - _gap_begin;
+        std::memmove(_buffer.get() + _gap_begin, _buffer.get() + _gap_end, n);
+        _gap_begin += n;
+        _gap_end += n;
+        _moved += n;
+    }
+}
+
+} // namespace rope
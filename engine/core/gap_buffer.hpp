@@ -0,0 +1,61 @@
+#ifndef CORE_GAP_BUFFER_HPP
+#define CORE_GAP_BUFFER_HPP
+
+#include "text_storage.hpp"
+
+#include <memory>
+#include <string>
+#include <cassert>
+#include <string_view>
+
+namespace rope {
+
+// the whole text in one buffer with a gap at the last edit, an edit moves the gap there first (a memmove of the text in between)
+// so edits close to each other are O(1) and reads are 2 contiguous pieces at most
+// best for small files, where moving the gap across the whole text is cheaper than walking a tree, see text_buffer_t
+class gap_buffer_t {
+public:
+    static constexpr size_t min_gap = 4096;
+
+    explicit gap_buffer_t(std::string_view str);
+
+    gap_buffer_t(const gap_buffer_t& other);
+    gap_buffer_t& operator=(gap_buffer_t other);
+
+    void slice(size_t pos, size_t n, char *o_str) const;
+    void set_slice(const char *str, size_t size, size_t pos, size_t n);
+    void insert(const char *str, size_t size, size_t pos) { set_slice(str, size, pos, 0); }
+    void erase(size_t pos, size_t n) { set_slice(nullptr, 0, pos, n); }
+
+    segments_view_t<gap_buffer_t> chunks() const { return chunks(0, size()); }
+    segments_view_t<gap_buffer_t> chunks(size_t pos, size_t n) const {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        return { this, pos, pos + n };
+    }
+
+    std::string to_string() const;
+
+    size_t size() const { return _capacity - (_gap_end - _gap_begin); }
+    size_t memory_usage() const { return _capacity; }
+
+    // bytes moved to get the gap to the edits, so far
+    size_t moved() const { return _moved; }
+
+    // the text before the gap and the text after it, whichever arent empty
+    size_t segment_count() const { return (_gap_begin > 0) + (_gap_end < _capacity); }
+    std::string_view segment(size_t i) const;
+    size_t segment_start(size_t i) const { return i && _gap_begin ? _gap_begin : 0; }
+    size_t find_segment(size_t pos) const { return _gap_begin && pos >= _gap_begin ? 1 : 0; }
+
+private:
+    void move_gap(size_t pos);
+
+    std::unique_ptr<char[]> _buffer;
+    size_t _capacity;
+    size_t _gap_begin, _gap_end;
+    size_t _moved = 0;
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,600 @@
+#include "grammar.hpp"
+
+#include "file.hpp"
+#include "regex.hpp"
+
+#include <bitset>
+#include <cstdio>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rope {
+
+namespace {
+
+constexpr uint32_t magic = 0x46444752;  // "RGDF"
+constexpr int32_t dead = 0;
+constexpr int32_t no_rule = -1;
+
+constexpr std::string_view token_names[] = { "plain", "keyword", "type", "number", "string", "comment", "symbol", "preprocessor" };
+
+// the (state, dfa row, position) grammar_t::lex_line_recording went through after the last accept of a scan, nothing accepts from
+// those, so a later scan that gets to one stops there
+struct failed_rows_t {
+    // a stretch shorter than this is cheaper to read again than to record, a scan starts at most once per byte so the stretches
+    // that arent recorded add up to at most this many bytes per byte
+    static constexpr size_t min_failed_run = 16;
+
+    failed_rows_t(size_t line_size, size_t stride) : first(line_size + 1), stride(stride) {}
+
+    bool contains(uint16_t state, int32_t row, size_t position) const {
+        uint64_t recorded = first[position];
+        if (!recorded) return false;
+        return recorded == pack(state, row) || (!more.empty() && more.count(key(state, row, position)));
+    }
+
+    void record(uint16_t state, int32_t row, size_t position) {
+        uint64_t& recorded = first[position];
+        if (!recorded) recorded = pack(state, row);
+        else if (recorded != pack(state, row)) more.insert(key(state, row, position));
+    }
+
+    // never 0, the dead row isnt recorded
+    static uint64_t pack(uint16_t state, int32_t row) { return uint64_t(state) << 32 | uint32_t(row); }
+    // a state has at most max_dfa_states rows
+    uint64_t key(uint16_t state, int32_t row, size_t position) const { return uint64_t(position) << 32 | uint64_t(state) << 16 | uint64_t(row) / stride; }
+
+    // the first one recorded at every position is enough for most grammars, the rest (keyed with their position) are rare
+    std::vector<uint64_t> first;
+    std::unordered_set<uint64_t> more;
+    size_t stride;
+};
+
+struct source_rule_t {
+    token_t token;
+    std::string pattern;
+    std::string next;  // empty to stay
+    size_t line;
+};
+
+struct source_state_t {
+    std::string name;
+    std::vector<source_rule_t> rules;
+};
+
+[[noreturn]] void error(size_t line, const std::string& what) {
+    throw std::runtime_error("grammar: " + what + " on line " + std::to_string(line));
+}
+
+std::string_view trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t' || str.front() == '\r')) str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r')) str.remove_suffix(1);
+    return str;
+}
+
+std::vector<source_state_t> parse(std::string_view source) {
+    std::vector<source_state_t> states;
+    size_t line_number = 0;
+    while (!source.empty()) {
+        size_t newline = source.find('\n');
+        std::string_view line = trim(source.substr(0, newline));
+        source.remove_prefix(newline == std::string_view::npos ? source.size() : newline + 1);
+        line_number++;
+        if (line.empty() || line.front() == '#') continue;
+        size_t space = line.find_first_of(" \t");
+        std::string_view word = line.substr(0, space), rest = space == std::string_view::npos ? std::string_view{} : trim(line.substr(space));
+        if (word == "state") {
+            if (rest.empty() || rest.find_first_of(" \t") != std::string_view::npos) error(line_number, "expected a state name");
+            states.push_back({ std::string(rest), {} });
+            continue;
+        }
+        auto token = std::find(std::begin(token_names), std::end(token_names), word);
+        if (token == std::end(token_names)) error(line_number, "unknown token \"" + std::string(word) + "\"");
+        if (states.empty()) error(line_number, "rule before the first state");
+        source_rule_t rule{ token_t(token - std::begin(token_names)), {}, {}, line_number };
+        size_t arrow = rest.rfind(" => ");
+        if (arrow != std::string_view::npos) {
+            rule.next = std::string(trim(rest.substr(arrow + 4)));
+            rest = trim(rest.substr(0, arrow));
+        }
+        if (rest.empty()) error(line_number, "expected a pattern");
+        rule.pattern = std::string(rest);
+        states.back().rules.push_back(std::move(rule));
+    }
+    if (states.empty()) throw std::runtime_error("grammar: no states");
+    if (states.size() > size_t(std::numeric_limits<grammar_t::state_t>::max())) throw std::runtime_error("grammar: too many states");
+    return states;
+}
+
+// the rules of a state as one nfa, the match states know their rule
+struct nfa_state_t {
+    core::regex_t::nfa_state_t::kind_t kind;
+    uint32_t next, next2;
+    uint32_t set;  // into the sets of all the rules
+    int32_t rule;
+};
+
+// subset construction of the whole dfa of a state, see grammar_t::state_dfa_t for the table
+class dfa_builder_t {
+public:
+    dfa_builder_t(const std::vector<nfa_state_t>& nfa, uint32_t start, const std::vector<std::bitset<256>>& sets, const uint8_t *byte_classes, size_t byte_class_count)
+      : _nfa(nfa), _sets(sets), _byte_classes(byte_classes), _byte_class_count(byte_class_count), _stride(byte_class_count + 2), _visited(nfa.size(), 0) {
+        _representatives.assign(byte_class_count, 0);
+        for (size_t byte = 256; byte-- > 0;) _representatives[byte_classes[byte]] = uint8_t(byte);
+        _table.assign(_stride, dead);
+        _table[_stride - 2] = _table[_stride - 1] = no_rule;
+        _kernels.emplace_back();
+        _line_start.push_back(false);
+        _start = intern({ start }, false, true);
+        _start_line = intern({ start }, true, true);
+    }
+
+    void build(const std::string& name) {
+        std::vector<uint32_t> states, kernel;
+        for (size_t row = 1; row < _kernels.size(); row++) {
+            closure(_kernels[row], _line_start[row], false, states);
+            for (size_t byte_class = 0; byte_class < _byte_class_count; byte_class++) {
+                uint8_t byte = _representatives[byte_class];
+                kernel.clear();
+                for (uint32_t state : states) {
+                    if (_nfa[state].kind == core::regex_t::nfa_state_t::byte_set && _sets[_nfa[state].set][byte]) kernel.push_back(_nfa[state].next);
+                }
+                std::sort(kernel.begin(), kernel.end());
+                kernel.erase(std::unique(kernel.begin(), kernel.end()), kernel.end());
+                int32_t next = kernel.empty() ? dead : intern(kernel, false, false);
+                _table[row * _stride + byte_class] = next;
+            }
+            if (_kernels.size() > grammar_t::max_dfa_states) throw std::runtime_error("grammar: state " + name + " needs too many dfa states");
+        }
+    }
+
+    std::vector<int32_t>& table() { return _table; }
+    int32_t start() const { return _start; }
+    int32_t start_line() const { return _start_line; }
+
+private:
+    // every state reachable from kernel without consuming a byte, the anchors are only crossed where they hold
+    void closure(const std::vector<uint32_t>& kernel, bool at_line_start, bool at_line_end, std::vector<uint32_t>& o_states) {
+        o_states.clear();
+        if (++_generation == 0) {
+            std::fill(_visited.begin(), _visited.end(), 0);
+            _generation = 1;
+        }
+        _stack.assign(kernel.rbegin(), kernel.rend());
+        while (!_stack.empty()) {
+            uint32_t state = _stack.back();
+            _stack.pop_back();
+            if (_visited[state] == _generation) continue;
+            _visited[state] = _generation;
+            o_states.push_back(state);
+            const nfa_state_t& node = _nfa[state];
+            switch (node.kind) {
+                case core::regex_t::nfa_state_t::split:
+                    _stack.push_back(node.next2);
+                    _stack.push_back(node.next);
+                    break;
+                case core::regex_t::nfa_state_t::epsilon:
+                    _stack.push_back(node.next);
+                    break;
+                case core::regex_t::nfa_state_t::begin_line:
+                    if (at_line_start) _stack.push_back(node.next);
+                    break;
+                case core::regex_t::nfa_state_t::end_line:
+                    if (at_line_end) _stack.push_back(node.next);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    int32_t accepting(const std::vector<uint32_t>& kernel, bool at_line_start, bool at_line_end) {
+        closure(kernel, at_line_start, at_line_end, _scratch);
+        int32_t rule = no_rule;
+        for (uint32_t state : _scratch) {
+            if (_nfa[state].kind == core::regex_t::nfa_state_t::match && (rule == no_rule || _nfa[state].rule < rule)) rule = _nfa[state].rule;
+        }
+        return rule;
+    }
+
+    // the start rows are kept apart from the rows with the same nfa states that a byte led to, they dont accept
+    int32_t intern(const std::vector<uint32_t>& kernel, bool at_line_start, bool start) {
+        std::string key(reinterpret_cast<const char *>(kernel.data()), kernel.size() * sizeof(uint32_t));
+        key.push_back(char(at_line_start | start << 1));
+        auto itr = _ids.find(key);
+        if (itr != _ids.end()) return itr->second;
+        int32_t id = int32_t(_table.size());
+        _table.resize(_table.size() + _stride, dead);
+        // a token is never empty
+        _table[id + _stride - 2] = start ? no_rule : accepting(kernel, at_line_start, false);
+        _table[id + _stride - 1] = start ? no_rule : accepting(kernel, at_line_start, true);
+        _kernels.push_back(kernel);
+        _line_start.push_back(at_line_start);
+        _ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    const std::vector<nfa_state_t>& _nfa;
+    const std::vector<std::bitset<256>>& _sets;
+    const uint8_t *_byte_classes;
+    size_t _byte_class_count;
+    size_t _stride;
+    std::vector<uint8_t> _representatives;  // a byte of every class
+    std::vector<int32_t> _table;
+    std::vector<std::vector<uint32_t>> _kernels;  // nfa states reached, before following epsilons, per row
+    std::vector<bool> _line_start;
+    std::unordered_map<std::string, int32_t> _ids;
+    int32_t _start = dead, _start_line = dead;
+    std::vector<uint32_t> _visited;  // generation stamps, so closure doesnt have to clear a set every time
+    uint32_t _generation = 0;
+    std::vector<uint32_t> _stack, _scratch;
+};
+
+// reads the cache file, every read is bounds checked
+class reader_t {
+public:
+    reader_t(const char *data, size_t size) : _data(data), _size(size) {}
+
+    template <typename type>
+    bool read(type& o_value) {
+        return read(&o_value, sizeof(type));
+    }
+
+    bool read(void *o_data, size_t size) {
+        if (size > _size - _pos) return false;
+        std::memcpy(o_data, _data + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    bool done() const { return _pos == _size; }
+
+private:
+    const char *_data;
+    size_t _size;
+    size_t _pos = 0;
+};
+
+template <typename type>
+void append(std::string& o_str, const type& value) {
+    o_str.append(reinterpret_cast<const char *>(&value), sizeof(type));
+}
+
+} // namespace
+
+grammar_t grammar_t::compile(std::string_view source) {
+    std::vector<source_state_t> source_states = parse(source);
+    grammar_t grammar;
+    grammar._hash = hash(source);
+
+    // every pattern of every state, their sets together decide the byte classes
+    std::vector<std::vector<core::regex_t>> regexes(source_states.size());
+    std::vector<std::bitset<256>> sets;
+    for (size_t i = 0; i < source_states.size(); i++) {
+        for (const source_rule_t& rule : source_states[i].rules) {
+            try {
+                regexes[i].emplace_back(rule.pattern);
+            } catch (const std::runtime_error& e) {
+                error(rule.line, e.what());
+            }
+            sets.insert(sets.end(), regexes[i].back().sets().begin(), regexes[i].back().sets().end());
+        }
+    }
+    std::bitset<256> boundaries;
+    for (const auto& set : sets) {
+        for (size_t c = 1; c < 256; c++) {
+            if (set[c] != set[c - 1]) boundaries.set(c);
+        }
+    }
+    for (size_t c = 0; c < 256; c++) {
+        if (c && boundaries[c]) grammar._byte_class_count++;
+        grammar._byte_classes[c] = uint8_t(grammar._byte_class_count);
+    }
+    grammar._byte_class_count++;
+
+    uint32_t set_base = 0;
+    for (size_t i = 0; i < source_states.size(); i++) {
+        const source_state_t& source_state = source_states[i];
+        state_dfa_t& state = grammar._states.emplace_back();
+        state.name = source_state.name;
+        // a split chain into the start of every rule
+        std::vector<nfa_state_t> nfa;
+        uint32_t start = 0;
+        for (size_t r = 0; r < source_state.rules.size(); r++) {
+            const source_rule_t& rule = source_state.rules[r];
+            rule_t compiled{ rule.token, state_t(i) };
+            if (!rule.next.empty()) {
+                auto next = std::find_if(source_states.begin(), source_states.end(), [&](const source_state_t& state) { return state.name == rule.next; });
+                if (next == source_states.end()) error(rule.line, "unknown state \"" + rule.next + "\"");
+                compiled.next = state_t(next - source_states.begin());
+            }
+            state.rules.push_back(compiled);
+            const core::regex_t& regex = regexes[i][r];
+            uint32_t base = uint32_t(nfa.size());
+            for (const core::regex_t::nfa_state_t& node : regex.forward().states) {
+                nfa.push_back({ node.kind, node.next + base, node.next2 + base, node.set + set_base, node.kind == core::regex_t::nfa_state_t::match ? int32_t(r) : no_rule });
+            }
+            uint32_t entry = regex.forward().start + base;
+            if (r) {
+                nfa.push_back({ core::regex_t::nfa_state_t::split, start, entry, 0, no_rule });
+                entry = uint32_t(nfa.size() - 1);
+            }
+            start = entry;
+            set_base += uint32_t(regex.sets().size());
+        }
+        if (source_state.rules.empty()) {
+            // never matches
+            nfa.push_back({ core::regex_t::nfa_state_t::epsilon, 0, 0, 0, no_rule });
+        }
+        dfa_builder_t builder(nfa, start, sets, grammar._byte_classes, grammar._byte_class_count);
+        builder.build(state.name);
+        state.table = std::move(builder.table());
+        state.start = builder.start();
+        state.start_line = builder.start_line();
+    }
+    return grammar;
+}
+
+grammar_t grammar_t::load(std::string_view source, const std::filesystem::path& cache_dir) {
+    uint64_t source_hash = hash(source);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.grammar", static_cast<unsigned long long>(source_hash));
+    std::filesystem::path path = cache_dir / name;
+    if (std::optional<grammar_t> grammar = read(path, source_hash)) return std::move(*grammar);
+    grammar_t grammar = compile(source);
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+    grammar.write(path);
+    return grammar;
+}
+
+uint64_t grammar_t::hash(std::string_view source) {
+    // fnv-1a, the format version is hashed in too so old cache files are never picked up
+    uint64_t hash = 0xcbf29ce484222325;
+    auto mix = [&](const void *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<const uint8_t *>(data)[i];
+            hash *= 0x100000001b3;
+        }
+    };
+    mix(&format_version, sizeof(format_version));
+    mix(source.data(), source.size());
+    return hash;
+}
+
+std::optional<grammar_t> grammar_t::read(const std::filesystem::path& path, uint64_t hash) {
+    std::shared_ptr<core::mapped_file_t> file = core::mapped_file_t::open(path);
+    if (!file) return std::nullopt;
+    reader_t reader(file->data(), file->size());
+    uint32_t file_magic, version, state_count;
+    grammar_t grammar;
+    if (!reader.read(file_magic) || file_magic != magic || !reader.read(version) || version != format_version) return std::nullopt;
+    if (!reader.read(grammar._hash) || grammar._hash != hash) return std::nullopt;
+    if (!reader.read(grammar._byte_classes, sizeof(grammar._byte_classes)) || !reader.read(grammar._byte_class_count) || !reader.read(state_count)) return std::nullopt;
+    if (!grammar._byte_class_count || grammar._byte_class_count > 256 || !state_count) return std::nullopt;
+    for (uint8_t byte_class : grammar._byte_classes) {
+        if (byte_class >= grammar._byte_class_count) return std::nullopt;
+    }
+    size_t stride = grammar.stride();
+    for (uint32_t i = 0; i < state_count; i++) {
+        state_dfa_t& state = grammar._states.emplace_back();
+        uint32_t name_size, rule_count, table_size;
+        if (!reader.read(name_size) || name_size > file->size()) return std::nullopt;
+        state.name.resize(name_size);
+        if (!reader.read(state.name.data(), name_size) || !reader.read(rule_count) || !reader.read(table_size)) return std::nullopt;
+        if (rule_count > file->size() || table_size > file->size() || table_size % stride || !table_size) return std::nullopt;
+        if (!reader.read(state.start) || !reader.read(state.start_line)) return std::nullopt;
+        state.rules.resize(rule_count);
+        for (rule_t& rule : state.rules) {
+            uint8_t token;
+            if (!reader.read(token) || !reader.read(rule.next)) return std::nullopt;
+            rule.token = token_t(token);
+        }
+        state.table.resize(table_size);
+        if (!reader.read(state.table.data(), table_size * sizeof(int32_t))) return std::nullopt;
+        // a corrupt table would be followed out of bounds
+        for (const rule_t& rule : state.rules) {
+            if (rule.next >= state_count || size_t(rule.token) >= std::size(token_names)) return std::nullopt;
+        }
+        auto valid_row = [&](int32_t row) { return row >= 0 && size_t(row) < table_size && row % stride == 0; };
+        if (!valid_row(state.start) || !valid_row(state.start_line)) return std::nullopt;
+        for (size_t entry = 0; entry < table_size; entry++) {
+            int32_t value = state.table[entry];
+            bool valid = entry % stride < grammar._byte_class_count ? valid_row(value) : value == no_rule || (value >= 0 && uint32_t(value) < rule_count);
+            if (!valid) return std::nullopt;
+        }
+    }
+    if (!reader.done()) return std::nullopt;
+    return grammar;
+}
+
+bool grammar_t::write(const std::filesystem::path& path) const {
+    std::string data;
+    append(data, magic);
+    append(data, format_version);
+    append(data, _hash);
+    data.append(reinterpret_cast<const char *>(_byte_classes), sizeof(_byte_classes));
+    append(data, _byte_class_count);
+    append(data, uint32_t(_states.size()));
+    for (const state_dfa_t& state : _states) {
+        append(data, uint32_t(state.name.size()));
+        data.append(state.name);
+        append(data, uint32_t(state.rules.size()));
+        append(data, uint32_t(state.table.size()));
+        append(data, state.start);
+        append(data, state.start_line);
+        // a field at a time, rule_t has padding
+        for (const rule_t& rule : state.rules) {
+            append(data, uint8_t(rule.token));
+            append(data, rule.next);
+        }
+        data.append(reinterpret_cast<const char *>(state.table.data()), state.table.size() * sizeof(int32_t));
+    }
+    std::unique_ptr<core::atomic_file_writer_t> writer = core::atomic_file_writer_t::open(path);
+    std::string_view chunk = data;
+    return writer && writer->write(&chunk, 1) && writer->commit(false);
+}
+
+grammar_t::state_t grammar_t::lex_line(state_t state, std::string_view line, std::vector<token_span_t>& o_spans) const {
+    const size_t stride = this->stride();
+    const uint8_t *byte_classes = _byte_classes;
+    size_t i = 0;
+    while (i < line.size()) {
+        const state_dfa_t& dfa = _states[state];
+        const int32_t *table = dfa.table.data();
+        int32_t row = i ? dfa.start : dfa.start_line;
+        int32_t rule = no_rule;
+        size_t end = i, j = i;
+        for (; j < line.size(); j++) {
+            row = table[row + byte_classes[uint8_t(line[j])]];
+            if (row == dead) break;
+            int32_t accepted = table[row + stride - 2];
+            if (accepted != no_rule) {
+                rule = accepted;
+                end = j + 1;
+            }
+        }
+        // $ only matches here
+        if (j == line.size() && row != dead && table[row + stride - 1] != no_rule) {
+            rule = table[row + stride - 1];
+            end = j;
+        }
+        // a rule ran on long past its last accept, the next scans could go over the same bytes again, from every position
+        if (j - end >= failed_rows_t::min_failed_run) return lex_line_recording(state, line, i, o_spans);
+        if (rule == no_rule) {
+            i++;
+            continue;
+        }
+        const rule_t& matched = dfa.rules[rule];
+        if (matched.token != token_t::plain) o_spans.push_back({ i, end - i, matched.token });
+        state = matched.next;
+        i = end;
+    }
+    return state;
+}
+
+grammar_t::state_t grammar_t::lex_line_recording(state_t state, std::string_view line, size_t i, std::vector<token_span_t>& o_spans) const {
+    const size_t stride = this->stride();
+    const uint8_t *byte_classes = _byte_classes;
+    failed_rows_t failed(line.size(), stride);
+    while (i < line.size()) {
+        const state_dfa_t& dfa = _states[state];
+        const int32_t *table = dfa.table.data();
+        int32_t row = i ? dfa.start : dfa.start_line;
+        int32_t rule = no_rule, end_row = row;
+        size_t end = i, j = i;
+        for (; j < line.size(); j++) {
+            row = table[row + byte_classes[uint8_t(line[j])]];
+            if (row == dead || failed.contains(state, row, j + 1)) break;
+            int32_t accepted = table[row + stride - 2];
+            if (accepted != no_rule) {
+                rule = accepted;
+                end = j + 1;
+                end_row = row;
+            }
+        }
+        if (j == line.size() && row != dead && table[row + stride - 1] != no_rule) {
+            rule = table[row + stride - 1];
+            end = j;
+            end_row = row;
+        }
+        // the rows at end + 1 .. j, stepped through again from the accept
+        if (j - end >= failed_rows_t::min_failed_run) {
+            row = end_row;
+            for (size_t k = end; k < j; k++) {
+                row = table[row + byte_classes[uint8_t(line[k])]];
+                failed.record(state, row, k + 1);
+            }
+        }
+        if (rule == no_rule) {
+            i++;
+            continue;
+        }
+        const rule_t& matched = dfa.rules[rule];
+        if (matched.token != token_t::plain) o_spans.push_back({ i, end - i, matched.token });
+        state = matched.next;
+        i = end;
+    }
+    return state;
+}
+
+grammar_t::state_t grammar_t::state(std::string_view name) const {
+    for (size_t i = 0; i < _states.size(); i++) {
+        if (_states[i].name == name) return state_t(i);
+    }
+    return 0;
+}
+
+size_t grammar_t::dfa_state_count() const {
+    size_t count = 0;
+    for (const state_dfa_t& state : _states) count += state.table.size() / stride();
+    return count;
+}
+
+size_t grammar_t::memory_usage() const {
+    size_t bytes = sizeof(*this);
+    for (const state_dfa_t& state : _states) bytes += state.table.capacity() * sizeof(int32_t) + state.rules.capacity() * sizeof(rule_t) + state.name.capacity();
+    return bytes;
+}
+
+std::string_view grammar_t::cpp_source() {
+    // line_start has the rules of code, it is the whitespace at the start of a line, where a # still starts a directive (the span
+    // starts at the #, not at the start of the line)
+    // a symbol run takes a / that doesnt start a comment, but a run of 2 or more ending with a / followed by anything but the end of
+    // the line is split before the /, the lexer keeps it in the run but that can only be told from the byte after the run, this is
+    // the one place they differ (ex: "*/x" outside of a comment)
+    return R"(# c and c++, what source_lexer_t::language_t::cpp() highlights
+state code
+plain        ^[ \t\r]+ => line_start
+plain        \s+
+comment      //.*
+comment      /\*([^*]|\*+[^*/])*\*+/
+comment      /\*([^*]|\*+[^*/])*\** => block_comment
+string       "([^"\\]|\\.)*\\?"?
+string       '([^'\\]|\\.)*\\?'?
+number       ([0-9]|\.[0-9])([0-9a-zA-Z_.']|[eEpP][+\-])*
+preprocessor ^#[ \t]*\w*
+keyword      alignas|alignof|auto|break|case|catch|class|concept|const|consteval|constexpr|constinit|continue|co_await|co_return|co_yield|decltype|default|delete|do|else|enum|explicit|export|extern|false|for|friend|goto|if|inline|mutable|namespace|new|noexcept|nullptr|operator|private|protected|public|requires|return|sizeof|static|static_assert|static_cast|struct|switch|template|this|throw|true|try|typedef|typename|union|using|virtual|volatile|while
+type         bool|char|char8_t|char16_t|char32_t|double|float|int|int8_t|int16_t|int32_t|int64_t|long|ptrdiff_t|short|signed|size_t|uint8_t|uint16_t|uint32_t|uint64_t|unsigned|void|wchar_t
+plain        [a-zA-Z_]\w*
+symbol       ([\-+*%=<>!&|^~?:]|/[\-+%=<>!&|^~?:])+(/$)?|/[\-+%=<>!&|^~?:]?
+state line_start
+plain        [ \t\r]+
+plain        \s+ => code
+comment      //.* => code
+comment      /\*([^*]|\*+[^*/])*\*+/ => code
+comment      /\*([^*]|\*+[^*/])*\** => block_comment
+string       "([^"\\]|\\.)*\\?"? => code
+string       '([^'\\]|\\.)*\\?'? => code
+number       ([0-9]|\.[0-9])([0-9a-zA-Z_.']|[eEpP][+\-])* => code
+preprocessor #[ \t]*\w* => code
+keyword      alignas|alignof|auto|break|case|catch|class|concept|const|consteval|constexpr|constinit|continue|co_await|co_return|co_yield|decltype|default|delete|do|else|enum|explicit|export|extern|false|for|friend|goto|if|inline|mutable|namespace|new|noexcept|nullptr|operator|private|protected|public|requires|return|sizeof|static|static_assert|static_cast|struct|switch|template|this|throw|true|try|typedef|typename|union|using|virtual|volatile|while => code
+type         bool|char|char8_t|char16_t|char32_t|double|float|int|int8_t|int16_t|int32_t|int64_t|long|ptrdiff_t|short|signed|size_t|uint8_t|uint16_t|uint32_t|uint64_t|unsigned|void|wchar_t => code
+plain        [a-zA-Z_]\w* => code
+symbol       ([\-+*%=<>!&|^~?:]|/[\-+%=<>!&|^~?:])+(/$)?|/[\-+%=<>!&|^~?:]? => code
+plain        . => code
+state block_comment
+comment      ([^*]|\*+[^*/])*\*+/ => code
+comment      ([^*]|\*+[^*/])*\**
+)";
+}
+
+std::string_view grammar_t::config_source() {
+    return R"(# ini, toml, .conf, what source_lexer_t::language_t::config() highlights
+state normal
+plain        \s+
+comment      [#;].*
+string       "([^"\\]|\\.)*\\?"?
+string       '([^'\\]|\\.)*\\?'?
+number       ([0-9]|\.[0-9])([0-9a-zA-Z_.']|[eEpP][+\-])*
+keyword      false|no|off|on|true|yes
+plain        [a-zA-Z_]\w*
+symbol       [\-+*%=<>!&|^~?:/]+
+)";
+}
+
+} // namespace rope
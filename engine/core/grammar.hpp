@@ -0,0 +1,101 @@
+#ifndef CORE_GRAMMAR_HPP
+#define CORE_GRAMMAR_HPP
+
+#include "highlighter.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+#include <string_view>
+
+namespace rope {
+
+// highlighting rules compiled ahead of time into one table driven dfa per lexer state, for highlighter_t
+// a grammar is a list of states, each with rules of a token and a core::regex_t pattern, the file starts in the first state:
+//
+//     # whole line comments
+//     state code
+//     comment   //.*
+//     comment   /\*([^*]|\*+[^*/])*\** => block_comment
+//     keyword   if|else|while
+//     plain     [a-zA-Z_]\w*
+//     state block_comment
+//     comment   ([^*]|\*+[^*/])*\*+/ => code
+//
+// at every position the longest match of any rule of the current state wins, the first rule on a tie, the text it matched gets
+// the token of the rule (plain isnt reported) and "=> state" switches the state, bytes no rule matches are plain
+// all the rules of a state are a single dfa with the rule that accepts in every dfa state, so a line is scanned once whatever the
+// number of rules, the bytes after the longest match that the dfa still had to look at to know it was the longest are read again
+// by the next scan, for usual rules that is the one byte that ended the token, once a scan goes on far past its match the rest of
+// the line remembers the dfa rows scans failed in so none goes through the same row at the same position twice, which keeps a line
+// linear in its size whatever the rules ('a+b' on a line of 'a' would otherwise be quadratic)
+// compiling builds every dfa state up front (unlike core::dfa_t), which can take a while for big grammars, so load() keeps the
+// tables in a cache directory keyed by the hash of the grammar
+class grammar_t {
+public:
+    using state_t = uint16_t;
+
+    static constexpr uint32_t format_version = 2;  // of the cache files, bumped when the layout changes
+    static constexpr size_t max_dfa_states = size_t(1) << 16;  // per state
+
+    // throws std::runtime_error if the grammar or one of its patterns is malformed, or a state needs too many dfa states
+    static grammar_t compile(std::string_view source);
+
+    // the compiled grammar from cache_dir if it is there and valid, else compiled and written there (atomically, so editors sharing
+    // the directory never read a partial one), failing to write the cache isnt an error
+    static grammar_t load(std::string_view source, const std::filesystem::path& cache_dir);
+
+    // the hash the cache files are keyed by, stable across runs
+    static uint64_t hash(std::string_view source);
+
+    // std::nullopt if the file is missing, for another hash or format version, or corrupt
+    static std::optional<grammar_t> read(const std::filesystem::path& path, uint64_t hash);
+    bool write(const std::filesystem::path& path) const;
+
+    // grammars that tokenize like source_lexer_t::language_t::cpp() and config(), but for a corner of symbol runs in cpp, see
+    // grammar.cpp
+    static std::string_view cpp_source();
+    static std::string_view config_source();
+
+    state_t lex_line(state_t state, std::string_view line, std::vector<token_span_t>& o_spans) const;
+
+    // the index of the state called name, the first one if there is none
+    state_t state(std::string_view name) const;
+
+    size_t dfa_state_count() const;
+    size_t memory_usage() const;
+
+private:
+    struct rule_t {
+        token_t token;
+        state_t next;
+    };
+
+    // a row per dfa state, the next row (as the offset of its first entry) for every byte class, then the rule accepting there and
+    // the rule accepting there if the line ends right after it (-1 for none), row 0 is the dead state
+    struct state_dfa_t {
+        std::string name;
+        std::vector<rule_t> rules;
+        std::vector<int32_t> table;
+        int32_t start;
+        int32_t start_line;  // at the start of a line, where ^ matches
+    };
+
+    grammar_t() = default;
+
+    // lex_line from i on, remembering where scans failed so none goes over the same bytes in the same dfa row twice
+    state_t lex_line_recording(state_t state, std::string_view line, size_t i, std::vector<token_span_t>& o_spans) const;
+
+    size_t stride() const { return _byte_class_count + 2; }
+
+    uint64_t _hash = 0;
+    uint8_t _byte_classes[256];  // shared by all the states
+    uint32_t _byte_class_count = 0;
+    std::vector<state_dfa_t> _states;
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef CORE_HIGHLIGHTER_HPP
+#define CORE_HIGHLIGHTER_HPP
+
+#include "rope.hpp"
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <concepts>
+#include <string_view>
+
+namespace rope {
+
+// what a span of text is, the renderer picks the colour
+enum class token_t : uint8_t {
+    plain,
+    keyword,
+    type,
+    number,
+    string,
+    comment,
+    symbol,
+    preprocessor,
+};
+
+struct token_span_t {
+    size_t pos;
+    size_t size;
+    token_t token;
+    bool operator==(const token_span_t&) const = default;
+};
+
+// lexes a line at a time, the state carries what is still open at the end of a line (a block comment, a string) over to the next
+// one, lex_line() gets the line without its '\n' and appends the spans that arent plain with positions from the start of the line
+template <typename lexer_t>
+concept lexer_c = std::regular<typename lexer_t::state_t> && requires(const lexer_t& lexer, typename lexer_t::state_t state, std::string_view line, std::vector<token_span_t>& o_spans) {
+    { lexer.lex_line(state, line, o_spans) } -> std::same_as<typename lexer_t::state_t>;
+};
+
+// syntax highlighting of a rope that only re-lexes what an edit can have changed
+// the lexer state at the start of every line is kept, edits are found by diffing against the snapshot lexed last time (so they
+// dont have to be passed in), and re-lexing starts at the first edited line and stops at the first line past the edit whose start
+// state comes out the same as before
+// nothing past the lines asked for is lexed, opening a block comment at the top of a big file only re-lexes down to the viewport and
+// the rest is caught up with once it is scrolled to
+// the spans themselves arent kept, highlight() lexes the visible lines again from their start states, which is as cheap as reading
+// them back
+template <typename rope_type, lexer_c lexer_t>
+class highlighter_t {
+public:
+    using snapshot_t = typename rope_type::snapshot_t;
+    using state_t = typename lexer_t::state_t;
+
+    static constexpr size_t all_lines = std::numeric_limits<size_t>::max();
+
+    explicit highlighter_t(lexer_t lexer = {}) : _lexer(std::move(lexer)) {}
+
+    // catches up with the rope and makes the start states of the lines up to last_line (and the one after it) exact, the rope has to
+    // be indexed
+    // O(changes * log n) to find the edits, then O(lines re-lexed), a single char edit re-lexes the line it is on and usually nothing
+    // else
+    void update(const rope_type& rope, size_t last_line = all_lines) {
+        snapshot_t snapshot = rope.snapshot();
+        if (!_snapshot) {
+            // nothing is known, the stop condition cant be trusted till the end
+            _states.assign(snapshot.line_count(), state_t{});
+            _dirty.assign(1, { 0, _states.size() });
+        } else {
+            remap(*_snapshot, snapshot);
+        }
+        _snapshot = std::move(snapshot);
+        relex(last_line);
+    }
+
+    // the spans of the lines [first_line, last_line) with positions in the rope, for the renderer to colour the visible lines
+    void highlight(const rope_type& rope, size_t first_line, size_t last_line, std::vector<token_span_t>& o_spans) {
+        update(rope, last_line);
+        last_line = std::min(last_line, _states.size());
+        if (first_line >= last_line) return;
+        state_t state = _states[first_line];
+        for_each_line(first_line, [&](size_t line, size_t offset, std::string_view text) {
+            size_t first = o_spans.size();
+            state = _lexer.lex_line(state, text, o_spans);
+            for (size_t i = first; i < o_spans.size(); i++) o_spans[i].pos += offset;
+            return line + 1 < last_line;
+        });
+    }
+
+    // the state at the start of line, exact once update() has been called with a last_line past it
+    const state_t& state(size_t line) const { return _states[line]; }
+
+    // the first line whose start state isnt exact yet, the line count once everything is
+    size_t lexed_lines() const { return _dirty.empty() ? _states.size() : _dirty.front().first; }
+
+    const lexer_t& lexer() const { return _lexer; }
+
+    size_t memory_usage() const { return _states.capacity() * sizeof(state_t) + _dirty.capacity() * sizeof(range_t) + _spans.capacity() * sizeof(token_span_t) + _line.capacity(); }
+
+private:
+    // lines [first, second) have to be re-lexed, the state of the first one is exact
+    using range_t = std::pair<size_t, size_t>;
+
+    // the lines a change touched in the old and the new text, the first line of it starts at the same place in both
+    struct lines_t {
+        size_t first_a, last_a;
+        size_t first_b, last_b;
+    };
+
+    // moves the start states and the dirty ranges from the lines of a to the lines of b, the edited lines get dirty
+    void remap(const snapshot_t& a, const snapshot_t& b) {
+        std::vector<typename rope_type::change_t> changes = rope_type::diff(a, b);
+        if (changes.empty()) return;
+        std::vector<lines_t> lines;
+        lines.reserve(changes.size());
+        for (const auto& change : changes) {
+            lines.push_back({ a.offset_to_line(change.pos), a.offset_to_line(change.pos + change.n), b.offset_to_line(change.new_pos), b.offset_to_line(change.new_pos + change.new_n) });
+        }
+        std::vector<range_t> dirty(_dirty);
+        // typing within a line keeps every line where it was, only the edited ones get dirty
+        if (std::all_of(lines.begin(), lines.end(), [](const lines_t& lines) { return lines.last_a - lines.first_a == lines.last_b - lines.first_b; })) {
+            for (const lines_t& change : lines) dirty.push_back({ change.first_b, change.last_b + 1 });
+            merge_dirty(dirty);
+            return;
+        }
+        // line of a to line of b, the lines inside a change go to its last line
+        auto map_line = [&](size_t line) {
+            auto itr = std::upper_bound(lines.begin(), lines.end(), line, [](size_t line, const lines_t& lines) { return line < lines.first_a; });
+            if (itr == lines.begin()) return line;
+            --itr;
+            if (line <= itr->last_a) return line == itr->first_a ? itr->first_b : itr->last_b;
+            return line - itr->last_a + itr->last_b;
+        };
+        for (range_t& range : dirty) range = { map_line(range.first), map_line(range.second - 1) + 1 };
+        std::vector<state_t> states;
+        states.reserve(b.line_count());
+        size_t next = 0;  // the next line of a to copy
+        for (const lines_t& change : lines) {
+            // the start of the first line is before the change, so its state carries over
+            if (change.first_a >= next) states.insert(states.end(), _states.begin() + next, _states.begin() + change.first_a + 1);
+            states.resize(std::max(states.size(), change.last_b + 1));
+            dirty.push_back({ change.first_b, change.last_b + 1 });
+            next = std::max(next, change.last_a + 1);
+        }
+        states.insert(states.end(), _states.begin() + next, _states.end());
+        assert(states.size() == b.line_count());
+        _states = std::move(states);
+        merge_dirty(dirty);
+    }
+
+    // _dirty becomes the ranges sorted and merged
+    void merge_dirty(std::vector<range_t>& dirty) {
+        std::sort(dirty.begin(), dirty.end());
+        _dirty.clear();
+        for (range_t range : dirty) {
+            if (!_dirty.empty() && range.first <= _dirty.back().second) _dirty.back().second = std::max(_dirty.back().second, range.second);
+            else _dirty.push_back(range);
+        }
+    }
+
+    // re-lexes the dirty ranges till the start states are exact up to last_line + 1
+    void relex(size_t last_line) {
+        size_t done = 0;  // dirty ranges finished
+        while (done < _dirty.size() && _dirty[done].first <= last_line) {
+            auto [first, end] = _dirty[done++];
+            state_t state = _states[first];
+            for_each_line(first, [&](size_t line, size_t, std::string_view text) {
+                _spans.clear();
+                state = _lexer.lex_line(state, text, _spans);
+                line++;
+                if (line == _states.size()) {
+                    done = _dirty.size();
+                    return false;
+                }
+                // the ranges this one runs into are taken over
+                while (done < _dirty.size() && _dirty[done].first <= line) end = std::max(end, _dirty[done++].second);
+                if (line >= end && _states[line] == state) return false;
+                _states[line] = state;
+                if (line > last_line) {
+                    // the rest is left for later, the state of line is exact so it is where the range starts again
+                    _dirty[--done] = { line, std::max(end, line + 1) };
+                    return false;
+                }
+                return true;
+            });
+        }
+        _dirty.erase(_dirty.begin(), _dirty.begin() + done);
+    }
+
+    // callback(line, offset, text) for the lines from first_line on till it returns false, a line in a single chunk is passed
+    // straight from the rope, only the ones crossing chunks are copied
+    template <typename callback_t>
+    void for_each_line(size_t first_line, callback_t&& callback) {
+        const snapshot_t& snapshot = *_snapshot;
+        size_t offset = snapshot.line_to_offset(first_line), line = first_line;
+        size_t line_offset = offset;
+        _line.clear();
+        bool partial = false;  // the start of the line is in _line
+        for (std::string_view chunk : snapshot.chunks(offset, snapshot.size() - offset)) {
+            while (!chunk.empty()) {
+                const char *newline = static_cast<const char *>(std::memchr(chunk.data(), '\n', chunk.size()));
+                if (!newline) {
+                    _line.append(chunk);
+                    partial = true;
+                    break;
+                }
+                size_t n = size_t(newline - chunk.data());
+                std::string_view text = chunk.substr(0, n);
+                if (partial) {
+                    _line.append(text);
+                    text = _line;
+                }
+                if (!callback(line, line_offset, text)) return;
+                line++;
+                line_offset += (partial ? _line.size() : n) + 1;
+                _line.clear();
+                partial = false;
+                chunk.remove_prefix(n + 1);
+            }
+        }
+        // the last line has no '\n'
+        callback(line, line_offset, std::string_view(_line));
+    }
+
+    lexer_t _lexer;
+    std::optional<snapshot_t> _snapshot;  // the text the states are for
+    std::vector<state_t> _states;  // at the start of every line
+    std::vector<range_t> _dirty;  // sorted and not touching
+    std::vector<token_span_t> _spans;  // kept to not allocate on every relex()
+    std::string _line;  // a line crossing chunks
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef CORE_PARALLEL_SEARCH_HPP
+#define CORE_PARALLEL_SEARCH_HPP
+
+#include "search.hpp"
+#include "thread_pool.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <condition_variable>
+
+namespace rope {
+
+// find_all() of a literal_search_t or a regex_search_t over a snapshot_t, run on a thread pool
+// the document is cut into ranges that are searched in parallel, the ranges are merged back in order as they finish so the matches
+// can be taken a batch at a time while the rest is still being searched, the result is the same as the searcher's own find_all()
+// a literal range reads m - 1 bytes into the next one, so every match starting in it is found, and the merge keeps the non
+// overlapping ones
+// a regex range keeps the matches that start in it (they can run on past its end), the merge redoes the search where a match from
+// one range overlaps the start of the next one, till it lines up with what that range found again
+// the merge runs on one task at a time, the one that gets there first merges the ranges the others finish meanwhile, and hands the
+// matches over a batch at a time, so the ui only ever waits for a batch being handed over, never for a merge
+template <typename text_t, typename searcher_t>
+class find_all_job_t {
+    static constexpr bool is_regex = std::is_same_v<searcher_t, regex_search_t>;
+
+public:
+    static constexpr size_t range_size = size_t(1) << 20;
+    // the most a literal range searches between two looks at cancelled()
+    static constexpr size_t step_size = size_t(1) << 16;
+
+    // text is kept alive by the job, so edits to the rope it was taken from dont affect the search
+    static std::shared_ptr<find_all_job_t> start(core::thread_pool_t& pool, text_t text, const searcher_t& searcher, size_t limit = ~size_t{ 0 }) {
+        std::shared_ptr<find_all_job_t> job{ new find_all_job_t(std::move(text), searcher, limit) };
+        if (!limit) job->cancel();
+        for (size_t i = 0; i < job->_ranges.size(); i++) pool.submit([job, i] { job->run(i); });
+        return job;
+    }
+
+    // returns immediately, the queued ranges dont start, literal ranges being searched stop within step_size bytes, regex ones (and
+    // the merge) within a range, give or take a match attempt that keeps going past it
+    void cancel() { _cancelled.store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const { return _cancelled.load(std::memory_order_relaxed); }
+
+    // appends the matches merged since the last call, in order, returns how many
+    // never waits for a merge, only for a batch of matches being handed over, so a ui thread can poll it every frame
+    size_t take(std::vector<match_t>& o_matches) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t count = _matches.size();
+        o_matches.insert(o_matches.end(), _matches.begin(), _matches.end());
+        _matches.clear();
+        return count;
+    }
+
+    // every range was searched and merged, or the job was cancelled (or hit its limit) and none of its tasks are running anymore
+    bool done() const { return _returned.load(std::memory_order_acquire) == _ranges.size(); }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] { return done(); });
+    }
+
+    // fraction of the document merged so far
+    float progress() const { return float(_merged.load(std::memory_order_relaxed)) / float(_ranges.size()); }
+
+private:
+    struct found_t {
+        match_t match;
+        size_t from;  // where the search that found it started, 0 for literals since every match in the range is kept
+    };
+
+    struct range_t {
+        std::vector<found_t> found;
+        size_t resume = npos;  // the range wasnt searched from here on, the merge does it
+        std::atomic<bool> finished{ false };  // found and resume are set
+    };
+
+    static constexpr size_t npos = ~size_t{ 0 };
+
+    find_all_job_t(text_t text, const searcher_t& searcher, size_t limit)
+      : _text(std::move(text)), _searcher(searcher), _limit(limit), _ranges(std::max(size_t(1), (_text.size() + range_size - 1) / range_size)) {}
+
+    void run(size_t i) {
+        std::vector<found_t> found;
+        size_t resume = npos;
+        size_t begin = i * range_size, end = std::min(_text.size(), begin + range_size);
+        if constexpr (is_regex) {
+            regex_search_t search{ _searcher.regex() };
+            // a match can run on past the range, but the search gives up a range later and leaves the rest to the merge, otherwise a
+            // match that keeps going without ever matching (a+b over aaaa...) would be scanned to the end of the document by every range
+            size_t limit = std::min(_text.size(), end + range_size);
+            for (size_t from = begin; from < end && !cancelled();) {
+                bool truncated;
+                std::optional<match_t> match = search.find_starting_in(_text, from, end, limit, truncated);
+                if (truncated) resume = from;
+                if (!match) break;
+                found.push_back({ *match, from });
+                from = match->pos + std::max(match->size, size_t(1));
+            }
+        } else {
+            size_t m = _searcher.needle().size();
+            // a step at a time so that a cancel is seen
+            for (size_t from = begin; from < end && !cancelled(); from += step_size) {
+                size_t to = std::min(end, from + step_size);
+                _searcher.for_each(_text, from, std::min(_text.size(), to + m - 1), [&](size_t pos) {
+                    if (pos >= to) return false;
+                    found.push_back({ { pos, m }, 0 });
+                    return true;
+                });
+            }
+        }
+        _ranges[i].found = std::move(found);
+        _ranges[i].resume = resume;
+        _ranges[i].finished.store(true, std::memory_order_release);
+
+        // the task that takes the requests from 0 merges, and goes again for every request made while it was at it, the others leave
+        // their range to it
+        if (!_merge_requests.fetch_add(1, std::memory_order_acq_rel)) {
+            for (size_t requests = 1; requests; requests = _merge_requests.fetch_sub(requests, std::memory_order_acq_rel) - requests) {
+                merge();
+                publish();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_returned.fetch_add(1, std::memory_order_release) + 1 == _ranges.size()) _condition.notify_all();
+    }
+
+    // merges the finished ranges that come next in order, only ever called by one task at a time
+    void merge() {
+        size_t merged = _merged.load(std::memory_order_relaxed);
+        for (; merged < _ranges.size() && _ranges[merged].finished.load(std::memory_order_acquire) && !cancelled(); _merged.store(++merged, std::memory_order_relaxed)) {
+            range_t& range = _ranges[merged];
+            size_t begin = merged * range_size, end = std::min(_text.size(), begin + range_size);
+            if (_synced) _from = std::max(_from, begin);
+            bool accepted = false;
+            for (const found_t& found : range.found) {
+                accepted = false;
+                while (found.match.pos >= _from && !accepted) {
+                    // the search that found it started at or before _from, so it is also the next match of the serial find_all
+                    if (found.from <= _from) {
+                        accept(found.match);
+                        accepted = true;
+                        continue;
+                    }
+                    // a match overlapping the range start pushed _from past where this range started searching, redo it from there
+                    std::optional<match_t> match = next_match();
+                    if (cancelled()) return;
+                    assert(match && match->pos <= found.match.pos);  // found.match is one of the candidates
+                    accept(*match);
+                    accepted = *match == found.match;
+                }
+                if (_count >= _limit) break;
+            }
+            // the serial find_all is lined up with what this range found at its end, so it wont match again before the next range
+            _synced = range.found.empty() ? _from >= begin : accepted;
+            // an empty match at the very end of the document doesnt start inside any range, the last one picks it up
+            bool last = merged + 1 == _ranges.size();
+            if (is_regex && last && range.resume == npos) {
+                if (_synced) _from = std::max(_from, end);
+                range.resume = _from;
+            }
+            if (range.resume != npos && _count < _limit) {
+                std::optional<match_t> match;
+                while ((match = next_match()) && (last || match->pos < end) && _count < _limit) accept(*match);
+                if (cancelled()) return;
+                _synced = true;
+            }
+            range.found = {};
+            publish();
+            if (_count >= _limit) {
+                _merged.store(merged + 1, std::memory_order_relaxed);
+                cancel();
+                break;
+            }
+        }
+    }
+
+    // hands the matches accepted so far over to take()
+    void publish() {
+        if (_accepted.empty()) return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _matches.insert(_matches.end(), _accepted.begin(), _accepted.end());
+        _accepted.clear();
+    }
+
+    // next match of the serial find_all, searched a range at a time so that a cancel stops it, a match attempt that keeps going past
+    // a range is read twice as far every time, and once one has gone on to the end of the text the rest is searched in one go
+    // literal ranges find every match in them, so this is only needed for regexes
+    std::optional<match_t> next_match() {
+        if constexpr (is_regex) {
+            // still the leftmost match if nothing was accepted before it
+            if (_lookahead_from <= _from && (!_lookahead || _lookahead->pos >= _from)) return _lookahead;
+            std::optional<match_t> match;
+            size_t from = _from;
+            while (!match && from < _text.size()) {
+                size_t to = std::min(_text.size(), from + range_size), limit = to;
+                bool truncated;
+                while (true) {
+                    if (cancelled()) return std::nullopt;
+                    match = _searcher.find_starting_in(_text, from, to, limit, truncated);
+                    if (!truncated) break;
+                    limit = std::min(_text.size(), limit + (limit - from));
+                }
+                from = to;
+                // every range after this one would be read to the end again
+                if (limit == _text.size()) break;
+            }
+            if (!match && from <= _text.size()) match = _searcher.find(_text, from);
+            _lookahead = match;
+            _lookahead_from = _from;
+            return match;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    void accept(const match_t& match) {
+        // same as find_all(), an empty match right where the previous one ended isnt reported
+        if (match.size || !_count || _last_end != match.pos) {
+            _accepted.push_back(match);
+            _count++;
+            _last_end = match.pos + match.size;
+            if (_accepted.size() >= 1024) publish();
+        }
+        _from = match.pos + std::max(match.size, size_t(1));
+    }
+
+    text_t _text;
+    searcher_t _searcher;  // only used by merge() for regexes, the ranges make their own
+    size_t _limit;
+    std::atomic<bool> _cancelled{ false };
+
+    std::vector<range_t> _ranges;
+    std::atomic<size_t> _returned{ 0 };  // ranges whose task is over
+    std::atomic<size_t> _merged{ 0 };  // ranges merged, always a prefix
+
+    std::atomic<size_t> _merge_requests{ 0 };  // ranges finished since the merging task last looked, a task is merging while not 0
+    // only touched by the merging task, everything from here to _accepted
+    size_t _from = 0;  // where the serial find_all would search next
+    bool _synced = true;  // no match of the serial find_all starts between _from and the start of the next range to merge
+    size_t _count = 0;  // matches merged
+    size_t _last_end = 0;
+    std::optional<match_t> _lookahead;  // what next_match() found last, and where from
+    size_t _lookahead_from = npos;
+    std::vector<match_t> _accepted;  // merged but not published yet
+
+    std::mutex _mutex;  // _matches, and _returned for wait()
+    std::condition_variable _condition;
+    std::vector<match_t> _matches;  // published but not taken yet
+};
+
+// text has to be a snapshot_t (or anything else safe to read from other threads), searcher a literal_search_t or a regex_search_t
+template <typename text_t, typename searcher_t>
+std::shared_ptr<find_all_job_t<text_t, searcher_t>> find_all_parallel(core::thread_pool_t& pool, text_t text, const searcher_t& searcher, size_t limit = ~size_t{ 0 }) {
+    return find_all_job_t<text_t, searcher_t>::start(pool, std::move(text), searcher, limit);
+}
+
+} // namespace rope
+
+#endif
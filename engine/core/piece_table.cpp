@@ -0,0 +1,105 @@
+#include "piece_table.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace rope {
+
+piece_table_t::piece_table_t(std::string_view str) : _owned(std::make_shared<const std::string>(str)), _original(*_owned), _added(std::make_shared<added_t>()) {
+    if (!_original.empty()) _pieces.push_back(_original);
+    _starts.push_back(0);
+    fix_starts(0);
+}
+
+piece_table_t::piece_table_t(std::shared_ptr<const core::mapped_file_t> mapped_file)
+  : _mapped_file(std::move(mapped_file)), _original(_mapped_file->data(), _mapped_file->size()), _added(std::make_shared<added_t>()) {
+    if (!_original.empty()) _pieces.push_back(_original);
+    _starts.push_back(0);
+    fix_starts(0);
+}
+
+void piece_table_t::slice(size_t pos, size_t n, char *o_str) const {
+    for (std::string_view chunk : chunks(pos, n)) {
+        std::memcpy(o_str, chunk.data(), chunk.size());
+        o_str += chunk.size();
+    }
+}
+
+void piece_table_t::set_slice(const char *str, size_t size, size_t pos, size_t n) {
+    assert(pos <= this->size() && pos + n <= this->size());  // bounds check
+    if (!size && !n) return;
+    size_t end = pos + n;
+    // pieces [first, last) are replaced by what is left of them around the edit, and the inserted text
+    size_t first = pos < this->size() ? find_segment(pos) : _pieces.size();
+    size_t last = end < this->size() ? find_segment(end) + 1 : _pieces.size();
+    std::string_view head, tail;
+    if (first < _pieces.size()) head = _pieces[first].substr(0, pos - _starts[first]);
+    if (end < this->size()) tail = _pieces[last - 1].substr(end - _starts[last - 1]);
+    std::string_view inserted;
+    size_t fix_from = first;
+    if (size) {
+        const char *data = _added->append(str, size);
+        // typing carries on the last insert, grow its piece instead of adding one
+        if (!head.empty() && !is_original(head) && head.data() + head.size() == data) {
+            head = { head.data(), head.size() + size };
+        } else if (head.empty() && first && !is_original(_pieces[first - 1]) && _pieces[first - 1].data() + _pieces[first - 1].size() == data) {
+            _pieces[first - 1] = { _pieces[first - 1].data(), _pieces[first - 1].size() + size };
+            fix_from = first - 1;
+        } else {
+            inserted = { data, size };
+        }
+    }
+    std::string_view replacement[3];
+    size_t count = 0;
+    for (std::string_view piece : { head, inserted, tail }) {
+        if (!piece.empty()) replacement[count++] = piece;
+    }
+    size_t replaced = last - first;
+    if (count <= replaced) {
+        std::copy_n(replacement, count, _pieces.begin() + first);
+        _pieces.erase(_pieces.begin() + first + count, _pieces.begin() + last);
+    } else {
+        std::copy_n(replacement, replaced, _pieces.begin() + first);
+        _pieces.insert(_pieces.begin() + last, replacement + replaced, replacement + count);
+    }
+    fix_starts(fix_from);
+}
+
+std::string piece_table_t::to_string() const {
+    std::string str;
+    str.reserve(size());
+    for (std::string_view piece : _pieces) str.append(piece);
+    return str;
+}
+
+size_t piece_table_t::memory_usage() const {
+    size_t bytes = _pieces.capacity() * sizeof(std::string_view) + _starts.capacity() * sizeof(size_t) + _added->bytes;
+    if (_owned) bytes += _original.size();
+    return bytes;
+}
+
+size_t piece_table_t::find_segment(size_t pos) const {
+    assert(pos < size());  // bounds check
+    return size_t(std::upper_bound(_starts.begin(), _starts.end(), pos) - _starts.begin()) - 1;
+}
+
+void piece_table_t::fix_starts(size_t from) {
+    _starts.resize(_pieces.size() + 1);
+    for (size_t i = from; i < _pieces.size(); i++) _starts[i + 1] = _starts[i] + _pieces[i].size();
+}
+
+const char *piece_table_t::added_t::append(const char *str, size_t size) {
+    if (used + size > capacity) {
+        // a big paste gets a block of its own
+        capacity = std::max(block_size, size);
+        blocks.emplace_back(new char[capacity]);
+        bytes += capacity;
+        used = 0;
+    }
+    char *data = blocks.back().get() + used;
+    std::memcpy(data, str, size);
+    used += size;
+    return data;
+}
+
+} // namespace rope
@@ -0,0 +1,85 @@
+#ifndef CORE_PIECE_TABLE_HPP
+#define CORE_PIECE_TABLE_HPP
+
+#include "text_storage.hpp"
+#include "file.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <string_view>
+
+namespace rope {
+
+// the text is a list of pieces pointing into the original text (never written to, a mapped file stays mapped) or into an append
+// only buffer of everything inserted, an edit only splits and drops pieces, no text is ever moved
+// copies share both buffers and only copy the piece list, so keeping a copy per undo step costs a few words per piece no matter
+// how big the file is, the cheap undo for large originals text_buffer_t picks it for
+// the piece list is a flat array, so edits and lookups are O(pieces) (a memmove and a prefix sum) with a small constant, typing
+// at the end of the last insert grows that piece instead of adding one
+class piece_table_t {
+public:
+    // the original is copied once into a buffer the pieces point into
+    explicit piece_table_t(std::string_view str);
+
+    // O(1), nothing in the file is read, the original pieces point into the mapping
+    explicit piece_table_t(std::shared_ptr<const core::mapped_file_t> mapped_file);
+
+    void slice(size_t pos, size_t n, char *o_str) const;
+    void set_slice(const char *str, size_t size, size_t pos, size_t n);
+    void insert(const char *str, size_t size, size_t pos) { set_slice(str, size, pos, 0); }
+    void erase(size_t pos, size_t n) { set_slice(nullptr, 0, pos, n); }
+
+    segments_view_t<piece_table_t> chunks() const { return chunks(0, size()); }
+    segments_view_t<piece_table_t> chunks(size_t pos, size_t n) const {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        return { this, pos, pos + n };
+    }
+
+    std::string to_string() const;
+
+    size_t size() const { return _starts.back(); }
+
+    // the piece list, the inserted text and the original if it isnt mapped, copies count the shared buffers too
+    size_t memory_usage() const;
+
+    size_t piece_count() const { return _pieces.size(); }
+
+    // the original text, pieces pointing into it are always in order
+    std::string_view original() const { return _original; }
+    // null if the original isnt mapped
+    const std::shared_ptr<const core::mapped_file_t>& mapped_file() const { return _mapped_file; }
+    bool is_original(std::string_view piece) const { return piece.data() >= _original.data() && piece.data() < _original.data() + _original.size(); }
+
+    size_t segment_count() const { return _pieces.size(); }
+    std::string_view segment(size_t i) const { return _pieces[i]; }
+    size_t segment_start(size_t i) const { return _starts[i]; }
+    size_t find_segment(size_t pos) const;
+
+private:
+    // inserted text goes into blocks that are never reallocated, so the pieces can point straight into them
+    struct added_t {
+        static constexpr size_t block_size = size_t(64) << 10;
+
+        const char *append(const char *str, size_t size);
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t capacity = 0;  // of the last block
+        size_t used = 0;
+        size_t bytes = 0;  // allocated
+    };
+
+    void fix_starts(size_t from);
+
+    std::shared_ptr<const std::string> _owned;  // the original, unless it is mapped
+    std::shared_ptr<const core::mapped_file_t> _mapped_file;
+    std::string_view _original;
+    std::shared_ptr<added_t> _added;
+    std::vector<std::string_view> _pieces;  // never empty ones
+    std::vector<size_t> _starts;  // offset of every piece, and the size at the end
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,532 @@
+#include "regex.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+namespace core {
+
+static constexpr size_t max_repeat = 1000;
+static constexpr size_t max_nfa_states = size_t(1) << 20;
+static constexpr size_t max_nesting = 256;
+static constexpr size_t infinite = ~size_t{ 0 };
+
+struct regex_t::node_t {
+    enum kind_t {
+        empty,
+        byte_set,
+        concat,
+        alternate,
+        repeat,
+        begin_line,
+        end_line,
+    };
+    kind_t kind;
+    uint32_t set = 0;
+    size_t min = 0, max = 0;
+    std::vector<node_t> children;
+};
+
+class regex_t::parser_t {
+public:
+    parser_t(std::string_view pattern, std::vector<std::bitset<256>>& sets) : _pattern(pattern), _sets(sets) {}
+
+    node_t parse() {
+        node_t node = alternation(0);
+        if (_pos != _pattern.size()) error("unmatched )");
+        return node;
+    }
+
+private:
+    [[noreturn]] void error(const char *what) const {
+        throw std::runtime_error("regex: " + std::string(what) + " at " + std::to_string(_pos) + " in \"" + std::string(_pattern) + "\"");
+    }
+
+    bool done() const { return _pos == _pattern.size(); }
+    char peek() const { return _pattern[_pos]; }
+
+    bool eat(char c) {
+        if (done() || peek() != c) return false;
+        _pos++;
+        return true;
+    }
+
+    node_t set_node(const std::bitset<256>& set) {
+        _sets.push_back(set);
+        return { .kind = node_t::byte_set, .set = uint32_t(_sets.size() - 1) };
+    }
+
+    node_t alternation(size_t depth) {
+        if (depth > max_nesting) error("too deeply nested");
+        node_t node{ .kind = node_t::alternate };
+        node.children.push_back(concatenation(depth));
+        while (eat('|')) node.children.push_back(concatenation(depth));
+        if (node.children.size() == 1) return std::move(node.children.front());
+        return node;
+    }
+
+    node_t concatenation(size_t depth) {
+        node_t node{ .kind = node_t::concat };
+        while (!done() && peek() != '|' && peek() != ')') node.children.push_back(repetition(depth));
+        if (node.children.empty()) return { .kind = node_t::empty };
+        if (node.children.size() == 1) return std::move(node.children.front());
+        return node;
+    }
+
+    node_t repetition(size_t depth) {
+        node_t node = atom(depth);
+        while (!done()) {
+            size_t min, max;
+            if (eat('*')) min = 0, max = infinite;
+            else if (eat('+')) min = 1, max = infinite;
+            else if (eat('?')) min = 0, max = 1;
+            else if (!done() && peek() == '{' && counted(min, max)) {}
+            else break;
+            eat('?');  // lazy, makes no difference for leftmost longest
+            if (node.kind == node_t::begin_line || node.kind == node_t::end_line) error("nothing to repeat");
+            node_t repeat{ .kind = node_t::repeat, .min = min, .max = max };
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return node;
+    }
+
+    // {n} {n,} {n,m}, a '{' that doesnt start one of those is a literal
+    bool counted(size_t& min, size_t& max) {
+        size_t start = _pos++;
+        auto number = [&](size_t& o_value) {
+            size_t digits = 0;
+            o_value = 0;
+            while (!done() && peek() >= '0' && peek() <= '9') {
+                o_value = o_value * 10 + (_pattern[_pos++] - '0');
+                if (o_value > max_repeat) error("repeat count too large");
+                digits++;
+            }
+            return digits != 0;
+        };
+        if (!number(min)) {
+            _pos = start;
+            return false;
+        }
+        max = min;
+        if (eat(',') && !number(max)) max = infinite;
+        if (!eat('}')) {
+            _pos = start;
+            return false;
+        }
+        if (max < min) error("bad repeat range");
+        return true;
+    }
+
+    node_t atom(size_t depth) {
+        char c = _pattern[_pos++];
+        switch (c) {
+            case '(': {
+                if (eat('?') && !eat(':')) error("unsupported group");
+                node_t node = alternation(depth + 1);
+                if (!eat(')')) error("missing )");
+                return node;
+            }
+            case '[':
+                return set_node(bracket());
+            case '.': {
+                std::bitset<256> set;
+                set.set();
+                set.reset('\n');
+                return set_node(set);
+            }
+            case '^':
+                return { .kind = node_t::begin_line };
+            case '$':
+                return { .kind = node_t::end_line };
+            case '*': case '+': case '?':
+                error("nothing to repeat");
+            case '\\':
+                return set_node(escape());
+            default: {
+                std::bitset<256> set;
+                set.set(uint8_t(c));
+                return set_node(set);
+            }
+        }
+    }
+
+    static std::bitset<256> range(uint8_t from, uint8_t to) {
+        std::bitset<256> set;
+        for (size_t c = from; c <= to; c++) set.set(c);
+        return set;
+    }
+
+    // after the '\', returns the set of bytes it stands for
+    std::bitset<256> escape() {
+        if (done()) error("trailing \\");
+        char c = _pattern[_pos++];
+        std::bitset<256> set;
+        switch (c) {
+            case 'd': return range('0', '9');
+            case 'D': return ~range('0', '9');
+            case 'w': return range('a', 'z') | range('A', 'Z') | range('0', '9') | range('_', '_');
+            case 'W': return ~(range('a', 'z') | range('A', 'Z') | range('0', '9') | range('_', '_'));
+            case 's': return range(' ', ' ') | range('\t', '\r');
+            case 'S': return ~(range(' ', ' ') | range('\t', '\r'));
+            case 'n': set.set('\n'); return set;
+            case 't': set.set('\t'); return set;
+            case 'r': set.set('\r'); return set;
+            case 'f': set.set('\f'); return set;
+            case 'v': set.set('\v'); return set;
+            case '0': set.set(0); return set;
+            case 'x': {
+                auto hex = [&](char h) -> int {
+                    if (h >= '0' && h <= '9') return h - '0';
+                    if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+                    if (h >= 'A' && h <= 'F') return h - 'A' + 10;
+                    error("bad \\x escape");
+                };
+                if (_pos + 2 > _pattern.size()) error("bad \\x escape");
+                int value = hex(_pattern[_pos]) * 16 + hex(_pattern[_pos + 1]);
+                _pos += 2;
+                set.set(value);
+                return set;
+            }
+            default:
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) error("unsupported escape");
+                set.set(uint8_t(c));
+                return set;
+        }
+    }
+
+    // after the '[', consumes upto and including the ']'
+    std::bitset<256> bracket() {
+        std::bitset<256> set;
+        bool negated = eat('^');
+        bool first = true;
+        while (true) {
+            if (done()) error("missing ]");
+            if (peek() == ']' && !first) {
+                _pos++;
+                break;
+            }
+            first = false;
+            // a single byte, or a whole class like \d which cant start a range
+            auto member = [&](bool& o_single) -> std::bitset<256> {
+                char c = _pattern[_pos++];
+                if (c != '\\') {
+                    o_single = true;
+                    return range(uint8_t(c), uint8_t(c));
+                }
+                std::bitset<256> escaped = escape();
+                o_single = escaped.count() == 1;
+                return escaped;
+            };
+            bool single;
+            std::bitset<256> from = member(single);
+            if (single && _pos + 1 < _pattern.size() && peek() == '-' && _pattern[_pos + 1] != ']') {
+                _pos++;
+                bool to_single;
+                std::bitset<256> to = member(to_single);
+                if (!to_single) error("bad range");
+                size_t lo = 0, hi = 0;
+                while (!from[lo]) lo++;
+                while (!to[hi]) hi++;
+                if (hi < lo) error("bad range");
+                set |= range(uint8_t(lo), uint8_t(hi));
+            } else {
+                set |= from;
+            }
+        }
+        return negated ? ~set : set;
+    }
+
+    std::string_view _pattern;
+    std::vector<std::bitset<256>>& _sets;
+    size_t _pos = 0;
+};
+
+regex_t::regex_t(std::string_view pattern) : _pattern(pattern) {
+    node_t root = parser_t{ pattern, _sets }.parse();
+
+    for (auto [nfa, reversed] : { std::pair{ &_forward, false }, std::pair{ &_reverse, true } }) {
+        uint32_t match = push(*nfa, { .kind = nfa_state_t::match });
+        nfa->start = compile(root, match, reversed, *nfa);
+    }
+
+    // a class boundary wherever any set changes from one byte to the next
+    std::bitset<256> boundaries;
+    boundaries.set('\n');
+    boundaries.set('\n' + 1);
+    for (const auto& set : _sets) {
+        for (size_t c = 1; c < 256; c++) {
+            if (set[c] != set[c - 1]) boundaries.set(c);
+        }
+    }
+    _byte_class_count = 0;
+    for (size_t c = 0; c < 256; c++) {
+        if (c && boundaries[c]) _byte_class_count++;
+        _byte_classes[c] = uint8_t(_byte_class_count);
+    }
+    _byte_class_count++;
+}
+
+uint32_t regex_t::push(nfa_t& nfa, nfa_state_t state) {
+    if (nfa.states.size() >= max_nfa_states) throw std::runtime_error("regex: pattern too large \"" + _pattern + "\"");
+    nfa.states.push_back(state);
+    return uint32_t(nfa.states.size() - 1);
+}
+
+// builds the states for node in front of next (backwards, so nothing has to be patched later), returns the entry state
+// reversed builds the regex that matches the reversed text, concatenations are reversed and the anchors swapped
+uint32_t regex_t::compile(const node_t& node, uint32_t next, bool reversed, nfa_t& nfa) {
+    switch (node.kind) {
+        case node_t::empty:
+            return next;
+        case node_t::byte_set:
+            return push(nfa, { .kind = nfa_state_t::byte_set, .next = next, .set = node.set });
+        case node_t::begin_line:
+            return push(nfa, { .kind = reversed ? nfa_state_t::end_line : nfa_state_t::begin_line, .next = next });
+        case node_t::end_line:
+            return push(nfa, { .kind = reversed ? nfa_state_t::begin_line : nfa_state_t::end_line, .next = next });
+        case node_t::concat:
+            if (reversed) {
+                for (const node_t& child : node.children) next = compile(child, next, reversed, nfa);
+            } else {
+                for (auto child = node.children.rbegin(); child != node.children.rend(); child++) next = compile(*child, next, reversed, nfa);
+            }
+            return next;
+        case node_t::alternate: {
+            uint32_t entry = compile(node.children.back(), next, reversed, nfa);
+            for (size_t i = node.children.size() - 1; i-- > 0;) {
+                uint32_t child = compile(node.children[i], next, reversed, nfa);
+                entry = push(nfa, { .kind = nfa_state_t::split, .next = child, .next2 = entry });
+            }
+            return entry;
+        }
+        case node_t::repeat: {
+            const node_t& child = node.children.front();
+            uint32_t entry = next;
+            if (node.max == infinite) {
+                // the loop state is pushed first so the body can point back at it
+                uint32_t loop = push(nfa, { .kind = nfa_state_t::split, .next2 = next });
+                nfa.states[loop].next = compile(child, loop, reversed, nfa);
+                entry = loop;
+            } else {
+                // x{0,k} as (x(x(...)?)?)?
+                for (size_t i = node.min; i < node.max; i++) {
+                    uint32_t body = compile(child, entry, reversed, nfa);
+                    entry = push(nfa, { .kind = nfa_state_t::split, .next = body, .next2 = next });
+                }
+            }
+            for (size_t i = 0; i < node.min; i++) entry = compile(child, entry, reversed, nfa);
+            return entry;
+        }
+    }
+    return next;
+}
+
+dfa_t::dfa_t(std::shared_ptr<const regex_t> regex, bool reversed)
+  : _regex(std::move(regex)), _nfa(reversed ? _regex->reverse() : _regex->forward()), _stride(_regex->byte_class_count() + 1), _visited(_nfa.states.size(), 0) {
+    reset();
+}
+
+void dfa_t::reset() {
+    _states.clear();
+    _table.clear();
+    _state_ids.clear();
+    _accelerated = unknown;
+    _dead = intern({}, 0);
+}
+
+// follows the epsilon transitions of every group in order, the byte_set states reached go into o_states with groups separated
+// by mark, a state already reached by an earlier group (earlier start) is skipped in the later ones
+// returns true if a group reached the match state, the groups after it (later starts) are dropped and seeding stops
+bool dfa_t::closure(const std::vector<uint32_t>& kernel, uint8_t& flags, bool at_line_end, std::vector<uint32_t>& o_states) {
+    if (++_generation == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _generation = 1;
+    }
+    o_states.clear();
+    std::vector<uint32_t> stack;
+    size_t i = 0;
+    while (i < kernel.size() || (flags & flag_seeding)) {
+        // the group starting at this byte goes last
+        bool seed = i >= kernel.size();
+        if (seed) stack.push_back(_nfa.start);
+        for (; i < kernel.size() && kernel[i] != mark; i++) stack.push_back(kernel[i]);
+        i++;
+
+        bool matched = false;
+        size_t group_start = o_states.size();
+        // stack is filled in reverse, so that earlier states are followed first
+        std::reverse(stack.begin(), stack.end());
+        while (!stack.empty()) {
+            uint32_t id = stack.back();
+            stack.pop_back();
+            if (_visited[id] == _generation) continue;
+            _visited[id] = _generation;
+            const regex_t::nfa_state_t& state = _nfa.states[id];
+            switch (state.kind) {
+                case regex_t::nfa_state_t::byte_set: o_states.push_back(id); break;
+                case regex_t::nfa_state_t::match: matched = true; break;
+                case regex_t::nfa_state_t::split: stack.push_back(state.next2); stack.push_back(state.next); break;
+                case regex_t::nfa_state_t::epsilon: stack.push_back(state.next); break;
+                case regex_t::nfa_state_t::begin_line: if (flags & flag_line_start) stack.push_back(state.next); break;
+                case regex_t::nfa_state_t::end_line: if (at_line_end) stack.push_back(state.next); break;
+            }
+        }
+        if (o_states.size() != group_start) o_states.push_back(mark);
+        if (matched) {
+            flags &= ~flag_seeding;
+            return true;
+        }
+        if (seed) break;
+    }
+    return false;
+}
+
+int32_t dfa_t::intern(const std::vector<uint32_t>& kernel, uint8_t flags) {
+    std::string key(reinterpret_cast<const char *>(kernel.data()), kernel.size() * sizeof(uint32_t));
+    key.push_back(char(flags));
+    auto itr = _state_ids.find(key);
+    if (itr != _state_ids.end()) return itr->second;
+
+    int32_t match = 0;
+    uint8_t closure_flags = flags;
+    if (closure(kernel, closure_flags, false, _scratch)) match |= match_otherwise;
+    closure_flags = flags;
+    if (closure(kernel, closure_flags, true, _scratch)) match |= match_at_line_end;
+
+    int32_t id = int32_t(_table.size());
+    _states.push_back({ kernel, flags });
+    _table.resize(_table.size() + _stride, unknown);
+    _table[id + _stride - 1] = match;
+    _state_ids.emplace(std::move(key), id);
+    return id;
+}
+
+int32_t dfa_t::transition(int32_t id, uint8_t byte) {
+    const state_t& state = _states[id / _stride];
+    uint8_t flags = state.flags;
+    closure(state.kernel, flags, byte == '\n', _scratch);
+
+    // step every reached byte_set state over byte, keeping the groups
+    if (++_generation == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _generation = 1;
+    }
+    std::vector<uint32_t> kernel;
+    for (uint32_t state_id : _scratch) {
+        if (state_id == mark) {
+            if (!kernel.empty() && kernel.back() != mark) kernel.push_back(mark);
+            continue;
+        }
+        const regex_t::nfa_state_t& state = _nfa.states[state_id];
+        if (!_regex->sets()[state.set][byte] || _visited[state.next] == _generation) continue;
+        _visited[state.next] = _generation;
+        kernel.push_back(state.next);
+    }
+    if (!kernel.empty() && kernel.back() == mark) kernel.pop_back();
+    flags = (flags & flag_seeding) | (byte == '\n' ? flag_line_start : 0);
+    if (kernel.empty() && !(flags & flag_seeding)) flags = 0;  // a single dead state
+
+    bool dropped = false;
+    if (_states.size() >= max_states) {
+        reset();
+        dropped = true;
+    }
+    int32_t next = intern(kernel, flags);
+    if (!dropped) _table[id + _regex->byte_classes()[byte]] = next;
+    return next;
+}
+
+void dfa_t::accelerate(int32_t id) {
+    // only worth it if the state cant match on its own, and building its transitions cant drop the cache
+    if (_table[id + _stride - 1] || _states.size() + _stride >= max_states) return;
+    const uint8_t *byte_classes = _regex->byte_classes();
+    int exit_count = 0;
+    for (size_t byte = 0; byte < 256; byte++) {
+        int32_t next = _table[id + byte_classes[byte]];
+        if (next == unknown) next = transition(id, uint8_t(byte));
+        _exits[byte] = next != id;
+        if (_exits[byte]) {
+            exit_count++;
+            _single_exit = int(byte);
+        }
+    }
+    if (exit_count != 1) _single_exit = -1;
+    _accelerated = id;
+}
+
+// index of the first byte from i on that leaves the accelerated state, n if there is none
+size_t dfa_t::skip(const char *data, size_t i, size_t n, bool reversed) const {
+    if (reversed) {
+        while (i < n && !_exits[uint8_t(data[n - 1 - i])]) i++;
+        return i;
+    }
+    if (_single_exit >= 0) {
+        const void *found = std::memchr(data + i, _single_exit, n - i);
+        return found ? static_cast<const char *>(found) - data : n;
+    }
+    while (i < n && !_exits[uint8_t(data[i])]) i++;
+    return i;
+}
+
+dfa_t::scan_t dfa_t::start(bool anchored, bool at_line_start) {
+    uint8_t flags = at_line_start ? flag_line_start : 0;
+    if (anchored) return { .state = intern({ _nfa.start }, flags) };
+    // the state the scan is in whenever no match is in progress, in the middle of a line
+    int32_t mid_line = intern({}, flag_seeding);
+    if (_accelerated != mid_line) accelerate(mid_line);
+    return { .state = intern({}, flags | flag_seeding) };
+}
+
+void dfa_t::feed(scan_t& scan, const char *data, size_t n, bool reversed) {
+    if (scan.dead) return;
+    // the table is only touched again when a new state has to be built, everything else is kept in locals
+    const uint8_t *byte_classes = _regex->byte_classes();
+    const int32_t *table = _table.data();
+    const int32_t match_offset = int32_t(_stride - 1);
+    int32_t id = scan.state;
+    size_t last_match = scan.last_match;
+    auto step = [&](size_t i, uint8_t byte) {
+        const int32_t *row = table + id;
+        if (row[match_offset] && (row[match_offset] & (byte == '\n' ? match_at_line_end : match_otherwise))) last_match = scan.consumed + i;
+        int32_t next = row[byte_classes[byte]];
+        if (next == unknown) {
+            next = transition(id, byte);
+            table = _table.data();
+        }
+        id = next;
+        return id != _dead;
+    };
+    size_t i = 0;
+    for (; i < n; i++) {
+        if (id == _accelerated && (i = skip(data, i, n, reversed)) == n) break;
+        if (!step(i, uint8_t(reversed ? data[n - 1 - i] : data[i]))) break;
+    }
+    scan.state = id;
+    scan.last_match = last_match;
+    if (i < n) {
+        scan.consumed += i + 1;
+        scan.dead = true;
+        return;
+    }
+    scan.consumed += n;
+}
+
+void dfa_t::finish(scan_t& scan, int next) {
+    if (scan.dead) return;
+    if (_table[scan.state + _stride - 1] & (next < 0 || next == '\n' ? match_at_line_end : match_otherwise)) scan.last_match = scan.consumed;
+}
+
+void dfa_t::stop_seeding(scan_t& scan) {
+    if (scan.dead || !(_states[scan.state / _stride].flags & flag_seeding)) return;
+    state_t state = _states[scan.state / _stride];
+    if (state.kernel.empty()) {
+        scan.state = _dead;
+        scan.dead = true;
+        return;
+    }
+    if (_states.size() >= max_states) reset();
+    scan.state = intern(state.kernel, state.flags & ~flag_seeding);
+}
+
+} // namespace core
@@ -0,0 +1,146 @@
+#ifndef CORE_REGEX_HPP
+#define CORE_REGEX_HPP
+
+#include <bitset>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace core {
+
+// small regex engine that runs over a stream of bytes, so the text never has to be contiguous (rope leaves are fed one by one)
+// supported: literals, . (anything but '\n'), [classes] with ranges and negation, \d \w \s \D \W \S, escapes (\n \t \xHH, \. ...),
+// groups ( ) (?: ), alternation |, quantifiers * + ? {n} {n,} {n,m} (lazy versions are accepted but match the same), line anchors ^ $
+// matching is leftmost longest and there are no captures, which is what lets it run as a dfa
+class regex_t {
+public:
+    struct nfa_state_t {
+        enum kind_t : uint8_t {
+            byte_set,  // consumes a byte in sets[set], goes to next
+            split,  // goes to both next and next2
+            epsilon,
+            begin_line,  // goes to next if at the begining of a line
+            end_line,  // goes to next if at the end of a line
+            match,
+        };
+        kind_t kind;
+        uint32_t next, next2;
+        uint32_t set;
+    };
+
+    struct nfa_t {
+        std::vector<nfa_state_t> states;
+        uint32_t start;
+    };
+
+    // throws std::runtime_error if the pattern is malformed
+    explicit regex_t(std::string_view pattern);
+
+    const std::string& pattern() const { return _pattern; }
+
+    // the regex and the regex reversed (matches the reversed text), a match is found with the first and its start with the second
+    const nfa_t& forward() const { return _forward; }
+    const nfa_t& reverse() const { return _reverse; }
+
+    const std::vector<std::bitset<256>>& sets() const { return _sets; }
+
+    // bytes that no set tells apart share a class, dfa transitions are per class instead of per byte, '\n' always has its own
+    const uint8_t *byte_classes() const { return _byte_classes; }
+    size_t byte_class_count() const { return _byte_class_count; }
+
+private:
+    struct node_t;
+
+    class parser_t;
+
+    uint32_t compile(const node_t& node, uint32_t next, bool reversed, nfa_t& nfa);
+    uint32_t push(nfa_t& nfa, nfa_state_t state);
+
+    std::string _pattern;
+    std::vector<std::bitset<256>> _sets;
+    nfa_t _forward;
+    nfa_t _reverse;
+    uint8_t _byte_classes[256];
+    size_t _byte_class_count;
+};
+
+// lazily built dfa over one direction of a regex, states are only built once the input reaches them and are cached
+// states are ordered sets of nfa states, grouped by where the match would start, so that the dfa finds leftmost longest matches
+// not thread safe, every thread searching with the same regex needs its own dfa_t
+class dfa_t {
+public:
+    static constexpr size_t max_states = 4096;  // the cache is dropped and rebuilt when it gets bigger than this
+
+    // state of a scan, the text is fed in pieces with feed() and finish()
+    struct scan_t {
+        int32_t state;
+        size_t consumed = 0;  // bytes fed so far
+        size_t last_match = npos;  // consumed count at the end of the longest match so far
+        bool dead = false;  // no match can be extended or started anymore, the rest of the text doesnt matter
+    };
+
+    static constexpr size_t npos = ~size_t{ 0 };
+
+    dfa_t(std::shared_ptr<const regex_t> regex, bool reversed);
+
+    // anchored only matches starting at the first byte fed, at_line_start tells if the byte before that was a '\n' (or there is none)
+    scan_t start(bool anchored, bool at_line_start);
+
+    // reversed feeds data[n - 1] first, down to data[0]
+    void feed(scan_t& scan, const char *data, size_t n, bool reversed = false);
+
+    // has to be called at the end of the input, next is the byte that comes after it or -1 at the end of the text
+    void finish(scan_t& scan, int next);
+
+    // no new matches start from here on, the ones already in progress carry on, only does anything to unanchored scans
+    void stop_seeding(scan_t& scan);
+
+    size_t state_count() const { return _states.size(); }
+
+    // bytes taken by the cached states
+    size_t memory_usage() const { return _table.size() * sizeof(int32_t) + _states.size() * sizeof(state_t); }
+
+private:
+    static constexpr uint32_t mark = ~uint32_t{ 0 };  // separates the groups in a state
+    static constexpr uint8_t flag_line_start = 1;
+    static constexpr uint8_t flag_seeding = 2;  // unanchored and nothing matched yet, a new group is started at every byte
+    static constexpr uint8_t match_otherwise = 1;
+    static constexpr uint8_t match_at_line_end = 2;
+    static constexpr int32_t unknown = -1;
+
+    struct state_t {
+        std::vector<uint32_t> kernel;  // nfa states reached, before following epsilons
+        uint8_t flags;
+    };
+
+    bool closure(const std::vector<uint32_t>& kernel, uint8_t& flags, bool at_line_end, std::vector<uint32_t>& o_states);
+    int32_t intern(const std::vector<uint32_t>& kernel, uint8_t flags);
+    int32_t transition(int32_t state, uint8_t byte);
+    void accelerate(int32_t state);
+    size_t skip(const char *data, size_t i, size_t n, bool reversed) const;
+    void reset();
+
+    std::shared_ptr<const regex_t> _regex;
+    const regex_t::nfa_t& _nfa;
+    std::vector<state_t> _states;
+    // a row per state, the next state for every byte class followed by the match bits, states are identified by the offset of
+    // their row so stepping is a single load
+    std::vector<int32_t> _table;
+    size_t _stride;
+    std::unordered_map<std::string, int32_t> _state_ids;
+    int32_t _dead;
+    // the unanchored start state loops on most bytes, the scan skips over those without stepping the dfa till one of the exits
+    int32_t _accelerated = unknown;
+    bool _exits[256];
+    int _single_exit;  // the only exit byte, -1 if there are more
+    std::vector<uint32_t> _visited;  // generation stamps, so closure doesnt have to clear a set every time
+    uint32_t _generation = 0;
+    std::vector<uint32_t> _scratch;
+};
+
+} // namespace core
+
+#endif
@@ -2,9 +2,24 @@
 #define rope_HPP
 
 #include <memory>
+#include <string>
 #include <cstring>
 #include <cassert>
-#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <ostream>
+#include <tuple>
+#include <concepts>
+#include <type_traits>
+#include <string_view>
+#include <iterator>
+#include <ranges>
+#include <atomic>
+#include <vector>
+#include <span>
+#include <unordered_map>
+
+#include "file.hpp"
 
 #ifndef NDEBUG
 
@@ -25,438 +40,1440 @@ inline bool memcpy_bound_check(char *begin, char *end, char *start, char *stop)
     return start <= stop && in_range(begin, start, end) && in_range(begin, stop - 1, end);  // - 1 because stop address is never written to
 }
 
+inline size_t count_newlines(const char *str, size_t n) {
+    size_t newlines = 0;
+    for (size_t i = 0; i < n; i++) newlines += str[i] == '\n';
+    return newlines;
+}
+
+// returns the index of the k'th (1 based) newline in str, n if there arent k newlines
+inline size_t find_newline(const char *str, size_t n, size_t k) {
+    for (size_t i = 0; i < n; i++) {
+        if (str[i] == '\n' && !--k) return i;
+    }
+    return n;
+}
+
+template <typename type, typename... types>
+constexpr size_t index_of() {
+    size_t index = 0;
+    ((std::is_same_v<type, types> ? false : (++index, true)) && ...);
+    return index;
+}
+
 } // namespace utils
 
-template <size_t BUFFER_LENGTH, template <typename type> typename allocator = std::allocator>
+// a summary is a monoid over the text, every node caches the summary of its subtree so that it can be queried in O(log n)
+// combine(from_leaf(a), from_leaf(b)) has to be equal to from_leaf(a + b), see rope_summaries.hpp for examples
+template <typename summary_t>
+concept summary_c = requires(const char *str, size_t n, const typename summary_t::value_t& value) {
+    { summary_t::from_leaf(str, n) } -> std::same_as<typename summary_t::value_t>;
+    { summary_t::combine(value, value) } -> std::same_as<typename summary_t::value_t>;
+} && std::is_trivially_copyable_v<typename summary_t::value_t>;  // nodes are raw allocator memory, nothing gets constructed
+
+// a summary hashing the text, equal texts have to get equal values, see summary::hash_t
+// rope_t::equals() and diff() use the first one the rope has to skip subtrees holding the same text even if they arent the same node
+template <typename summary_t>
+concept hash_summary_c = summary_c<summary_t> && std::equality_comparable<typename summary_t::value_t> && requires(const typename summary_t::value_t& value) {
+    { value.hash } -> std::convertible_to<uint64_t>;
+};
+
+// the rope is kept height balanced (avl), every internal node has exactly 2 children and all the text lives in the leaves
+// every structural change goes through join/split, so insert, erase and set_slice are all O(log n) (+ the size of the written text)
+// nodes are reference counted and copy on write, copying a rope or taking a snapshot() is O(1) and an edit only copies the
+// O(log n) shared nodes on its path, everything else stays shared
+// a rope can also be opened over a memory mapped file, its leaves then point into the mapping instead of owning the text, see
+// rope_t(std::shared_ptr<const core::mapped_file_t>)
+template <size_t BUFFER_LENGTH, template <typename type> typename allocator = std::allocator, summary_c... summaries_t>
 class rope_t {
     static_assert(BUFFER_LENGTH > 0);
 public:
+    // replaces [pos, pos + n) with text, see apply()
+    struct edit_t {
+        size_t pos;
+        size_t n;
+        std::string_view text;
+    };
+
+    // [pos, pos + n) of the old text became [new_pos, new_pos + new_n) of the new text, see diff()
+    struct change_t {
+        size_t pos;
+        size_t n;
+        size_t new_pos;
+        size_t new_n;
+    };
+
     struct rope_node_t {
-        rope_node_t *left, *right, *parent;
+        rope_node_t *left, *right;
+        size_t refs;  // number of parents + handles pointing at this node, only ever accessed atomically (snapshots can be dropped on other threads)
         size_t count;
+        size_t newlines;  // number of '\n' in the subtree
+        size_t height;  // leaf is 1
+        [[no_unique_address]] std::tuple<typename summaries_t::value_t...> summaries;
+        const char *external;  // leaves only, not null if the text lives in a mapped file instead of ch_buff, these leaves are never written to
+        bool indexed;  // newlines and summaries are only valid if this is set, see build_index()
         char ch_buff[BUFFER_LENGTH];
-        bool is_leaf() { return !left && !right; }  // if left and right does not exist
+        bool is_leaf() const { return !left && !right; }  // if left and right does not exist
+        const char *data() const { return external ? external : ch_buff; }
+
+        // leaves pointing into a mapped file arent limited by BUFFER_LENGTH, they are only split when edited
+        static constexpr size_t mapped_leaf_length = size_t(1) << 22;
+        // an owned leaf shorter than this gets merged with a neighbour when an edit touches it, if they fit in one
+        static constexpr size_t min_leaf_length = BUFFER_LENGTH / 4;
 
         template <typename rope_node_allocator_t>
         static rope_node_t *rope_node(const std::string& str, rope_node_allocator_t& rope_node_allocator) {
-            rope_node_t *root_node = rope_node_allocator.allocate(1);
-            root_node->parent = nullptr;
-            rope_node_impl(root_node, str.data(), 0, str.size(), rope_node_allocator);
+            return rope_node(str.data(), str.size(), rope_node_allocator);
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *rope_node(const char *str, size_t size, rope_node_allocator_t& rope_node_allocator) {
+            rope_node_t *root_node = allocate_node(rope_node_allocator);
+            rope_node_impl(root_node, str, 0, size, rope_node_allocator);
             return root_node;
         }
 
+        // like rope_node, but the leaves point into str instead of copying it, str has to outlive the tree
+        // nothing in str is read, so the newlines and summaries are left unindexed
+        template <typename rope_node_allocator_t>
+        static rope_node_t *mapped_rope_node(const char *str, size_t size, rope_node_allocator_t& rope_node_allocator) {
+            if (!size) return rope_node(nullptr, 0, rope_node_allocator);
+            rope_node_t *root_node = allocate_node(rope_node_allocator);
+            mapped_rope_node_impl(root_node, str, 0, size, rope_node_allocator);
+            return root_node;
+        }
+
+        // reads the whole text once to fill in the newlines and summaries of the unindexed nodes, shared nodes are path copied
+        template <typename rope_node_allocator_t>
+        static void build_index(rope_node_t *&root_node, rope_node_allocator_t& rope_node_allocator) {
+            root_node = build_index_impl(root_node, rope_node_allocator);
+        }
+
+        // drops a reference, the subtree is only freed once nothing else points at it
         template <typename rope_node_allocator_t>
         static void delete_rope_node(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
-            rope_node_t *parent = node->parent;
             delete_rope_node_impl(node, rope_node_allocator);
-            node = parent;
-            fix_parent_count(node);
         }
 
+        static rope_node_t *acquire(rope_node_t *node) {
+            std::atomic_ref<size_t>(node->refs).fetch_add(1, std::memory_order_relaxed);
+            return node;
+        }
+
+        // like delete_rope_node, but safe to call from any thread, dead nodes are buried in the pool instead of being handed
+        // back to the allocator, the owner of the allocator frees them later
+        template <typename node_pool_t>
+        static void release(rope_node_t *node, node_pool_t& node_pool) {
+            if (!node || std::atomic_ref<size_t>(node->refs).fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            release(node->left, node_pool);
+            release(node->right, node_pool);
+            node_pool.bury(node);
+        }
+
+        // r1 and r2 are consumed, the result is balanced
         template <typename rope_node_allocator_t>
         static rope_node_t *concate(rope_node_t *r1, rope_node_t *r2, rope_node_allocator_t& rope_node_allocator) {
-            assert(!r1->parent && !r2->parent); // r1 and r2 should not have any parents
-            rope_node_t *rope_node = rope_node_allocator.allocate(1);
-            r1->parent = r2->parent = rope_node;
-            rope_node->parent = nullptr;
-            rope_node->left = r1;
-            rope_node->right = r2;
-            rope_node->count = r1->count + r2->count;
-            return rope_node;
+            return join(r1, r2, nullptr, rope_node_allocator);
         }
 
-        static void slice(rope_node_t *node, size_t pos, size_t n, char *o_str) {
+        static void slice(const rope_node_t *node, size_t pos, size_t n, char *o_str) {
             slice_impl(node, pos, n, o_str);
         }
 
+        // streams the leaves straight into the file, max_chunks at a time, the text is never copied into one buffer
+        static bool save(const rope_node_t *node, const std::filesystem::path& path, bool sync) {
+            std::unique_ptr<core::atomic_file_writer_t> writer = core::atomic_file_writer_t::open(path);
+            if (!writer) return false;
+            std::string_view batch[core::atomic_file_writer_t::max_chunks];
+            size_t batch_size = 0;
+            for (std::string_view chunk : chunks_t{ node, 0, node->count }) {
+                batch[batch_size++] = chunk;
+                if (batch_size == core::atomic_file_writer_t::max_chunks) {
+                    if (!writer->write(batch, batch_size)) return false;
+                    batch_size = 0;
+                }
+            }
+            if (batch_size && !writer->write(batch, batch_size)) return false;
+            return writer->commit(sync);
+        }
+
         // this call can change the node, maybe in future make this a ** instead of *& ?
         template <typename rope_node_allocator_t>
         static void set_slice(rope_node_t *&root_node, const char *str, size_t size, size_t pos, size_t n, rope_node_allocator_t& rope_node_allocator) {
-            set_slice_impl(root_node, str, size, pos, n, rope_node_allocator);
+            assert(pos <= root_node->count && pos + n <= root_node->count);  // bounds check
+            // overwrite what overlaps in place, then grow or shrink the rest
+            size_t overlap = std::min(size, n);
+            if (overlap) root_node = write_impl(root_node, str, pos, overlap, rope_node_allocator);
+            if (size > n) insert(root_node, str + overlap, size - overlap, pos + overlap, rope_node_allocator);
+            if (size < n) erase(root_node, pos + overlap, n - overlap, rope_node_allocator);
+        }
+
+        template <typename rope_node_allocator_t>
+        static void insert(rope_node_t *&root_node, const char *str, size_t size, size_t pos, rope_node_allocator_t& rope_node_allocator) {
+            assert(pos <= root_node->count);  // bounds check
+            if (!size) return;
+            root_node = insert_impl(root_node, str, size, pos, rope_node_allocator);
+            // a prepend to a full leaf leaves the text as a short leaf of its own, a large insert can leave short leaves on both sides
+            root_node = coalesce(root_node, pos, rope_node_allocator);
+            if (size > BUFFER_LENGTH) root_node = coalesce(root_node, pos + size, rope_node_allocator);
+        }
+
+        template <typename rope_node_allocator_t>
+        static void erase(rope_node_t *&root_node, size_t pos, size_t n, rope_node_allocator_t& rope_node_allocator) {
+            assert(pos <= root_node->count && pos + n <= root_node->count);  // bounds check
+            if (!n) return;
+            root_node = erase_impl(root_node, pos, n, rope_node_allocator);
+            if (!root_node) root_node = rope_node(nullptr, 0, rope_node_allocator);  // the root is never null, an empty rope is an empty leaf
+            root_node = coalesce(root_node, pos, rope_node_allocator);
+        }
+
+        // edits have to be sorted and not overlap, their positions are in the text before any of them is applied
+        // the edits are handed down the tree together, so every node they touch is copied and fixed once and every leaf rewritten
+        // once, subtrees they dont touch stay as they are
+        template <typename rope_node_allocator_t>
+        static void apply(rope_node_t *&root_node, std::span<const edit_t> edits, rope_node_allocator_t& rope_node_allocator) {
+            assert(std::adjacent_find(edits.begin(), edits.end(), [](const edit_t& a, const edit_t& b) { return a.pos + a.n > b.pos; }) == edits.end());
+            assert(edits.empty() || edits.back().pos + edits.back().n <= root_node->count);  // bounds check
+            if (edits.empty()) return;
+            std::string scratch;
+            root_node = apply_impl(root_node, edits.data(), edits.data() + edits.size(), 0, true, scratch, rope_node_allocator);
+            if (!root_node) root_node = rope_node(nullptr, 0, rope_node_allocator);
+        }
+
+        // rebuilds the tree out of full leaves, the text of the owned leaves is packed BUFFER_LENGTH at a time (only the leaf before a
+        // mapped leaf or the end can be partial), mapped leaves are shared as they are so nothing gets paged in
+        // O(n), the old tree is released, snapshots keep their nodes
+        template <typename rope_node_allocator_t>
+        static void compact(rope_node_t *&root_node, rope_node_allocator_t& rope_node_allocator) {
+            std::vector<rope_node_t *> leaves;
+            pack_leaves(root_node, leaves, rope_node_allocator);
+            delete_rope_node_impl(root_node, rope_node_allocator);
+            if (leaves.empty()) {
+                root_node = rope_node(nullptr, 0, rope_node_allocator);
+                return;
+            }
+            for (rope_node_t *leaf : leaves) {
+                if (!leaf->external) fix_leaf_count(leaf);
+            }
+            root_node = build_from_leaves(leaves.data(), leaves.size(), rope_node_allocator);
+        }
+
+        // text bytes held by the owned leaves and bytes taken by the nodes, mapped leaves count towards neither
+        static void usage(const rope_node_t *node, size_t& o_used, size_t& o_allocated) {
+            if (node->is_leaf() && node->external) return;
+            o_allocated += sizeof(rope_node_t);
+            if (node->is_leaf()) {
+                o_used += node->count;
+                return;
+            }
+            usage(node->left, o_used, o_allocated);
+            usage(node->right, o_used, o_allocated);
+        }
+
+        // replaces [pos, pos + n) of the leaf at the end of path with str in place, only the ancestors on path get their counts fixed,
+        // nothing is allocated or rebalanced
+        // every node on path has to be unshared, and the leaf owned (not mapped) with room for the result, which cant be empty
+        static void splice_leaf(rope_node_t *const *path, size_t depth, const char *str, size_t size, size_t pos, size_t n) {
+            rope_node_t *leaf = path[depth - 1];
+            assert(leaf->is_leaf() && !leaf->external && pos + n <= leaf->count);
+            assert(leaf->count - n + size && leaf->count - n + size <= BUFFER_LENGTH);
+            leaf->newlines -= utils::count_newlines(leaf->ch_buff + pos, n);
+            std::memmove(leaf->ch_buff + pos + size, leaf->ch_buff + pos + n, leaf->count - (pos + n));
+            if (size) std::memcpy(leaf->ch_buff + pos, str, size);
+            leaf->count = leaf->count - n + size;
+            leaf->newlines += utils::count_newlines(str, size);
+            fix_leaf_summaries(leaf);
+            for (size_t i = depth - 1; i-- > 0;) fix_count(path[i]);
+        }
+
+        // number of '\n' in [0, pos)
+        static size_t offset_to_line(const rope_node_t *node, size_t pos) {
+            assert(pos <= node->count);  // bounds check
+            assert(node->indexed);
+            size_t line = 0;
+            while (!node->is_leaf()) {
+                if (pos <= node->left->count) {
+                    node = node->left;
+                } else {
+                    line += node->left->newlines;
+                    pos -= node->left->count;
+                    node = node->right;
+                }
+            }
+            return line + utils::count_newlines(node->data(), pos);
+        }
+
+        // summary of [pos, pos + n)
+        template <typename summary_t>
+        static typename summary_t::value_t summary(const rope_node_t *node, size_t pos, size_t n) {
+            assert(pos <= node->count && pos + n <= node->count);  // bounds check
+            assert(node->indexed);
+            if (!pos && n == node->count) return std::get<utils::index_of<summary_t, summaries_t...>()>(node->summaries);
+            if (node->is_leaf()) return summary_t::from_leaf(node->data() + pos, n);
+            size_t left_count = node->left->count;
+            if (pos + n <= left_count) return summary<summary_t>(node->left, pos, n);
+            if (pos >= left_count) return summary<summary_t>(node->right, pos - left_count, n);
+            return summary_t::combine(summary<summary_t>(node->left, pos, left_count - pos), summary<summary_t>(node->right, 0, pos + n - left_count));
+        }
+
+        // the end of the shortest range starting at pos whose summary pred accepts, std::string::npos if there is none
+        // acc is the summary of the part of the range already walked past, combined with whole subtrees while pred rejects them and
+        // byte by byte in the leaf where it stops accepting them
+        template <typename summary_t, typename pred_t>
+        static size_t find_summary(const rope_node_t *node, size_t pos, typename summary_t::value_t& acc, pred_t& pred) {
+            assert(pos <= node->count);  // bounds check
+            assert(node->indexed);
+            if (pos == node->count) return std::string::npos;
+            if (!pos) {
+                typename summary_t::value_t value = summary_t::combine(acc, std::get<utils::index_of<summary_t, summaries_t...>()>(node->summaries));
+                if (!pred(value)) {
+                    acc = value;
+                    return std::string::npos;
+                }
+            }
+            if (node->is_leaf()) {
+                const char *data = node->data();
+                for (size_t i = pos; i < node->count; i++) {
+                    acc = summary_t::combine(acc, summary_t::from_leaf(data + i, 1));
+                    if (pred(acc)) return i + 1;
+                }
+                return std::string::npos;
+            }
+            size_t left_count = node->left->count;
+            if (pos < left_count) {
+                size_t end = find_summary<summary_t>(node->left, pos, acc, pred);
+                if (end != std::string::npos) return end;
+                pos = left_count;
+            }
+            size_t end = find_summary<summary_t>(node->right, pos - left_count, acc, pred);
+            return end == std::string::npos ? end : left_count + end;
+        }
+
+        // find_summary() walking to the left, the start of the shortest range ending at pos
+        template <typename summary_t, typename pred_t>
+        static size_t rfind_summary(const rope_node_t *node, size_t pos, typename summary_t::value_t& acc, pred_t& pred) {
+            assert(pos <= node->count);  // bounds check
+            assert(node->indexed);
+            if (!pos) return std::string::npos;
+            if (pos == node->count) {
+                typename summary_t::value_t value = summary_t::combine(std::get<utils::index_of<summary_t, summaries_t...>()>(node->summaries), acc);
+                if (!pred(value)) {
+                    acc = value;
+                    return std::string::npos;
+                }
+            }
+            if (node->is_leaf()) {
+                const char *data = node->data();
+                for (size_t i = pos; i-- > 0;) {
+                    acc = summary_t::combine(summary_t::from_leaf(data + i, 1), acc);
+                    if (pred(acc)) return i;
+                }
+                return std::string::npos;
+            }
+            size_t left_count = node->left->count;
+            if (pos > left_count) {
+                size_t begin = rfind_summary<summary_t>(node->right, pos - left_count, acc, pred);
+                if (begin != std::string::npos) return left_count + begin;
+                pos = left_count;
+            }
+            return rfind_summary<summary_t>(node->left, pos, acc, pred);
+        }
+
+        // offset of the first char of line (0 based)
+        static size_t line_to_offset(const rope_node_t *node, size_t line) {
+            assert(node->indexed);
+            assert(line <= node->newlines);  // bounds check
+            if (!line) return 0;
+            size_t offset = 0;
+            while (!node->is_leaf()) {
+                if (line <= node->left->newlines) {
+                    node = node->left;
+                } else {
+                    line -= node->left->newlines;
+                    offset += node->left->count;
+                    node = node->right;
+                }
+            }
+            return offset + utils::find_newline(node->data(), node->count, line) + 1;
+        }
+
+        // O(1) when both are indexed and the rope has a hash summary, a hash collision could make texts that differ equal
+        // otherwise it is a diff(), shared subtrees are skipped and the rest of the text compared
+        static bool equals(const rope_node_t *a, const rope_node_t *b) {
+            if (a == b) return true;
+            if (a->count != b->count) return false;
+            if constexpr (hashed) {
+                if (a->indexed && b->indexed) return same(a, b);
+            }
+            return diff(a, b).empty();
+        }
+
+        // the changes that turn the text of a into the text of b, sorted and not overlapping, positions in a are before any of them
+        // (what apply() expects) and positions in b after all of them
+        // both trees are walked from the left and subtrees that are the same node (or have the same hash) are skipped whole, past a
+        // difference the walks go leaf by leaf till one of them reaches a leaf the other one already passed, then they line up again
+        // there, every change is trimmed down to the bytes that differ, so a change is exact at both ends but 2 changes close by can
+        // come out as 1
+        // O(changes * log n + size of the changed leaves) for snapshots of the same rope, which share all but the edited paths, trees
+        // that dont share nodes or hashes cost O(n)
+        static std::vector<change_t> diff(const rope_node_t *a, const rope_node_t *b) {
+            std::vector<change_t> changes;
+            if (a == b) return changes;
+            walk_t walk_a(a), walk_b(b);
+            // leaves passed since the change started and their offsets, only shared leaves line the walks up again, lining up on text
+            // that just repeats somewhere else (same hash) would cut the change into pieces
+            std::unordered_map<const rope_node_t *, size_t> seen_a, seen_b;
+            auto find = [](const auto& seen, const rope_node_t *node) -> size_t {
+                auto itr = seen.find(node);
+                return itr != seen.end() ? itr->second : std::string::npos;
+            };
+            bool in_change = false;
+            size_t a_begin = 0, b_begin = 0;
+            auto end_change = [&](size_t a_end, size_t b_end) {
+                add_change(a, a_begin, a_end, b, b_begin, b_end, changes);
+                in_change = false;
+                seen_a.clear();
+                seen_b.clear();
+            };
+            while (!walk_a.done() || !walk_b.done()) {
+                if (!in_change) {
+                    if (!walk_a.done() && !walk_b.done()) {
+                        const rope_node_t *node_a = walk_a.top(), *node_b = walk_b.top();
+                        if (same(node_a, node_b)) {
+                            walk_a.pop();
+                            walk_b.pop();
+                            continue;
+                        }
+                        // split the bigger one till they line up or both are leaves
+                        if (!node_a->is_leaf() || !node_b->is_leaf()) {
+                            if (!node_a->is_leaf() && (node_b->is_leaf() || node_a->count >= node_b->count)) walk_a.expand();
+                            else walk_b.expand();
+                            continue;
+                        }
+                    }
+                    in_change = true;
+                    a_begin = walk_a.pos;
+                    b_begin = walk_b.pos;
+                }
+                if (!walk_b.done()) {
+                    if (size_t pos = find(seen_a, walk_b.top()); pos != std::string::npos) {
+                        end_change(pos, walk_b.pos);
+                        walk_a.seek(pos);
+                        continue;
+                    }
+                }
+                if (!walk_a.done()) {
+                    if (size_t pos = find(seen_b, walk_a.top()); pos != std::string::npos) {
+                        end_change(walk_a.pos, pos);
+                        walk_b.seek(pos);
+                        continue;
+                    }
+                }
+                if (!walk_a.done() && !walk_b.done() && walk_a.top() == walk_b.top()) {
+                    end_change(walk_a.pos, walk_b.pos);
+                    continue;
+                }
+                // the walk that is behind moves on by a leaf
+                bool behind_a = walk_b.done() || (!walk_a.done() && walk_a.pos - a_begin <= walk_b.pos - b_begin);
+                walk_t& walk = behind_a ? walk_a : walk_b;
+                if (!walk.top()->is_leaf()) {
+                    walk.expand();
+                    continue;
+                }
+                (behind_a ? seen_a : seen_b).emplace(walk.top(), walk.pos);
+                walk.pop();
+            }
+            if (in_change) end_change(a->count, b->count);
+            return changes;
         }
 
     private:
-        static void fix_parent_count(rope_node_t *node) {
-            if (node) {
-                while (node->parent) {
-                    node->parent->count = node->parent->left->count + node->parent->right->count;
-                    node = node->parent;
+        static constexpr size_t hash_index = [] {
+            constexpr bool hashes[] = { hash_summary_c<summaries_t>..., false };
+            return size_t(std::find(std::begin(hashes), std::end(hashes), true) - std::begin(hashes));
+        }();
+        static constexpr bool hashed = hash_index < sizeof...(summaries_t);
+
+        static size_t node_height(rope_node_t *node) { return node ? node->height : 0; }
+
+        // recomputes the cached values of an internal node from its children
+        static void fix_count(rope_node_t *node) {
+            node->count = node->left->count + node->right->count;
+            node->height = std::max(node->left->height, node->right->height) + 1;
+            node->indexed = node->left->indexed && node->right->indexed;
+            if (!node->indexed) return;
+            node->newlines = node->left->newlines + node->right->newlines;
+            node->summaries = [node]<size_t... I>(std::index_sequence<I...>) {
+                return std::tuple{ summaries_t::combine(std::get<I>(node->left->summaries), std::get<I>(node->right->summaries))... };
+            }(std::index_sequence_for<summaries_t...>{});
+        }
+
+        // recomputes the cached values of a leaf from its text, has to be called after every write to a leaf
+        static void fix_leaf_count(rope_node_t *node) {
+            node->newlines = utils::count_newlines(node->data(), node->count);
+            fix_leaf_summaries(node);
+            node->indexed = true;
+        }
+
+        static void fix_leaf_summaries(rope_node_t *node) {
+            node->summaries = std::tuple{ summaries_t::from_leaf(node->data(), node->count)... };
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *allocate_node(rope_node_allocator_t& rope_node_allocator) {
+            rope_node_t *node = rope_node_allocator.allocate(1);
+            node->refs = 1;
+            return node;
+        }
+
+        // returns a node that is safe to modify, shared nodes get copied (path copying), the copy takes a reference on the children
+        template <typename rope_node_allocator_t>
+        static rope_node_t *mutable_node(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            if (std::atomic_ref<size_t>(node->refs).load(std::memory_order_acquire) == 1) return node;
+            rope_node_t *copy = allocate_node(rope_node_allocator);
+            copy->left = node->left;
+            copy->right = node->right;
+            copy->count = node->count;
+            copy->newlines = node->newlines;
+            copy->height = node->height;
+            copy->summaries = node->summaries;
+            copy->external = node->external;
+            copy->indexed = node->indexed;
+            if (node->is_leaf()) {
+                if (!node->external) std::memcpy(copy->ch_buff, node->ch_buff, node->count);
+            } else {
+                acquire(copy->left);
+                acquire(copy->right);
+            }
+            delete_rope_node_impl(node, rope_node_allocator);
+            return copy;
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *leaf_node(rope_node_allocator_t& rope_node_allocator) {
+            rope_node_t *node = allocate_node(rope_node_allocator);
+            node->left = node->right = nullptr;
+            node->count = 0;
+            node->newlines = 0;
+            node->height = 1;
+            node->external = nullptr;
+            node->indexed = true;
+            fix_leaf_summaries(node);
+            return node;
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *rotate_left(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            rope_node_t *right = mutable_node(node->right, rope_node_allocator);
+            node->right = right->left;
+            right->left = node;
+            fix_count(node);
+            fix_count(right);
+            return right;
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *rotate_right(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            rope_node_t *left = mutable_node(node->left, rope_node_allocator);
+            node->left = left->right;
+            left->right = node;
+            fix_count(node);
+            fix_count(left);
+            return left;
+        }
+
+        // children heights can differ by atmost 2 here, node has to be mutable
+        template <typename rope_node_allocator_t>
+        static rope_node_t *balance(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            fix_count(node);
+            if (node->left->height > node->right->height + 1) {
+                if (node_height(node->left->left) < node_height(node->left->right)) node->left = rotate_left(mutable_node(node->left, rope_node_allocator), rope_node_allocator);
+                return rotate_right(node, rope_node_allocator);
+            }
+            if (node->right->height > node->left->height + 1) {
+                if (node_height(node->right->right) < node_height(node->right->left)) node->right = rotate_right(mutable_node(node->right, rope_node_allocator), rope_node_allocator);
+                return rotate_left(node, rope_node_allocator);
+            }
+            return node;
+        }
+
+        // joins 2 trees, spare (if not null) is reused as the new internal node, cost is O(|height(l) - height(r)|)
+        template <typename rope_node_allocator_t>
+        static rope_node_t *join(rope_node_t *l, rope_node_t *r, rope_node_t *spare, rope_node_allocator_t& rope_node_allocator) {
+            if (!l || !r) {
+                if (spare) rope_node_allocator.deallocate(spare, 1);
+                return l ? l : r;
+            }
+            if (l->height > r->height + 1) {
+                l = mutable_node(l, rope_node_allocator);
+                l->right = join(l->right, r, spare, rope_node_allocator);
+                return balance(l, rope_node_allocator);
+            }
+            if (r->height > l->height + 1) {
+                r = mutable_node(r, rope_node_allocator);
+                r->left = join(l, r->left, spare, rope_node_allocator);
+                return balance(r, rope_node_allocator);
+            }
+            if (!spare) spare = allocate_node(rope_node_allocator);
+            spare->left = l;
+            spare->right = r;
+            fix_count(spare);
+            return spare;
+        }
+
+        // splits node into [0, pos) and [pos, count), either can be null
+        template <typename rope_node_allocator_t>
+        static std::pair<rope_node_t *, rope_node_t *> split(rope_node_t *node, size_t pos, rope_node_allocator_t& rope_node_allocator) {
+            if (!pos) return { nullptr, node };
+            if (pos >= node->count) return { node, nullptr };
+            node = mutable_node(node, rope_node_allocator);
+            if (node->is_leaf()) {
+                rope_node_t *tail = leaf_node(rope_node_allocator);
+                tail->count = node->count - pos;
+                // a mapped leaf is split by pointing the tail further into the mapping
+                if (node->external) tail->external = node->external + pos;
+                else std::memcpy(tail->ch_buff, node->ch_buff + pos, tail->count);
+                node->count = pos;
+                if (!node->indexed) {
+                    tail->indexed = false;
+                    return { node, tail };
                 }
+                fix_leaf_count(tail);
+                node->newlines -= tail->newlines;
+                fix_leaf_summaries(node);
+                return { node, tail };
             }
+            rope_node_t *left = node->left, *right = node->right;
+            if (pos == left->count) {
+                rope_node_allocator.deallocate(node, 1);
+                return { left, right };
+            }
+            if (pos < left->count) {
+                auto [l, r] = split(left, pos, rope_node_allocator);
+                return { l, join(r, right, node, rope_node_allocator) };
+            }
+            auto [l, r] = split(right, pos - left->count, rope_node_allocator);
+            return { join(left, l, node, rope_node_allocator), r };
         }
 
+        // builds a balanced tree out of str[l, r), leaves are filled upto BUFFER_LENGTH (only the last one can be partial)
         template <typename rope_node_allocator_t>
         static void rope_node_impl(rope_node_t *node, const char *str, size_t l, size_t r, rope_node_allocator_t& rope_node_allocator) {
             if ((r - l) > BUFFER_LENGTH) {
-                size_t m = (l + r) / 2;
+                size_t leaves = (r - l + BUFFER_LENGTH - 1) / BUFFER_LENGTH;
+                size_t m = l + (leaves / 2) * BUFFER_LENGTH;
 
-                node->left = rope_node_allocator.allocate(1);
-                node->left->parent = node;
+                node->left = allocate_node(rope_node_allocator);
                 rope_node_impl(node->left, str, l, m, rope_node_allocator);
-                node->right = rope_node_allocator.allocate(1);
-                node->right->parent = node;
+                node->right = allocate_node(rope_node_allocator);
                 rope_node_impl(node->right, str, m, r, rope_node_allocator);
-                
-                node->count = node->left->count + node->right->count;
+
+                fix_count(node);
+            } else {
+                node->left = node->right = nullptr;
+                node->count = r - l;
+                node->height = 1;
+                node->external = nullptr;
+                if (r - l) std::memcpy(node->ch_buff, str + l, r - l);
+                fix_leaf_count(node);
+            }
+        }
+
+        template <typename rope_node_allocator_t>
+        static void mapped_rope_node_impl(rope_node_t *node, const char *str, size_t l, size_t r, rope_node_allocator_t& rope_node_allocator) {
+            if ((r - l) > mapped_leaf_length) {
+                size_t leaves = (r - l + mapped_leaf_length - 1) / mapped_leaf_length;
+                size_t m = l + (leaves / 2) * mapped_leaf_length;
+
+                node->left = allocate_node(rope_node_allocator);
+                mapped_rope_node_impl(node->left, str, l, m, rope_node_allocator);
+                node->right = allocate_node(rope_node_allocator);
+                mapped_rope_node_impl(node->right, str, m, r, rope_node_allocator);
+
+                fix_count(node);
             } else {
                 node->left = node->right = nullptr;
                 node->count = r - l;
-                size_t index = 0;
-                for (size_t i = l; i < r; i++) {
-                    node->ch_buff[index++] = str[i];
+                node->height = 1;
+                node->external = str + l;
+                node->indexed = false;
+            }
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *build_index_impl(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            if (node->indexed) return node;
+            node = mutable_node(node, rope_node_allocator);
+            if (node->is_leaf()) {
+                fix_leaf_count(node);
+                return node;
+            }
+            node->left = build_index_impl(node->left, rope_node_allocator);
+            node->right = build_index_impl(node->right, rope_node_allocator);
+            fix_count(node);
+            return node;
+        }
+
+        // copies [from, to) of a mapped leaf into owned leaves so it can be edited in place, the rest keeps pointing into the mapping
+        // node has to be mutable, the result is a balanced subtree
+        template <typename rope_node_allocator_t>
+        static rope_node_t *materialize(rope_node_t *node, size_t from, size_t to, rope_node_allocator_t& rope_node_allocator) {
+            assert(node->external && from <= to && to <= node->count);
+            auto [rest, tail] = split(node, to, rope_node_allocator);
+            auto [head, window] = split(rest, from, rope_node_allocator);
+            if (window) {
+                rope_node_t *owned = rope_node(window->external, window->count, rope_node_allocator);
+                delete_rope_node_impl(window, rope_node_allocator);
+                window = owned;
+            }
+            return join(join(head, window, nullptr, rope_node_allocator), tail, nullptr, rope_node_allocator);
+        }
+
+        // applies the edits that touch the subtree of node, which starts at offset, at_end is set if nothing comes after it
+        // an edit touches a subtree if it inserts inside it (or at its end for the last one) or erases part of it
+        template <typename rope_node_allocator_t>
+        static rope_node_t *apply_impl(rope_node_t *node, const edit_t *first, const edit_t *last, size_t offset, bool at_end, std::string& scratch, rope_node_allocator_t& rope_node_allocator) {
+            if (first == last) return node;
+            if (node->is_leaf()) return apply_leaf(node, first, last, offset, at_end, scratch, rope_node_allocator);
+            node = mutable_node(node, rope_node_allocator);
+            size_t middle = offset + node->left->count;
+            // an edit that erases across the middle goes to both sides, its text to the left one
+            const edit_t *left_last = std::partition_point(first, last, [middle](const edit_t& edit) { return edit.pos < middle; });
+            const edit_t *right_first = std::partition_point(first, last, [middle](const edit_t& edit) { return edit.pos + std::max(edit.n, size_t(1)) <= middle; });
+            rope_node_t *left = apply_impl(node->left, first, left_last, offset, false, scratch, rope_node_allocator);
+            rope_node_t *right = apply_impl(node->right, right_first, last, middle, at_end, scratch, rope_node_allocator);
+            // either side can be gone or be a lot taller or shorter now, join rebalances
+            return join(left, right, node, rope_node_allocator);
+        }
+
+        template <typename rope_node_allocator_t>
+        static rope_node_t *apply_leaf(rope_node_t *node, const edit_t *first, const edit_t *last, size_t offset, bool at_end, std::string& scratch, rope_node_allocator_t& rope_node_allocator) {
+            size_t end = offset + node->count;
+            auto inserts_here = [&](const edit_t& edit) { return edit.pos >= offset && (edit.pos < end || (at_end && edit.pos == end)); };
+            if (node->external) {
+                // edits to a mapped leaf are done one by one back to front, so only the text around each of them gets copied
+                for (const edit_t *edit = last; edit-- != first;) {
+                    size_t from = std::max(edit->pos, offset) - offset, to = std::min(edit->pos + edit->n, end) - offset;
+                    if (to > from) node = erase_impl(node, from, to - from, rope_node_allocator);
+                    if (!node) node = leaf_node(rope_node_allocator);
+                    if (inserts_here(*edit) && !edit->text.empty()) node = insert_impl(node, edit->text.data(), edit->text.size(), edit->pos - offset, rope_node_allocator);
+                }
+                if (node->count) return node;
+                delete_rope_node_impl(node, rope_node_allocator);
+                return nullptr;
+            }
+            const char *data = node->ch_buff;
+            scratch.clear();
+            size_t copied = offset;  // the old text is copied upto here
+            for (const edit_t *edit = first; edit != last; edit++) {
+                size_t from = std::max(edit->pos, offset);
+                scratch.append(data + (copied - offset), from - copied);
+                if (inserts_here(*edit)) scratch.append(edit->text);
+                copied = std::max(from, std::min(edit->pos + edit->n, end));
+            }
+            scratch.append(data + (copied - offset), end - copied);
+            if (scratch.empty()) {
+                delete_rope_node_impl(node, rope_node_allocator);
+                return nullptr;
+            }
+            if (scratch.size() > BUFFER_LENGTH) {
+                delete_rope_node_impl(node, rope_node_allocator);
+                return rope_node(scratch.data(), scratch.size(), rope_node_allocator);
+            }
+            node = mutable_node(node, rope_node_allocator);
+            std::memcpy(node->ch_buff, scratch.data(), scratch.size());
+            node->count = scratch.size();
+            fix_leaf_count(node);
+            return node;
+        }
+
+        // leaf with pos in it and its offset, the last leaf for pos == count
+        static std::pair<const rope_node_t *, size_t> leaf_at(const rope_node_t *node, size_t pos) {
+            size_t offset = 0;
+            while (!node->is_leaf()) {
+                if (pos - offset < node->left->count) {
+                    node = node->left;
+                } else {
+                    offset += node->left->count;
+                    node = node->right;
                 }
             }
+            return { node, offset };
         }
 
+        // moves the text of the leaf starting at seam to the end of the leaf before it, if either one is short and they fit together
         template <typename rope_node_allocator_t>
-        static void delete_rope_node_impl(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
-            if (!node) return;
-            if (node->parent) {
-                if (node->parent->left == node) {
-                    node->parent->count -= node->count;
-                    node->parent->left = nullptr;
+        static rope_node_t *merge_at(rope_node_t *root_node, size_t seam, bool& o_merged, rope_node_allocator_t& rope_node_allocator) {
+            o_merged = false;
+            if (!seam || seam >= root_node->count) return root_node;
+            auto [left, left_start] = leaf_at(root_node, seam - 1);
+            auto [right, right_start] = leaf_at(root_node, seam);
+            if (right_start != seam || left->external || right->external) return root_node;
+            if (std::min(left->count, right->count) >= min_leaf_length || left->count + right->count > BUFFER_LENGTH) return root_node;
+            char text[BUFFER_LENGTH];
+            size_t n = right->count;
+            std::memcpy(text, right->ch_buff, n);
+            // erasing the whole leaf takes it out of the tree, and the insert goes to the end of the left leaf since it has room
+            root_node = erase_impl(root_node, seam, n, rope_node_allocator);
+            o_merged = true;
+            return insert_impl(root_node, text, n, seam, rope_node_allocator);
+        }
+
+        // merges the leaves on either side of pos with a neighbour if they are short, costs a descent (or 2 if pos is on a seam)
+        // when they arent
+        template <typename rope_node_allocator_t>
+        static rope_node_t *coalesce(rope_node_t *root_node, size_t pos, rope_node_allocator_t& rope_node_allocator) {
+            for (size_t i = pos ? pos - 1 : pos; i <= pos && i < root_node->count; i++) {
+                auto [leaf, start] = leaf_at(root_node, i);
+                size_t end = start + leaf->count;
+                bool merged = false;
+                if (leaf->count < min_leaf_length && !leaf->external) {
+                    root_node = merge_at(root_node, end, merged, rope_node_allocator);
+                    if (!merged) root_node = merge_at(root_node, start, merged, rope_node_allocator);
                 }
-                if (node->parent->right == node) {
-                    node->parent->count -= node->count;
-                    node->parent->right = nullptr;
+                // the leaf after a seam only needs a look if pos is on one
+                if (end > pos || merged) break;
+            }
+            return root_node;
+        }
+
+        template <typename rope_node_allocator_t>
+        static void pack_leaves(rope_node_t *node, std::vector<rope_node_t *>& o_leaves, rope_node_allocator_t& rope_node_allocator) {
+            if (!node->is_leaf()) {
+                pack_leaves(node->left, o_leaves, rope_node_allocator);
+                pack_leaves(node->right, o_leaves, rope_node_allocator);
+                return;
+            }
+            if (node->external) {
+                o_leaves.push_back(acquire(node));
+                return;
+            }
+            for (size_t copied = 0; copied < node->count;) {
+                rope_node_t *last = o_leaves.empty() ? nullptr : o_leaves.back();
+                if (!last || last->external || last->count == BUFFER_LENGTH) {
+                    last = leaf_node(rope_node_allocator);
+                    o_leaves.push_back(last);
                 }
+                size_t n = std::min(node->count - copied, BUFFER_LENGTH - last->count);
+                std::memcpy(last->ch_buff + last->count, node->ch_buff + copied, n);
+                last->count += n;
+                copied += n;
             }
+        }
+
+        // balanced tree over leaves, which are consumed
+        template <typename rope_node_allocator_t>
+        static rope_node_t *build_from_leaves(rope_node_t *const *leaves, size_t n, rope_node_allocator_t& rope_node_allocator) {
+            if (n == 1) return leaves[0];
+            rope_node_t *node = allocate_node(rope_node_allocator);
+            node->left = build_from_leaves(leaves, n / 2, rope_node_allocator);
+            node->right = build_from_leaves(leaves + n / 2, n - n / 2, rope_node_allocator);
+            fix_count(node);
+            return node;
+        }
+
+        template <typename rope_node_allocator_t>
+        static void delete_rope_node_impl(rope_node_t *node, rope_node_allocator_t& rope_node_allocator) {
+            if (!node || std::atomic_ref<size_t>(node->refs).fetch_sub(1, std::memory_order_acq_rel) != 1) return;
             delete_rope_node_impl(node->left, rope_node_allocator);
             delete_rope_node_impl(node->right, rope_node_allocator);
             rope_node_allocator.deallocate(node, 1);
         }
 
-        template <size_t STACK_SIZE>
-        struct preorder_stack_rope_node_traversal_t {
-            preorder_stack_rope_node_traversal_t(rope_node_t *root_node) {
-                assert(root_node);  // root node cant be null
-                push(root_node);
+        static void slice_impl(const rope_node_t *node, size_t pos, size_t n, char *o_str) {
+            assert(pos <= node->count && pos + n <= node->count);  // bounds check
+            for (std::string_view chunk : chunks_t{ node, pos, pos + n }) {
+                std::memcpy(o_str, chunk.data(), chunk.size());
+                o_str += chunk.size();
             }
+        }
 
-            std::pair<rope_node_t *, size_t> next_node(size_t pos, size_t traversed) {
-                if (current_node) {
-                    assert(current_node->is_leaf());
-                    size_t idx = pos - traversed;
-                    if (idx >= current_node->count) traversed += current_node->count; // update traversed, work in next node
-                    else return { current_node, traversed };  // dont update anything, work in same node
+        // overwrites n chars at pos, the only structural change is mapped leaves getting materialized
+        template <typename rope_node_allocator_t>
+        static rope_node_t *write_impl(rope_node_t *node, const char *str, size_t pos, size_t n, rope_node_allocator_t& rope_node_allocator) {
+            node = mutable_node(node, rope_node_allocator);
+            if (node->is_leaf()) {
+                assert(pos + n <= node->count);
+                if (node->external) {
+                    // pos and n can be large here, the window cant be limited to BUFFER_LENGTH
+                    return write_impl(materialize(node, pos, pos + n, rope_node_allocator), str, pos, n, rope_node_allocator);
                 }
-                while (should_continue()) {
-                    current_node = pop();
-                    if (utils::in_range(traversed, pos, traversed + current_node->count)) {
-                        if (current_node->right) push(current_node->right);
-                        if (current_node->left) push(current_node->left);
-                        if (current_node->is_leaf()) {
-                            return { current_node, traversed };
-                        }
-                    } else {
-                        traversed += current_node->count;
-                    }
+                std::memcpy(node->ch_buff + pos, str, n);
+                fix_leaf_count(node);
+                return node;
+            }
+            size_t left_count = node->left->count;
+            if (pos < left_count) {
+                size_t written = std::min(n, left_count - pos);
+                node->left = write_impl(node->left, str, pos, written, rope_node_allocator);
+                str += written;
+                pos += written;
+                n -= written;
+            }
+            if (n) node->right = write_impl(node->right, str, pos - left_count, n, rope_node_allocator);
+            // lengths dont change, but the newlines can, and a materialized child can be taller
+            return join(node->left, node->right, node, rope_node_allocator);
+        }
+
+        struct segment_t {
+            const char *data;
+            size_t size;
+        };
+
+        // copies n chars starting at from out of the concatenation of the segments
+        static void gather(char *o_str, const segment_t *segments, size_t segment_count, size_t from, size_t n) {
+            for (size_t i = 0; i < segment_count && n; i++) {
+                if (from >= segments[i].size) {
+                    from -= segments[i].size;
+                    continue;
                 }
-                current_node = nullptr;
-                return { current_node, traversed };
-            }
-
-            std::pair<rope_node_t *, size_t> next_node(size_t pos) {
-                size_t traversed = 0;
-                return next_node(pos, traversed);
-            }
-        
-            rope_node_t *next_node() {
-                while (should_continue()) {
-                    current_node = pop();
-                    if (current_node->right) push(current_node->right);
-                    if (current_node->left) push(current_node->left);
-                    if (current_node->is_leaf()) {
-                        return current_node;
-                    }
-                }    
-                current_node = nullptr;
-                return current_node;
+                size_t copied = std::min(n, segments[i].size - from);
+                std::memcpy(o_str, segments[i].data + from, copied);
+                o_str += copied;
+                n -= copied;
+                from = 0;
             }
+        }
 
-        private:
-            bool should_continue() { return stack_idx; }
-            void push(rope_node_t *node) {
-                assert(stack_idx < STACK_SIZE);  // overflow
-                stack[stack_idx++] = node;
+        template <typename rope_node_allocator_t>
+        static rope_node_t *insert_leaf(rope_node_t *node, const char *str, size_t size, size_t pos, rope_node_allocator_t& rope_node_allocator) {
+            // only the text around pos is copied out of the mapping, then the insert goes into that owned leaf
+            if (node->external) {
+                size_t from = pos - std::min(pos, BUFFER_LENGTH / 4), to = pos + std::min(node->count - pos, BUFFER_LENGTH / 4);
+                return insert_impl(materialize(node, from, to, rope_node_allocator), str, size, pos, rope_node_allocator);
             }
-            rope_node_t *pop() {
-                assert(stack_idx > 0);  // underflow
-                return stack[--stack_idx];
+            // fast path, the leaf has space
+            if (node->count + size <= BUFFER_LENGTH) {
+                std::memmove(node->ch_buff + pos + size, node->ch_buff + pos, node->count - pos);
+                std::memcpy(node->ch_buff + pos, str, size);
+                node->count += size;
+                node->newlines += utils::count_newlines(str, size);
+                fix_leaf_summaries(node);
+                return node;
             }
 
-            rope_node_t *current_node = nullptr;
-            size_t stack_idx = 0;
-            rope_node_t *stack[STACK_SIZE];
-        };
+            size_t total = node->count + size;
+            // fits in 2 leaves, redistribute
+            if (total <= 2 * BUFFER_LENGTH) {
+                // appends keep the leaf full and prepends keep it untouched, so typing at either end doesnt leave half empty leaves behind
+                size_t m = pos == node->count ? node->count : pos == 0 ? size : total / 2;
+                m = std::clamp(m, total - BUFFER_LENGTH, BUFFER_LENGTH);
 
-        static void slice_impl(rope_node_t *node, size_t pos, size_t n, char *o_str) {
-            assert(pos <= node->count && pos + n <= node->count);  // bounds check
-            size_t str_idx = 0;
-            preorder_stack_rope_node_traversal_t<64> preorder_stack_rope_node_traversal(node);
-            auto [current_node, traversed] = preorder_stack_rope_node_traversal.next_node(pos);
-            while (n) {
-                assert(current_node);  // in general shouldnt be null ?
-                size_t idx = pos - traversed;
-                for (size_t i = idx; i < current_node->count; i++) {
-                    assert(utils::in_range(size_t{0}, i, current_node->count));
-                    o_str[str_idx++] = current_node->ch_buff[i];
-                    n--; if (!n) return;
+                segment_t segments[3] = { { node->ch_buff, pos }, { str, size }, { node->ch_buff + pos, node->count - pos } };
+                rope_node_t *tail = leaf_node(rope_node_allocator);
+                tail->count = total - m;
+                gather(tail->ch_buff, segments, 3, m, tail->count);
+                fix_leaf_count(tail);
+
+                // node becomes the head, only the part after pos has to move, the rest is already in place
+                if (m > pos) {
+                    size_t moved = m - std::min(m, pos + size);
+                    std::memmove(node->ch_buff + pos + size, node->ch_buff + pos, moved);
+                    std::memcpy(node->ch_buff + pos, str, std::min(size, m - pos));
                 }
-                pos += current_node->count - idx;
-                traversed += current_node->count;
-                current_node = preorder_stack_rope_node_traversal.next_node();
+                node->count = m;
+                fix_leaf_count(node);
+                return join(node, tail, nullptr, rope_node_allocator);
             }
-            return;
+
+            // large insert, build the inserted text as its own balanced tree and join the pieces
+            rope_node_t *middle = rope_node(str, size, rope_node_allocator);
+            auto [l, r] = split(node, pos, rope_node_allocator);
+            return join(join(l, middle, nullptr, rope_node_allocator), r, nullptr, rope_node_allocator);
         }
 
         template <typename rope_node_allocator_t>
-        static void set_slice_impl(rope_node_t *&node, const char *str, size_t size, size_t pos, size_t n, rope_node_allocator_t& rope_node_allocator) {
-            assert(pos <= node->count && pos + n <= node->count);
+        static rope_node_t *insert_impl(rope_node_t *node, const char *str, size_t size, size_t pos, rope_node_allocator_t& rope_node_allocator) {
+            node = mutable_node(node, rope_node_allocator);
+            if (node->is_leaf()) return insert_leaf(node, str, size, pos, rope_node_allocator);
+            // prefer the left subtree on the boundary, so appending to a leaf is preferred over prepending
+            if (pos <= node->left->count) node->left = insert_impl(node->left, str, size, pos, rope_node_allocator);
+            else node->right = insert_impl(node->right, str, size, pos - node->left->count, rope_node_allocator);
+            // a large insert can grow the child by more than 1 level, join takes care of rebalancing in that case
+            return join(node->left, node->right, node, rope_node_allocator);
+        }
 
-            preorder_stack_rope_node_traversal_t<64> preorder_stack_rope_node_traversal(node);
-            size_t str_idx = 0;
-            // adding to the end, u cant delete at node->count, can only add
-            if (pos == node->count) {
-                auto [current_node, traversed] = preorder_stack_rope_node_traversal.next_node(pos - 1);  // get the node with the last char
-                // empty node
-                if (!current_node && node->is_leaf()) {
-                    assert(!traversed);  // traversed is null here
-                    current_node = node;    
-                }
-                assert(current_node);  // in general shouldnt be null ?
-                if (current_node->count < BUFFER_LENGTH) {  // last node has space to accomodate 
-                    for (size_t i = current_node->count; i < BUFFER_LENGTH; i++) {
-                        current_node->ch_buff[i] = str[str_idx++];
-                        if (str_idx == size) break;
-                    }
-                    current_node->count += str_idx;  // increase node count by how many characters we were able to shove
-                    fix_parent_count(current_node);  // if node count is updated, the parents need to get updated
-                }
-                if (str_idx == size) return;  // early return, no need to create new space
-                rope_node_t *r1 = node;
-                rope_node_t *r2 = rope_node_allocator.allocate(1);
-                r2->parent = nullptr;
-                rope_node_impl(r2, str, str_idx, size, rope_node_allocator);
-                node = concate(r1, r2, rope_node_allocator);
-                return;
+        // returns null if the whole subtree got erased
+        template <typename rope_node_allocator_t>
+        static rope_node_t *erase_impl(rope_node_t *node, size_t pos, size_t n, rope_node_allocator_t& rope_node_allocator) {
+            if (!pos && n >= node->count) {
+                delete_rope_node_impl(node, rope_node_allocator);
+                return nullptr;
             }
-            auto [current_node, traversed] = preorder_stack_rope_node_traversal.next_node(pos);
-            assert(current_node);  // shouldnt really happen ?
-            
-            size_t num_max_affected_nodes = size_t(std::ceil(float(size) / float(BUFFER_LENGTH))) + 3;
-            rope_node_t *affected_nodes[num_max_affected_nodes];
-            size_t affected_node_idx = 0;
-
-            // case size == n  // size of writes == selection region 
-            if (size == n) {
-                while (current_node) {
-                    assert(current_node);  // should never fail in general ?
-                    size_t idx = pos - traversed;
-                    for (size_t i = idx; i < current_node->count; i++) {
-                        current_node->ch_buff[i] = str[str_idx++];
-                        size--;  // size reduced with each write
-                        n--;  // selection region reduced with each write
-                        pos++;  // advance the position every write
-                        if (!n) return;  // no more selection or writes anymore, no need to update any count, so can leave
-                    }
-                    auto pair = preorder_stack_rope_node_traversal.next_node(pos, traversed);
-                    current_node = pair.first;
-                    traversed = pair.second;
+            node = mutable_node(node, rope_node_allocator);
+            if (node->is_leaf() && node->external) {
+                // small erases are done in an owned copy of the text around them, large ones just cut the mapped leaf
+                if (n <= BUFFER_LENGTH / 2) {
+                    size_t from = pos - std::min(pos, BUFFER_LENGTH / 4), to = pos + n + std::min(node->count - pos - n, BUFFER_LENGTH / 4);
+                    return erase_impl(materialize(node, from, to, rope_node_allocator), pos, n, rope_node_allocator);
                 }
-                assert(false); // should never reach this
-            }
-
-            // case size < n  // write less than the selection region
-            if (size < n) {
-                // complete all writes first
-                if (size) {
-                    while (current_node) {
-                        affected_nodes[affected_node_idx++] = current_node;
-                        assert(affected_node_idx <= num_max_affected_nodes);
-
-                        assert(current_node);  // should never fail in general ?
-                        size_t idx = pos - traversed;
-                        for (size_t i = idx; i < current_node->count; i++) {
-                            current_node->ch_buff[i] = str[str_idx++];
-                            size--;  // size of writes reduced with each writes
-                            n--;  // selection region reduces with with write
-                            pos++;  // advance position with each write
-                            if (!size) break;  // leave for, no more writes
-                        }
-                        auto pair = preorder_stack_rope_node_traversal.next_node(pos, traversed);
-                        current_node = pair.first;
-                        traversed = pair.second;
-                        if (!size) break;  // leave while
-                    }
-                }
-                
-                assert(!size); // all writes should be done here
-
-                assert(current_node); // should be valid here
-                while (current_node) {
-                    if (affected_nodes[affected_node_idx - 1] != current_node) {  // dont push same node as current node
-                        affected_nodes[affected_node_idx++] = current_node;
-                        assert(affected_node_idx <= num_max_affected_nodes);
-                    }
-                    
-                    // things that can happen
-                        // case 1: [elem, elem, <-]
-                            // in this case, trim the node count
-                            // n = n - (current_node->count - idx)
-                            // current_node->count = idx
-                        // case 2: [elem, ->, <-, elem]
-                            // move elements back n spaces from idx
-                            // current_node->count -= n
-                        // case 3: [->,<-] : idx == 0
-                            // in this case set the node count to 0
-                            // n = n - current_node->count
-                            // current_node->count = 0
-                        // case 4: [->, elem, elem] == 0
-                            // in this case  memcpy and move the array by n elements 
-                            // and set the node count
-                            // current_node->count -= n
-
-                    size_t idx = pos - traversed;
-                    if (idx == 0) {
-                        if (n >= current_node->count) {  // case 3
-                            n -= current_node->count;
-                            current_node->count = 0;
-                        } else {  // case 4
-                            std::memcpy(current_node->ch_buff, current_node->ch_buff + n, current_node->count - n);
-                            current_node->count -= n;
-                            n = 0;
-                        }
-                    } else {
-                        if (idx + n >= current_node->count) {  // case 1
-                            n -= (current_node->count - idx);
-                            current_node->count = idx;
-                        } else {  // case 2
-                            std::memcpy(current_node->ch_buff + idx, current_node->ch_buff + idx + n, current_node->count - (idx + n));
-                            current_node->count -= n;
-                            n = 0;
-                        }
-                    }
+                auto [head, rest] = split(node, pos, rope_node_allocator);
+                auto [middle, tail] = split(rest, n, rope_node_allocator);
+                delete_rope_node_impl(middle, rope_node_allocator);
+                return join(head, tail, nullptr, rope_node_allocator);
+            }
+            if (node->is_leaf()) {
+                node->newlines -= utils::count_newlines(node->ch_buff + pos, n);
+                std::memmove(node->ch_buff + pos, node->ch_buff + pos + n, node->count - (pos + n));
+                node->count -= n;
+                fix_leaf_summaries(node);
+                return node;
+            }
+            size_t left_count = node->left->count;
+            rope_node_t *left = node->left, *right = node->right;
+            if (pos < left_count) {
+                size_t erased = std::min(n, left_count - pos);
+                left = erase_impl(left, pos, erased, rope_node_allocator);
+                n -= erased;
+                pos = left_count;
+            }
+            if (n) right = erase_impl(right, pos - left_count, n, rope_node_allocator);
+            return join(left, right, node, rope_node_allocator);
+        }
 
-                    if (!n) break;
-                    traversed += current_node->count; // value is always updated to the start of every nodes affected value
-                    current_node = preorder_stack_rope_node_traversal.next_node();
-                }
+        // true if both hold the same text, only leaves are compared byte by byte, internal nodes need to share or have a hash
+        static bool same(const rope_node_t *a, const rope_node_t *b) {
+            if (a == b) return true;
+            if (a->count != b->count) return false;
+            if constexpr (hashed) {
+                if (a->indexed && b->indexed) return std::get<hash_index>(a->summaries) == std::get<hash_index>(b->summaries);
+            }
+            return a->is_leaf() && b->is_leaf() && !std::memcmp(a->data(), b->data(), a->count);
+        }
 
-                for (size_t i = 0; i < affected_node_idx; i++) {
-                    rope_node_t *node = affected_nodes[i];
-                    // TODO: (optimization) double update parent node count optimisation
-                    fix_parent_count(node);
-                }
-                return;
+        // the subtrees left to visit in order, the back of stack is the next one
+        struct walk_t {
+            explicit walk_t(const rope_node_t *root) : root(root) {
+                if (root->count) stack.push_back(root);
             }
 
-            // case size > n // write more than the selection region            
-            if (size > n) {
-                if (n) {
-                    while (current_node) {
-                        affected_nodes[affected_node_idx++] = current_node;
-                        assert(affected_node_idx <= num_max_affected_nodes);
-
-                        assert(current_node);  // should never fail in general ?
-                        size_t idx = pos - traversed;
-                        for (size_t i = idx; i < current_node->count; i++) {
-                            current_node->ch_buff[i] = str[str_idx++];
-                            size--;  // size of writes reduced with each writes
-                            n--;  // selection region reduces with with write
-                            pos++;  // advance position with each write
-                            if (!n) break;  // leave for, no more selections
-                        }
-                        // TODO: (optimization) if current_node->count < BUFFER_LENGTH, write any extra writes here and pull back from next node 
-                        auto pair = preorder_stack_rope_node_traversal.next_node(pos, traversed);
-                        current_node = pair.first;
-                        traversed = pair.second;
-                        if (!n) break;  // leave while
+            bool done() const { return stack.empty(); }
+            const rope_node_t *top() const { return stack.back(); }
+
+            void pop() {
+                pos += stack.back()->count;
+                stack.pop_back();
+            }
+
+            void expand() {
+                const rope_node_t *node = stack.back();
+                stack.back() = node->right;
+                stack.push_back(node->left);
+            }
+
+            // starts over from to, a node has to start there
+            void seek(size_t to) {
+                stack.clear();
+                pos = to;
+                const rope_node_t *node = root;
+                size_t start = 0;
+                while (start != to) {
+                    assert(!node->is_leaf());
+                    if (to < start + node->left->count) {
+                        stack.push_back(node->right);
+                        node = node->left;
+                    } else {
+                        start += node->left->count;
+                        node = node->right;
                     }
                 }
+                stack.push_back(node);
+            }
 
-                assert(!n);  // all selections should be done here
+            const rope_node_t *root;
+            std::vector<const rope_node_t *> stack;
+            size_t pos = 0;  // offset of the next subtree
+        };
+
+        // adds [a_begin, a_end) -> [b_begin, b_end) without the bytes both start and end with, nothing if that leaves nothing
+        static void add_change(const rope_node_t *a, size_t a_begin, size_t a_end, const rope_node_t *b, size_t b_begin, size_t b_end, std::vector<change_t>& o_changes) {
+            size_t n = std::min(a_end - a_begin, b_end - b_begin);
+            size_t prefix = common_prefix(a, a_begin, b, b_begin, n);
+            size_t suffix = common_suffix(a, a_end, b, b_end, n - prefix);
+            a_begin += prefix;
+            b_begin += prefix;
+            a_end -= suffix;
+            b_end -= suffix;
+            if (a_begin == a_end && b_begin == b_end) return;
+            o_changes.push_back({ a_begin, a_end - a_begin, b_begin, b_end - b_begin });
+        }
 
-                assert(current_node);
+        // length of the common prefix of [a_pos, a_pos + n) and [b_pos, b_pos + n)
+        static size_t common_prefix(const rope_node_t *a, size_t a_pos, const rope_node_t *b, size_t b_pos, size_t n) {
+            if (!n) return 0;
+            chunk_iterator_t itr_a(a, a_pos, a_pos + n, a_pos), itr_b(b, b_pos, b_pos + n, b_pos);
+            std::string_view chunk_a = *itr_a, chunk_b = *itr_b;
+            size_t prefix = 0;
+            while (true) {
+                size_t m = std::min(chunk_a.size(), chunk_b.size());
+                size_t equal = size_t(std::mismatch(chunk_a.begin(), chunk_a.begin() + m, chunk_b.begin()).first - chunk_a.begin());
+                prefix += equal;
+                if (equal < m || prefix == n) return prefix;
+                chunk_a.remove_prefix(m);
+                chunk_b.remove_prefix(m);
+                if (chunk_a.empty()) chunk_a = *++itr_a;
+                if (chunk_b.empty()) chunk_b = *++itr_b;
+            }
+        }
 
-                size_t idx = pos - traversed;
+        // length of the common suffix of [a_end - n, a_end) and [b_end - n, b_end)
+        static size_t common_suffix(const rope_node_t *a, size_t a_end, const rope_node_t *b, size_t b_end, size_t n) {
+            if (!n) return 0;
+            chunk_iterator_t itr_a(a, a_end - n, a_end, a_end), itr_b(b, b_end - n, b_end, b_end);
+            std::string_view chunk_a = *--itr_a, chunk_b = *--itr_b;
+            size_t suffix = 0;
+            while (true) {
+                size_t m = std::min(chunk_a.size(), chunk_b.size());
+                size_t equal = size_t(std::mismatch(chunk_a.rbegin(), chunk_a.rbegin() + m, chunk_b.rbegin()).first - chunk_a.rbegin());
+                suffix += equal;
+                if (equal < m || suffix == n) return suffix;
+                chunk_a.remove_suffix(m);
+                chunk_b.remove_suffix(m);
+                if (chunk_a.empty()) chunk_a = *--itr_a;
+                if (chunk_b.empty()) chunk_b = *--itr_b;
+            }
+        }
+    };
 
-                // shuffle data
-                char new_str[size];  // copy left over str into new buffer (hack, probably can do it without this, need to do it cause str is const)
-                char temp[current_node->count - idx];  // left over part
+    // walks the leaves overlapping [begin, end) and hands out each of them as a string_view into its text, nothing is copied
+    // keeps the root to leaf path, so moving to the next/previous leaf is amortized O(1)
+    // any edit to the rope invalidates the iterator
+    class chunk_iterator_t {
+    public:
+        using value_type = std::string_view;
+        using reference = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
 
+        static constexpr size_t max_depth = 64;  // the tree is balanced, 64 levels is way more than any document that fits in memory
 
-                // debug only checks
-                char *new_str_end = &new_str[size];
-                char *new_str_begin = new_str;
-                char *temp_end = &temp[current_node->count - idx];
-                char *temp_begin = temp;
+        chunk_iterator_t() = default;
 
-                // TODO: debug bound assert for str
-                std::memcpy(new_str, str + str_idx, size);
-                str_idx = 0;
+        // pos == end is the end iterator
+        chunk_iterator_t(const rope_node_t *root_node, size_t begin, size_t end, size_t pos) : _root_node(root_node), _begin(begin), _end(end) {
+            assert(begin <= end && end <= root_node->count);  // bounds check
+            if (pos < end) descend(pos);
+        }
 
-                std::memcpy(temp, current_node->ch_buff + idx, (current_node->count - idx));
-                std::memcpy(current_node->ch_buff + idx, new_str, std::min(size, (current_node->count - idx)));
-                if (size <= (current_node->count - idx)) {
-                    std::memcpy(current_node->ch_buff + idx + size, temp, (current_node->count - idx) - size);
-                    std::memcpy(new_str, temp + (current_node->count - idx) - size, size);
-                } else {
-                    std::memcpy(new_str, new_str + (current_node->count - idx), size - (current_node->count - idx));
-                    std::memcpy(new_str + size - (current_node->count - idx), temp, (current_node->count - idx));                        
-                }
-                
-                // try to put the how much ever u can of the new str data
-                if (current_node->count < BUFFER_LENGTH) {
-                    for (size_t i = current_node->count; i < BUFFER_LENGTH; i++) {
-                        current_node->ch_buff[i] = new_str[str_idx++];
-                        size--;  // reduce write size
-                        pos++;
-                        if (!size) break;
-                    }
-                    current_node->count += str_idx;
-                    if (affected_nodes[affected_node_idx - 1] != current_node) {  // dont push same node as current node
-                        affected_nodes[affected_node_idx++] = current_node;
-                        assert(affected_node_idx <= num_max_affected_nodes);
-                    }
-                }
+        std::string_view operator*() const {
+            const rope_node_t *leaf = _path[_depth - 1];
+            size_t from = offset(), to = std::min(_end, _leaf_start + leaf->count);
+            return { leaf->data() + (from - _leaf_start), to - from };
+        }
 
-                // create new nodes
-                if (size) {
-                    // TODO: (optimization) try add in atleast 1 node ahead to avoid soo many node allocations
-                    assert(current_node->count == BUFFER_LENGTH);
-                    current_node->left = rope_node_allocator.allocate(1);
-                    current_node->right = rope_node_allocator.allocate(1);
-                    current_node->left->left = current_node->left->right = current_node->right->left = current_node->right->right = nullptr;
-                    current_node->left->parent = current_node->right->parent = current_node;
-                    std::memcpy(current_node->left->ch_buff, current_node->ch_buff, BUFFER_LENGTH);
-                    current_node->left->count = BUFFER_LENGTH;
-                    rope_node_impl(current_node->right, new_str + str_idx, 0, size, rope_node_allocator);
-
-                    affected_nodes[affected_node_idx++] = current_node->left;
-                    assert(affected_node_idx <= num_max_affected_nodes);
-                    affected_nodes[affected_node_idx++] = current_node->right;
-                    assert(affected_node_idx <= num_max_affected_nodes);
-                }
+        // offset in the rope of the first char of the current chunk
+        size_t offset() const {
+            return std::max(_begin, _leaf_start);
+        }
 
+        chunk_iterator_t& operator++() {
+            assert(_depth);  // cant go past the end
+            _leaf_start += _path[_depth - 1]->count;
+            if (_leaf_start >= _end) {
+                _depth = 0;
+                return *this;
+            }
+            // climb up till we come from a left child, then take the leftmost leaf of the right sibling
+            while (_path[_depth - 2]->right == _path[_depth - 1]) _depth--;
+            _path[_depth - 1] = _path[_depth - 2]->right;
+            while (!_path[_depth - 1]->is_leaf()) push(_path[_depth - 1]->left);
+            return *this;
+        }
 
-                for (size_t i = 0; i < affected_node_idx; i++) {
-                    rope_node_t *node = affected_nodes[i];
-                    // TODO: (optimization) double update parent node count optimisation
-                    fix_parent_count(node);
+        chunk_iterator_t operator++(int) {
+            chunk_iterator_t itr = *this;
+            ++*this;
+            return itr;
+        }
+
+        chunk_iterator_t& operator--() {
+            if (!_depth) {
+                assert(_begin < _end);  // cant go before the begining
+                descend(_end - 1);
+                return *this;
+            }
+            assert(_leaf_start > _begin);  // cant go before the begining
+            while (_path[_depth - 2]->left == _path[_depth - 1]) _depth--;
+            _path[_depth - 1] = _path[_depth - 2]->left;
+            while (!_path[_depth - 1]->is_leaf()) push(_path[_depth - 1]->right);
+            _leaf_start -= _path[_depth - 1]->count;
+            return *this;
+        }
+
+        chunk_iterator_t operator--(int) {
+            chunk_iterator_t itr = *this;
+            --*this;
+            return itr;
+        }
+
+        // only meaningful for iterators over the same range
+        bool operator==(const chunk_iterator_t& other) const {
+            return _depth == other._depth && (!_depth || _path[_depth - 1] == other._path[_depth - 1]);
+        }
+
+    private:
+        void push(const rope_node_t *node) {
+            assert(_depth < max_depth);  // overflow
+            _path[_depth++] = node;
+        }
+
+        void descend(size_t pos) {
+            const rope_node_t *node = _root_node;
+            _depth = 0;
+            _leaf_start = 0;
+            push(node);
+            while (!node->is_leaf()) {
+                if (pos < node->left->count) {
+                    node = node->left;
+                } else {
+                    _leaf_start += node->left->count;
+                    pos -= node->left->count;
+                    node = node->right;
                 }
-                return;
+                push(node);
             }
-            assert(false); // should never come here
         }
+
+        const rope_node_t *_root_node = nullptr;
+        size_t _begin = 0, _end = 0;
+        size_t _leaf_start = 0;  // offset in the rope of the first char of the current leaf
+        size_t _depth = 0;  // 0 is the end iterator
+        const rope_node_t *_path[max_depth];
+    };
+
+    // models std::ranges::bidirectional_range, so it can be reversed with std::views::reverse
+    class chunks_t : public std::ranges::view_interface<chunks_t> {
+    public:
+        chunks_t() = default;
+        chunks_t(const rope_node_t *root_node, size_t begin, size_t end) : _root_node(root_node), _begin(begin), _end(end) {}
+
+        chunk_iterator_t begin() const { return { _root_node, _begin, _end, _begin }; }
+        chunk_iterator_t end() const { return { _root_node, _begin, _end, _end }; }
+
+    private:
+        const rope_node_t *_root_node = nullptr;
+        size_t _begin = 0, _end = 0;
+    };
+
+    // remembers the root to leaf path of the last edit or read made through it, so the next one close by doesnt start from the root
+    // edits that stay inside the leaf are done in place, only the counts of the ancestors are fixed up, and moving to a nearby
+    // leaf only climbs as far as needed
+    // keep one per caret for multi caret editing, a cursor edit doesnt invalidate the others
+    // the path is walked again from the root after anything that changes the shape of the tree or shares its nodes (edits without
+    // a cursor, edits that dont fit in the leaf, copies and snapshots)
+    class cursor_t {
+    public:
+        cursor_t() = default;
+
+    private:
+        friend class rope_t;
+
+        rope_node_t *_path[chunk_iterator_t::max_depth];
+        size_t _offsets[chunk_iterator_t::max_depth];  // offset in the rope of the first char of each node on the path
+        size_t _depth = 0;
+        size_t _exclusive = 0;  // nodes on the path, from the root, that only this rope points to, in place edits need all of them
+        uint64_t _shape = 0;  // rope_t::_shape of the rope when the path was walked, 0 never matches
+        uint64_t _edits = 0;  // rope_t::_edits when _offsets were computed
     };
 
     typedef allocator<rope_node_t> rope_node_allocator_t;
 
-    rope_t(const std::string& str) : _rope_node_allocator(), _root_node(rope_node_t::rope_node(str, _rope_node_allocator)) {}
+    // allocator shared by a rope, its copies and its snapshots, so nodes can outlive the rope that created them
+    // it is passed in place of the allocator to the rope_node_t functions, so it also keeps count of the nodes alive
+    struct node_pool_t {
+        ~node_pool_t() { collect(); }
+
+        rope_node_t *allocate(size_t n) {
+            live_nodes += n;
+            return rope_node_allocator.allocate(n);
+        }
+
+        void deallocate(rope_node_t *node, size_t n) {
+            live_nodes -= n;
+            rope_node_allocator.deallocate(node, n);
+        }
+
+        // safe to call from any thread, the node is linked into the graveyard through left
+        void bury(rope_node_t *node) {
+            buried_nodes.fetch_add(1, std::memory_order_relaxed);
+            node->left = graveyard.load(std::memory_order_relaxed);
+            while (!graveyard.compare_exchange_weak(node->left, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // frees the nodes dropped by snapshots, only to be called by the thread that edits the ropes
+        void collect() {
+            if (!graveyard.load(std::memory_order_relaxed)) return;
+            rope_node_t *node = graveyard.exchange(nullptr, std::memory_order_acquire);
+            while (node) {
+                rope_node_t *next = node->left;
+                buried_nodes.fetch_sub(1, std::memory_order_relaxed);
+                deallocate(node, 1);
+                node = next;
+            }
+        }
+
+        // bytes taken by the nodes that are still reachable from a rope or a snapshot
+        size_t memory_usage() const {
+            return (live_nodes - buried_nodes.load(std::memory_order_relaxed)) * sizeof(rope_node_t);
+        }
+
+        rope_node_allocator_t rope_node_allocator;
+        std::vector<std::shared_ptr<const core::mapped_file_t>> mapped_files;  // kept alive for the leaves pointing into them
+        size_t live_nodes = 0;  // only touched by the thread that edits the ropes
+        std::atomic<size_t> buried_nodes = 0;
+        std::atomic<rope_node_t *> graveyard = nullptr;
+    };
+
+    // immutable O(1) view of a rope at some point in time, shares all of its nodes with the rope
+    // meant to be handed to other threads (highlighting, search, autosave) while the rope keeps getting edited
+    // a snapshot can be read and dropped from any thread
+    class snapshot_t {
+    public:
+        snapshot_t(const snapshot_t& other) : _node_pool(other._node_pool), _root_node(rope_node_t::acquire(other._root_node)) {}
+
+        snapshot_t& operator=(snapshot_t other) {
+            std::swap(_node_pool, other._node_pool);
+            std::swap(_root_node, other._root_node);
+            return *this;
+        }
+
+        ~snapshot_t() {
+            rope_node_t::release(_root_node, *_node_pool);
+        }
+
+        void slice(size_t pos, size_t n, char *o_str) const {
+            rope_node_t::slice(_root_node, pos, n, o_str);
+        }
+
+        chunks_t chunks() const {
+            return chunks(0, size());
+        }
+
+        chunks_t chunks(size_t pos, size_t n) const {
+            assert(pos <= size() && pos + n <= size());  // bounds check
+            return { _root_node, pos, pos + n };
+        }
+
+        std::string to_string() const {
+            std::string str;
+            str.resize(size());
+            rope_node_t::slice(_root_node, 0, size(), str.data());
+            return str;
+        }
+
+        // meant for autosaving from another thread while the rope keeps getting edited
+        bool save(const std::filesystem::path& path, bool sync = false) const {
+            return rope_node_t::save(_root_node, path, sync);
+        }
+
+        size_t size() const {
+            return _root_node->count;
+        }
+
+        size_t line_count() const {
+            assert(_root_node->indexed);
+            return _root_node->newlines + 1;
+        }
+
+        bool indexed() const {
+            return _root_node->indexed;
+        }
+
+        size_t line_to_offset(size_t line) const {
+            return rope_node_t::line_to_offset(_root_node, line);
+        }
+
+        size_t offset_to_line(size_t pos) const {
+            return rope_node_t::offset_to_line(_root_node, pos);
+        }
+
+        template <typename summary_t>
+        typename summary_t::value_t summary() const {
+            return summary<summary_t>(0, size());
+        }
+
+        template <typename summary_t>
+        typename summary_t::value_t summary(size_t pos, size_t n) const {
+            return rope_node_t::template summary<summary_t>(_root_node, pos, n);
+        }
+
+        // see rope_t::find_summary()
+        template <typename summary_t, typename pred_t>
+        size_t find_summary(size_t pos, pred_t pred) const {
+            typename summary_t::value_t acc = summary_t::from_leaf(nullptr, 0);
+            return rope_node_t::template find_summary<summary_t>(_root_node, pos, acc, pred);
+        }
+
+        template <typename summary_t, typename pred_t>
+        size_t rfind_summary(size_t pos, pred_t pred) const {
+            typename summary_t::value_t acc = summary_t::from_leaf(nullptr, 0);
+            return rope_node_t::template rfind_summary<summary_t>(_root_node, pos, acc, pred);
+        }
+
+        size_t depth() const {
+            return _root_node->height;
+        }
+
+        size_t memory_usage() const {
+            return _node_pool->memory_usage();
+        }
+
+        // see rope_t::equals()
+        bool equals(const snapshot_t& other) const {
+            return rope_node_t::equals(_root_node, other._root_node);
+        }
+
+    private:
+        friend class rope_t;
+
+        snapshot_t(std::shared_ptr<node_pool_t> node_pool, rope_node_t *root_node) : _node_pool(std::move(node_pool)), _root_node(rope_node_t::acquire(root_node)) {}
+
+        std::shared_ptr<node_pool_t> _node_pool;
+        rope_node_t *_root_node;
+    };
+
+    rope_t(const std::string& str) : _node_pool(std::make_shared<node_pool_t>()), _root_node(rope_node_t::rope_node(str, *_node_pool)) {}
+
+    // O(size / mapped_leaf_length), nothing in the file is read, pages are only loaded when the text is read or edited around them
+    // line and summary queries need build_index() first, which reads the file once
+    explicit rope_t(std::shared_ptr<const core::mapped_file_t> mapped_file)
+      : _node_pool(std::make_shared<node_pool_t>()), _root_node(rope_node_t::mapped_rope_node(mapped_file->data(), mapped_file->size(), *_node_pool)) {
+        _node_pool->mapped_files.push_back(std::move(mapped_file));
+    }
+
+    // O(1), both ropes share all the nodes until one of them gets edited
+    rope_t(const rope_t& other) : _node_pool(other._node_pool), _root_node(rope_node_t::acquire(other._root_node)) {
+        other.changed();
+    }
+
+    // O(1), edits on the rope path copy the nodes shared with the snapshot, this is how a snapshot is edited persistently
+    explicit rope_t(const snapshot_t& snapshot) : _node_pool(snapshot._node_pool), _root_node(rope_node_t::acquire(snapshot._root_node)) {}
+
+    rope_t& operator=(rope_t other) {
+        std::swap(_node_pool, other._node_pool);
+        std::swap(_root_node, other._root_node);
+        changed();
+        return *this;
+    }
 
     ~rope_t() {
-        rope_node_t::delete_rope_node(_root_node, _rope_node_allocator);
+        // allocators that own their memory (core::slab_allocator_t) can drop all the nodes at once instead of walking the tree,
+        // but only if no other rope or snapshot is still using them
+        if constexpr (requires(rope_node_allocator_t& rope_node_allocator) { rope_node_allocator.release(); }) {
+            if (_node_pool.use_count() == 1) {
+                _node_pool->graveyard = nullptr;
+                _node_pool->rope_node_allocator.release();
+                return;
+            }
+        }
+        _node_pool->collect();
+        rope_node_t::delete_rope_node(_root_node, *_node_pool);
+    }
+
+    // O(1)
+    snapshot_t snapshot() const {
+        changed();
+        return { _node_pool, _root_node };
     }
 
     void slice(size_t pos, size_t n, char *o_str) const {
@@ -464,7 +1481,76 @@ public:
     }
 
     void set_slice(const char *str, size_t size, size_t pos, size_t n) {
-        rope_node_t::set_slice(_root_node, str, size, pos, n, _rope_node_allocator);
+        _node_pool->collect();
+        rope_node_t::set_slice(_root_node, str, size, pos, n, *_node_pool);
+        changed();
+    }
+
+    void insert(const char *str, size_t size, size_t pos) {
+        _node_pool->collect();
+        rope_node_t::insert(_root_node, str, size, pos, *_node_pool);
+        changed();
+    }
+
+    void erase(size_t pos, size_t n) {
+        _node_pool->collect();
+        rope_node_t::erase(_root_node, pos, n, *_node_pool);
+        changed();
+    }
+
+    // a batch of edits in one pass over the tree, edits have to be sorted by pos and not overlap, positions are in the text before
+    // the batch, O(k log(n / k) + size of the text written) for k edits instead of O(k log n), a replace all touching most leaves is
+    // a single linear rewrite of the tree
+    void apply(std::span<const edit_t> edits) {
+        _node_pool->collect();
+        rope_node_t::apply(_root_node, edits, *_node_pool);
+        changed();
+    }
+
+    // same as the ones above, but O(1) (+ the size of the text and the count fix ups on the path) when the edit fits in the leaf
+    // the cursor is at, anywhere else they cost what they would without a cursor, plus the walk that moves the cursor there
+    void slice(cursor_t& cursor, size_t pos, size_t n, char *o_str) const {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        seek(cursor, pos);
+        const rope_node_t *leaf = cursor._path[cursor._depth - 1];
+        size_t offset = pos - cursor._offsets[cursor._depth - 1];
+        if (offset + n <= leaf->count) std::memcpy(o_str, leaf->data() + offset, n);
+        else rope_node_t::slice(_root_node, pos, n, o_str);
+    }
+
+    void set_slice(cursor_t& cursor, const char *str, size_t size, size_t pos, size_t n) {
+        assert(pos <= this->size() && pos + n <= this->size());  // bounds check
+        _node_pool->collect();
+        seek(cursor, pos);
+        rope_node_t *leaf = cursor._path[cursor._depth - 1];
+        size_t offset = pos - cursor._offsets[cursor._depth - 1];
+        size_t count = leaf->count - std::min(n, leaf->count) + size;
+        // erases that would leave the leaf short go the slow way, so the leaf gets merged with a neighbour
+        bool fits = count <= BUFFER_LENGTH && (count >= rope_node_t::min_leaf_length || (count && size >= n));
+        if (cursor._exclusive == cursor._depth && !leaf->external && offset + n <= leaf->count && fits) {
+            rope_node_t::splice_leaf(cursor._path, cursor._depth, str, size, offset, n);
+            cursor._edits = ++_edits;
+            return;
+        }
+        rope_node_t::set_slice(_root_node, str, size, pos, n, *_node_pool);
+        changed();
+    }
+
+    void insert(cursor_t& cursor, const char *str, size_t size, size_t pos) {
+        set_slice(cursor, str, size, pos, 0);
+    }
+
+    void erase(cursor_t& cursor, size_t pos, size_t n) {
+        set_slice(cursor, nullptr, 0, pos, n);
+    }
+
+    chunks_t chunks() const {
+        return chunks(0, size());
+    }
+
+    chunks_t chunks(size_t pos, size_t n) const {
+        assert(pos <= size() && pos + n <= size());  // bounds check
+        return { _root_node, pos, pos + n };
     }
 
     std::string to_string() const {
@@ -474,24 +1560,169 @@ public:
         return str;
     }
 
+    // writes to a temp file that replaces path once everything is written, constant extra memory
+    // saving over the file the rope was mapped from is fine, the old file stays alive (unlinked) till the mapping is dropped
+    // sync waits for the data to reach the disk, false if anything failed, path is left untouched then
+    bool save(const std::filesystem::path& path, bool sync = false) const {
+        return rope_node_t::save(_root_node, path, sync);
+    }
+
     size_t size() const {
         return _root_node->count;
     }
 
-    // TODO: add insert, erase
+    // lines are separated by '\n', so there is always atleast 1 line
+    size_t line_count() const {
+        assert(_root_node->indexed);
+        return _root_node->newlines + 1;
+    }
+
+    // false for a freshly opened mapped file, newlines and summaries arent known yet
+    bool indexed() const {
+        return _root_node->indexed;
+    }
+
+    // packs the text into full leaves, edits leave partly filled leaves behind (short ones get merged, but not all of them), O(size)
+    void compact() {
+        _node_pool->collect();
+        rope_node_t::compact(_root_node, *_node_pool);
+        changed();
+    }
+
+    // text bytes / bytes allocated for the nodes of this rope, mapped leaves count towards neither, internal nodes are as big as
+    // leaves so a freshly compacted rope sits a bit under 0.5, O(nodes)
+    double fill_ratio() const {
+        size_t used = 0, allocated = 0;
+        rope_node_t::usage(_root_node, used, allocated);
+        return allocated ? double(used) / double(allocated) : 1.0;
+    }
+
+    // O(size) the first time, reads the text of the unindexed leaves (pages them in) to count the newlines and summaries
+    void build_index() {
+        _node_pool->collect();
+        rope_node_t::build_index(_root_node, *_node_pool);
+        changed();
+    }
+
+    size_t line_to_offset(size_t line) const {
+        return rope_node_t::line_to_offset(_root_node, line);
+    }
+
+    size_t offset_to_line(size_t pos) const {
+        return rope_node_t::offset_to_line(_root_node, pos);
+    }
+
+    template <typename summary_t>
+    typename summary_t::value_t summary() const {
+        return summary<summary_t>(0, size());
+    }
+
+    template <typename summary_t>
+    typename summary_t::value_t summary(size_t pos, size_t n) const {
+        return rope_node_t::template summary<summary_t>(_root_node, pos, n);
+    }
+
+    // the end of the shortest range [pos, end) whose summary pred accepts, std::string::npos if there is none, ex: the closing
+    // bracket of the one before pos is where the bracket depth of the range first goes below 0
+    // pred has to stay true as the range grows once it is, the walk skips whole subtrees it rejects, so it is O(log n) calls to
+    // pred + the bytes of the leaf the range ends in
+    template <typename summary_t, typename pred_t>
+    size_t find_summary(size_t pos, pred_t pred) const {
+        typename summary_t::value_t acc = summary_t::from_leaf(nullptr, 0);
+        return rope_node_t::template find_summary<summary_t>(_root_node, pos, acc, pred);
+    }
+
+    // the start of the shortest range [begin, pos) whose summary pred accepts, std::string::npos if there is none
+    template <typename summary_t, typename pred_t>
+    size_t rfind_summary(size_t pos, pred_t pred) const {
+        typename summary_t::value_t acc = summary_t::from_leaf(nullptr, 0);
+        return rope_node_t::template rfind_summary<summary_t>(_root_node, pos, acc, pred);
+    }
+
+    // height of the tree, a lone leaf is 1
+    size_t depth() const {
+        return _root_node->height;
+    }
+
+    // bytes taken by the nodes of this rope and every copy and snapshot sharing nodes with it
+    size_t memory_usage() const {
+        return _node_pool->memory_usage();
+    }
+
+    // true if the rope holds the text of snapshot, ex: comparing against the snapshot taken when the file was saved for the dirty
+    // indicator, O(1) with a hash summary (summary::hash_t) once indexed, without one the nodes the edits didnt touch are still
+    // shared with the snapshot and skipped, only the edited leaves are compared
+    bool equals(const snapshot_t& snapshot) const {
+        return rope_node_t::equals(_root_node, snapshot._root_node);
+    }
+
+    // the changes between 2 snapshots, ex: the last saved one and the current one for the diff gutter, applying them to a (with the
+    // text of b) gives b, see rope_node_t::diff() for the cost
+    static std::vector<change_t> diff(const snapshot_t& a, const snapshot_t& b) {
+        return rope_node_t::diff(a._root_node, b._root_node);
+    }
 
 private:
+    // every cursor walked before this has to walk again, the new shape is unique across all ropes so a cursor used with another
+    // rope never matches either
+    void changed() const {
+        _shape = _next_shape.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    rope_node_allocator_t _rope_node_allocator;
+    // moves cursor to the leaf with pos in it (the last leaf for pos == size()), climbing only as far as needed
+    void seek(cursor_t& cursor, size_t pos) const {
+        if (cursor._shape != _shape) {
+            cursor._depth = 0;
+            cursor._shape = _shape;
+            cursor._edits = _edits;
+        } else if (cursor._edits != _edits) {
+            // a cursor edit moved the text after it, the nodes on the path are the same but their offsets might not be
+            for (size_t i = 1; i < cursor._depth; i++) {
+                const rope_node_t *parent = cursor._path[i - 1];
+                cursor._offsets[i] = cursor._offsets[i - 1] + (cursor._path[i] == parent->right ? parent->left->count : 0);
+            }
+            cursor._edits = _edits;
+        }
+        while (cursor._depth > 1 && (pos < cursor._offsets[cursor._depth - 1] || pos > cursor._offsets[cursor._depth - 1] + cursor._path[cursor._depth - 1]->count)) cursor._depth--;
+        if (!cursor._depth) {
+            cursor._path[0] = _root_node;
+            cursor._offsets[0] = 0;
+            cursor._depth = 1;
+        }
+        cursor._exclusive = std::min(cursor._exclusive, cursor._depth - 1);
+        if (cursor._exclusive == cursor._depth - 1 && std::atomic_ref<size_t>(cursor._path[cursor._depth - 1]->refs).load(std::memory_order_acquire) == 1) cursor._exclusive++;
+        rope_node_t *node = cursor._path[cursor._depth - 1];
+        size_t offset = cursor._offsets[cursor._depth - 1];
+        while (!node->is_leaf()) {
+            if (pos - offset < node->left->count) {
+                node = node->left;
+            } else {
+                offset += node->left->count;
+                node = node->right;
+            }
+            assert(cursor._depth < chunk_iterator_t::max_depth);  // overflow
+            cursor._path[cursor._depth] = node;
+            cursor._offsets[cursor._depth] = offset;
+            cursor._depth++;
+            if (cursor._exclusive == cursor._depth - 1 && std::atomic_ref<size_t>(node->refs).load(std::memory_order_acquire) == 1) cursor._exclusive++;
+        }
+    }
+
+    static inline std::atomic<uint64_t> _next_shape = 1;
+
+    // ropes that share a pool (copies of each other) have to be edited from the same thread
+    std::shared_ptr<node_pool_t> _node_pool;
     rope_node_t *_root_node;
-}; 
+    mutable uint64_t _shape = _next_shape.fetch_add(1, std::memory_order_relaxed);  // changes with every edit that isnt done in place
+    uint64_t _edits = 0;  // in place cursor edits
+};
 
 } // namespace rope
 
-template <size_t BUFFER_LENGTH, template <typename type> typename allocator>
-std::ostream& operator <<(std::ostream& o, const rope::rope_t<BUFFER_LENGTH, allocator>& rope) {
-    o << rope.to_string();
+template <size_t BUFFER_LENGTH, template <typename type> typename allocator, rope::summary_c... summaries_t>
+std::ostream& operator <<(std::ostream& o, const rope::rope_t<BUFFER_LENGTH, allocator, summaries_t...>& rope) {
+    for (std::string_view chunk : rope.chunks()) o << chunk;
     return o;
 }
 
-#endif
\ No newline at end of file
+#endif
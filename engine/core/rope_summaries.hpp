@@ -0,0 +1,322 @@
+#ifndef CORE_ROPE_SUMMARIES_HPP
+#define CORE_ROPE_SUMMARIES_HPP
+
+#include "rope.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rope {
+
+// summaries to be passed to rope_t, ex: rope_t<1024, std::allocator, summary::codepoints_t, summary::words_t>
+// bytes and lines are always tracked by the rope itself (size(), line_count())
+namespace summary {
+
+// utf8 codepoints, every byte that is not a continuation byte (10xxxxxx) starts a codepoint
+struct codepoints_t {
+    using value_t = size_t;
+
+    static value_t from_leaf(const char *str, size_t n) {
+        value_t codepoints = 0;
+        for (size_t i = 0; i < n; i++) codepoints += (static_cast<unsigned char>(str[i]) & 0xc0) != 0x80;
+        return codepoints;
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        return a + b;
+    }
+};
+
+// words are runs of non whitespace chars, a word split across 2 leaves is only counted once
+struct words_t {
+    struct value_t {
+        size_t words;
+        bool empty;
+        bool starts_in_word;
+        bool ends_in_word;
+    };
+
+    static bool is_word_char(char ch) {
+        return ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r' && ch != '\v' && ch != '\f';
+    }
+
+    static value_t from_leaf(const char *str, size_t n) {
+        value_t value{ .words = 0, .empty = n == 0, .starts_in_word = n && is_word_char(str[0]), .ends_in_word = n && is_word_char(str[n - 1]) };
+        bool in_word = false;
+        for (size_t i = 0; i < n; i++) {
+            bool word_char = is_word_char(str[i]);
+            value.words += word_char && !in_word;
+            in_word = word_char;
+        }
+        return value;
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        if (a.empty) return b;
+        if (b.empty) return a;
+        return value_t{
+            .words = a.words + b.words - (a.ends_in_word && b.starts_in_word),
+            .empty = false,
+            .starts_in_word = a.starts_in_word,
+            .ends_in_word = b.ends_in_word,
+        };
+    }
+};
+
+// length in bytes of the widest line, not counting the '\n'
+struct longest_line_t {
+    struct value_t {
+        size_t length;
+        size_t prefix;   // length of the text before the first '\n' (length if there is no '\n')
+        size_t suffix;   // length of the text after the last '\n' (length if there is no '\n')
+        size_t longest;
+        bool has_newline;
+    };
+
+    static value_t from_leaf(const char *str, size_t n) {
+        value_t value{ .length = n, .prefix = n, .suffix = n, .longest = 0, .has_newline = false };
+        size_t line_start = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (str[i] != '\n') continue;
+            if (!value.has_newline) value.prefix = i;
+            value.has_newline = true;
+            value.longest = std::max(value.longest, i - line_start);
+            line_start = i + 1;
+        }
+        value.suffix = n - line_start;
+        value.longest = std::max(value.longest, value.suffix);
+        return value;
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        return value_t{
+            .length = a.length + b.length,
+            .prefix = a.has_newline ? a.prefix : a.length + b.prefix,
+            .suffix = b.has_newline ? b.suffix : a.suffix + b.length,
+            .longest = std::max({ a.longest, b.longest, a.suffix + b.prefix }),
+            .has_newline = a.has_newline || b.has_newline,
+        };
+    }
+};
+
+// depth of (), [] and {} each on its own, what rope_t::find_summary() walks to match brackets, see structure.hpp
+// a kind is matched with its own depth, so a ( closed by a ] isnt noticed, and brackets in strings and comments count too, the
+// summary only sees bytes
+struct brackets_t {
+    static constexpr size_t kinds = 3;
+    static constexpr char open[kinds] = { '(', '[', '{' };
+    static constexpr char close[kinds] = { ')', ']', '}' };
+
+    struct depth_t {
+        int32_t delta;       // opened - closed
+        int32_t min_prefix;  // lowest depth reading from the start, 0 or less
+        int32_t max_suffix;  // highest depth reading back from the end, 0 or more
+    };
+
+    using value_t = std::array<depth_t, kinds>;
+
+    // the kind of the bracket ch is, kinds if it isnt one
+    static constexpr size_t kind(char ch, bool& o_open) {
+        for (size_t k = 0; k < kinds; k++) {
+            if (ch == open[k] || ch == close[k]) {
+                o_open = ch == open[k];
+                return k;
+            }
+        }
+        return kinds;
+    }
+
+    // [kind][ch] is 1 for its opening bracket, -1 for its closing one
+    static constexpr std::array<std::array<int8_t, 256>, kinds> bracket_table() {
+        std::array<std::array<int8_t, 256>, kinds> table{};
+        for (size_t k = 0; k < kinds; k++) {
+            table[k][static_cast<unsigned char>(open[k])] = 1;
+            table[k][static_cast<unsigned char>(close[k])] = -1;
+        }
+        return table;
+    }
+
+    static value_t from_leaf(const char *str, size_t n) {
+        static constexpr std::array<std::array<int8_t, 256>, kinds> table = bracket_table();
+        int32_t delta[kinds] = {}, min_prefix[kinds] = {};
+        // all the kinds are stepped without branches, dense brackets (minified files) would mispredict on every one
+        auto step = [&](char ch) {
+            for (size_t k = 0; k < kinds; k++) {
+                delta[k] += table[k][static_cast<unsigned char>(ch)];
+                min_prefix[k] = std::min(min_prefix[k], delta[k]);
+            }
+        };
+        size_t i = 0;
+#if defined(__SSE2__)
+        // only the bytes that can be brackets are stepped, ( and ) are 0x28 and 0x29 and [ ] { } are the bytes that are 0x59 once
+        // masked with 0xd9 (so are Y _ y and 0x7f, the table ignores them)
+        const __m128i paren_mask = _mm_set1_epi8(char(0xfe)), paren = _mm_set1_epi8(0x28);
+        const __m128i bracket_mask = _mm_set1_epi8(char(0xd9)), bracket = _mm_set1_epi8(0x59);
+        for (; i + 16 <= n; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+            __m128i found = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(block, paren_mask), paren), _mm_cmpeq_epi8(_mm_and_si128(block, bracket_mask), bracket));
+            for (uint32_t mask = uint32_t(_mm_movemask_epi8(found)); mask; mask &= mask - 1) step(str[i + __builtin_ctz(mask)]);
+        }
+#endif
+        for (; i < n; i++) step(str[i]);
+        value_t value;
+        for (size_t k = 0; k < kinds; k++) value[k] = depth_t{ .delta = delta[k], .min_prefix = min_prefix[k], .max_suffix = 0 };
+        // the suffix sums are the total minus the prefix sums
+        for (size_t k = 0; k < kinds; k++) value[k].max_suffix = value[k].delta - value[k].min_prefix;
+        return value;
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        value_t value;
+        for (size_t k = 0; k < kinds; k++) {
+            value[k] = depth_t{
+                .delta = a[k].delta + b[k].delta,
+                .min_prefix = std::min(a[k].min_prefix, a[k].delta + b[k].min_prefix),
+                .max_suffix = std::max(b[k].max_suffix, b[k].delta + a[k].max_suffix),
+            };
+        }
+        return value;
+    }
+};
+
+// leading whitespace of the lines, in columns, a tab is TAB_WIDTH columns wherever it is, what folding by indentation walks,
+// see structure.hpp
+// lines with only whitespace are blank and have no indentation, a '\r' is whitespace 0 columns wide
+template <uint32_t TAB_WIDTH = 4>
+struct indentation_t {
+    static constexpr uint32_t no_indent = UINT32_MAX;
+
+    // a piece of a line
+    struct line_t {
+        uint32_t indent;  // leading whitespace, all of it if the piece is blank
+        bool blank;
+    };
+
+    struct value_t {
+        line_t head;  // the text before the first '\n', all of it if there is none
+        line_t tail;  // the text after the last '\n'
+        uint32_t min_indent;  // of the lines between the first and the last '\n' that arent blank, no_indent if there are none
+        bool has_newline;
+    };
+
+    // b continuing the line a started
+    static line_t join(const line_t& a, const line_t& b) {
+        return a.blank ? line_t{ .indent = a.indent + b.indent, .blank = b.blank } : a;
+    }
+
+    static value_t from_leaf(const char *str, size_t n) {
+        value_t value{ .head = {}, .tail = {}, .min_indent = no_indent, .has_newline = false };
+        line_t line{ .indent = 0, .blank = true };
+        for (size_t i = 0; i < n;) {
+            char ch = str[i];
+            if (ch == '\n') {
+                if (!value.has_newline) value.head = line;
+                else if (!line.blank) value.min_indent = std::min(value.min_indent, line.indent);
+                value.has_newline = true;
+                line = { .indent = 0, .blank = true };
+                i++;
+            } else if (!line.blank) {
+                // the rest of the line doesnt matter
+                const void *newline = std::memchr(str + i, '\n', n - i);
+                i = newline ? static_cast<const char *>(newline) - str : n;
+            } else {
+                if (ch == ' ') line.indent++;
+                else if (ch == '\t') line.indent += TAB_WIDTH;
+                else if (ch != '\r') line.blank = false;
+                i++;
+            }
+        }
+        if (!value.has_newline) value.head = line;
+        value.tail = line;
+        return value;
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        // the line a ends in and b starts in, a line of its own if both have newlines
+        line_t middle = join(a.tail, b.head);
+        uint32_t min_indent = std::min(a.min_indent, b.min_indent);
+        if (a.has_newline && b.has_newline && !middle.blank) min_indent = std::min(min_indent, middle.indent);
+        return value_t{
+            .head = a.has_newline ? a.head : middle,
+            .tail = b.has_newline ? b.tail : middle,
+            .min_indent = min_indent,
+            .has_newline = a.has_newline || b.has_newline,
+        };
+    }
+};
+
+// polynomial hash of the text mod 2^61 - 1 (the bytes are the digits), texts that differ collide with a chance of about
+// length / 2^61, lets rope_t::equals() and diff() skip subtrees with the same text even when they arent the same node
+// every write to a leaf rehashes the whole leaf, about a ns per byte, so a full 1024 byte leaf makes a keystroke ~1us slower
+struct hash_t {
+    struct value_t {
+        uint64_t hash;
+        uint64_t power;  // base^length, shifts the hash of the left part over the right part
+        bool operator==(const value_t&) const = default;
+    };
+
+    static constexpr uint64_t modulus = (uint64_t(1) << 61) - 1;
+    static constexpr uint64_t base = 0x1d3f6e5a9c4b7215 % modulus;
+
+    static constexpr uint64_t multiply(uint64_t a, uint64_t b) {
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        uint64_t value = (uint64_t(product) & modulus) + uint64_t(product >> 61);
+        return value >= modulus ? value - modulus : value;
+    }
+
+    static constexpr uint64_t add(uint64_t a, uint64_t b) {
+        uint64_t value = a + b;
+        return value >= modulus ? value - modulus : value;
+    }
+
+    static constexpr uint64_t power(size_t n) {
+        uint64_t result = 1, square = base;
+        for (; n; n >>= 1) {
+            if (n & 1) result = multiply(result, square);
+            square = multiply(square, square);
+        }
+        return result;
+    }
+
+    // [k][ch] is ch * base^k, so 8 bytes are hashed with table lookups and a single multiply
+    static constexpr std::array<std::array<uint64_t, 256>, 8> shifted_table() {
+        std::array<std::array<uint64_t, 256>, 8> shifted{};
+        for (size_t k = 0; k < 8; k++) {
+            for (size_t ch = 0; ch < 256; ch++) shifted[k][ch] = multiply(ch, power(k));
+        }
+        return shifted;
+    }
+
+    static value_t from_leaf(const char *str, size_t n) {
+        static constexpr std::array<std::array<uint64_t, 256>, 8> shifted = shifted_table();
+        constexpr uint64_t base8 = power(8);
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(str);
+        uint64_t hash = 0;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            // 8 values under the modulus dont overflow
+            uint64_t sum = 0;
+            for (size_t j = 0; j < 8; j++) sum += shifted[7 - j][bytes[i + j]];
+            sum = (sum & modulus) + (sum >> 61);
+            hash = add(multiply(hash, base8), sum >= modulus ? sum - modulus : sum);
+        }
+        for (; i < n; i++) hash = add(multiply(hash, base), bytes[i]);
+        return value_t{ .hash = hash, .power = power(n) };
+    }
+
+    static value_t combine(const value_t& a, const value_t& b) {
+        return value_t{ .hash = add(multiply(a.hash, b.power), b.hash), .power = multiply(a.power, b.power) };
+    }
+};
+
+} // namespace summary
+
+} // namespace rope
+
+#endif
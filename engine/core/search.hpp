@@ -0,0 +1,464 @@
+#ifndef CORE_SEARCH_HPP
+#define CORE_SEARCH_HPP
+
+#include "rope.hpp"
+#include "regex.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cassert>
+#include <optional>
+#include <string_view>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rope {
+
+struct match_t {
+    size_t pos;
+    size_t size;
+    bool operator==(const match_t&) const = default;
+};
+
+namespace utils {
+
+// crochemore perrin two way string matching, O(n + m) whatever the needle and the text, with O(1) memory past the needle
+// the needle is split at a critical factorization, the right half is compared left to right and the left half right to left, a
+// mismatch shifts by how far the right half got and a match by the period, a periodic needle remembers the part of it the last
+// shift kept matched so no byte of the text is compared more than twice
+// REVERSE searches from the end of the text for the last occurrence instead, with the needle reversed
+template <bool REVERSE>
+class two_way_t {
+public:
+    two_way_t() = default;
+
+    explicit two_way_t(std::string_view needle) {
+        if (REVERSE) _needle.assign(needle.rbegin(), needle.rend());
+        else _needle.assign(needle);
+        size_t m = _needle.size();
+        if (!m) return;
+        // the later of the maximal suffixes for the byte order and the inverted one is a critical factorization
+        size_t period, inverted_period;
+        size_t suffix = maximal_suffix(false, period), inverted_suffix = maximal_suffix(true, inverted_period);
+        if (suffix < inverted_suffix) {
+            suffix = inverted_suffix;
+            period = inverted_period;
+        }
+        _suffix = suffix;
+        _periodic = !std::memcmp(_needle.data(), _needle.data() + period, suffix);
+        _period = _periodic ? period : std::max(suffix, m - suffix) + 1;
+    }
+
+    // the needle in the order it is compared in (reversed if REVERSE)
+    const std::string& needle() const { return _needle; }
+
+    // first (last if REVERSE) occurrence in [begin, end), end if there is none
+    const char *find(const char *begin, const char *end) const {
+        size_t m = _needle.size(), n = end - begin;
+        if (n < m) return end;
+        const char *needle = _needle.data();
+        // byte i of the text in the order it is searched
+        auto at = [&](size_t i) {
+            if constexpr (REVERSE) return end[-1 - ptrdiff_t(i)];
+            else return begin[i];
+        };
+        size_t memory = 0;  // the prefix of the needle known to match at j
+        for (size_t j = 0; j <= n - m;) {
+            size_t i = std::max(_suffix, memory);
+            while (i < m && needle[i] == at(j + i)) i++;
+            if (i < m) {
+                j += i - _suffix + 1;
+                memory = 0;
+                continue;
+            }
+            i = _suffix;
+            while (i > memory && needle[i - 1] == at(j + i - 1)) i--;
+            if (i <= memory) return REVERSE ? end - j - m : begin + j;
+            j += _period;
+            if (_periodic) memory = m - _period;
+        }
+        return end;
+    }
+
+private:
+    // start of the lexicographically maximal suffix of the needle (for the inverted byte order if inverted) and its period
+    size_t maximal_suffix(bool inverted, size_t& o_period) const {
+        size_t before = ~size_t{ 0 };  // one before the start of the suffix, so the whole needle is -1
+        size_t j = 0, k = 1, p = 1;
+        while (j + k < _needle.size()) {
+            uint8_t a = _needle[j + k], b = _needle[before + k];
+            if (inverted ? b < a : a < b) {
+                j += k;
+                k = 1;
+                p = j - before;
+            } else if (a == b) {
+                if (k != p) {
+                    k++;
+                } else {
+                    j += p;
+                    k = 1;
+                }
+            } else {
+                before = j++;
+                k = p = 1;
+            }
+        }
+        o_period = p;
+        return before + 1;
+    }
+
+    std::string _needle;
+    size_t _suffix = 0;  // where the right half starts
+    size_t _period = 1;  // shift after a match
+    bool _periodic = false;
+};
+
+// budget is the bytes the filters can still memcmp, they earn one for every byte they scan and pay m for every candidate, once it
+// goes below 0 they return the candidate they stopped at (not a match)
+
+inline const char *find_literal_scalar(const char *begin, const char *end, const char *needle, size_t m, ptrdiff_t& budget) {
+    for (const char *p = begin, *last = end - m; p <= last; p++) {
+        const char *candidate = static_cast<const char *>(std::memchr(p, needle[0], last - p + 1));
+        if (!candidate) {
+            budget += last + 1 - p;
+            return end;
+        }
+        budget += candidate + 1 - p - ptrdiff_t(m);
+        p = candidate;
+        if (budget < 0) return p;
+        if (!std::memcmp(p + 1, needle + 1, m - 1)) return p;
+    }
+    return end;
+}
+
+// candidates are filtered a block at a time on the first and the last byte of the needle, only those get compared in full
+// the last block overlaps the one before it instead of falling back to a scalar loop, so short leaves stay fast too
+#define ROPE_FIND_LITERAL_BLOCKS(block_size, vector_t, set1, load, cmpeq, and_, movemask)                                      \
+    const char *last = end - m;  /* last possible start */                                                                     \
+    if (size_t(last + 1 - begin) < block_size) return find_literal_scalar(begin, end, needle, m, budget);                     \
+    vector_t first_byte = set1(needle[0]), last_byte = set1(needle[m - 1]);                                                    \
+    for (const char *p = begin; p <= last;) {                                                                                 \
+        const char *block = p;                                                                                                \
+        uint32_t skip = 0;                                                                                                    \
+        if (block + block_size > last + 1) {                                                                                  \
+            block = last + 1 - block_size;                                                                                    \
+            skip = uint32_t(p - block);                                                                                       \
+        }                                                                                                                     \
+        budget += block + block_size - p;                                                                                     \
+        vector_t first_eq = cmpeq(first_byte, load(reinterpret_cast<const vector_t *>(block)));                               \
+        vector_t last_eq = cmpeq(last_byte, load(reinterpret_cast<const vector_t *>(block + m - 1)));                        \
+        uint32_t mask = uint32_t(movemask(and_(first_eq, last_eq))) & (~uint32_t{ 0 } << skip);                               \
+        while (mask) {                                                                                                        \
+            const char *candidate = block + __builtin_ctz(mask);                                                              \
+            budget -= ptrdiff_t(m);                                                                                           \
+            if (budget < 0 || !std::memcmp(candidate + 1, needle + 1, m - 2)) return candidate;                               \
+            mask &= mask - 1;                                                                                                 \
+        }                                                                                                                     \
+        p = block + block_size;                                                                                               \
+    }                                                                                                                         \
+    return end;
+
+#if defined(__SSE2__)
+inline const char *find_literal_sse2(const char *begin, const char *end, const char *needle, size_t m, ptrdiff_t& budget) {
+    ROPE_FIND_LITERAL_BLOCKS(16, __m128i, _mm_set1_epi8, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8)
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// compiled for avx2 even if the rest of the build isnt, only called if the cpu has it
+__attribute__((target("avx2"))) inline const char *find_literal_avx2(const char *begin, const char *end, const char *needle, size_t m, ptrdiff_t& budget) {
+    ROPE_FIND_LITERAL_BLOCKS(32, __m256i, _mm256_set1_epi8, _mm256_loadu_si256, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8)
+}
+#endif
+
+#undef ROPE_FIND_LITERAL_BLOCKS
+
+// what one search needs to carry from call to call of find_literal()
+struct literal_scan_t {
+    // a few candidates head start
+    explicit literal_scan_t(size_t m) : budget(4 * ptrdiff_t(m)) {}
+    ptrdiff_t budget;
+};
+
+// first occurrence of the needle of two_way in [begin, end), end if there is none
+// the simd filter is the fast path, but on a text made mostly of the first and last bytes of the needle nearly every position is a
+// candidate and each costs a memcmp of m, so once the filter has compared more bytes than it scanned (plus a head start) two way
+// takes over till it has scanned as many back, that keeps a whole search O(n + m) however bad the text
+inline const char *find_literal(const char *begin, const char *end, const two_way_t<false>& two_way, literal_scan_t& scan) {
+    const char *needle = two_way.needle().data();
+    size_t m = two_way.needle().size();
+    if (size_t(end - begin) < m) return end;
+    if (m == 1) {
+        const void *found = std::memchr(begin, needle[0], end - begin);
+        return found ? static_cast<const char *>(found) : end;
+    }
+    if (scan.budget >= 0) {
+#if defined(__x86_64__) && defined(__GNUC__)
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        const char *p = has_avx2 ? find_literal_avx2(begin, end, needle, m, scan.budget) : find_literal_sse2(begin, end, needle, m, scan.budget);
+#elif defined(__SSE2__)
+        const char *p = find_literal_sse2(begin, end, needle, m, scan.budget);
+#else
+        const char *p = find_literal_scalar(begin, end, needle, m, scan.budget);
+#endif
+        if (scan.budget >= 0) return p;
+        begin = p;
+    }
+    const char *p = two_way.find(begin, end);
+    scan.budget += p - begin;
+    return p;
+}
+
+// text_t is a rope_t or a snapshot_t, -1 past the end
+template <typename text_t>
+int byte_at(const text_t& text, size_t pos) {
+    if (pos >= text.size()) return -1;
+    char c;
+    text.slice(pos, 1, &c);
+    return uint8_t(c);
+}
+
+} // namespace utils
+
+// substring search over a rope_t or a snapshot_t, matches can span any number of leaves and nothing is copied out of the rope
+// except the m - 1 bytes around each leaf boundary
+// O(n + m * (leaves + matches)) whatever the text, see utils::find_literal(), the matches across a leaf boundary and rfind() go
+// through two way alone
+class literal_search_t {
+public:
+    explicit literal_search_t(std::string needle) : _needle(std::move(needle)), _forward(_needle), _reverse(_needle) {}
+
+    const std::string& needle() const { return _needle; }
+
+    // calls fn(pos) with the start of every match inside [from, to) in order, overlapping ones too, till fn returns false
+    template <typename text_t, typename fn_t>
+    void for_each(const text_t& text, size_t from, size_t to, fn_t&& fn) const {
+        size_t m = _needle.size();
+        if (!m || to - from < m) return;
+        utils::literal_scan_t scan(m);
+        std::string window;  // the last m - 1 bytes of the chunks before the current one
+        std::string straddle;  // window and the first m - 1 bytes of the current chunk
+        auto chunks = text.chunks(from, to - from);
+        for (auto itr = chunks.begin(); itr != chunks.end(); ++itr) {
+            std::string_view chunk = *itr;
+            size_t offset = itr.offset();
+            // matches that start in an earlier chunk and end in this one, ones that go on past this chunk are found in a later one
+            if (!window.empty()) {
+                straddle.assign(window);
+                straddle.append(chunk.substr(0, m - 1));
+                const char *begin = straddle.data(), *end = begin + straddle.size();
+                for (const char *p = begin; (p = _forward.find(p, end)) != end && size_t(p - begin) < window.size(); p++) {
+                    if (!fn(offset - window.size() + (p - begin))) return;
+                }
+            }
+            const char *begin = chunk.data(), *end = begin + chunk.size();
+            for (const char *p = begin; (p = utils::find_literal(p, end, _forward, scan)) != end; p++) {
+                if (!fn(offset + (p - begin))) return;
+            }
+            if (chunk.size() >= m - 1) {
+                window.assign(chunk.substr(chunk.size() - (m - 1)));
+            } else {
+                window.append(chunk);
+                if (window.size() > m - 1) window.erase(0, window.size() - (m - 1));
+            }
+        }
+    }
+
+    template <typename text_t>
+    std::optional<match_t> find(const text_t& text, size_t from = 0) const {
+        std::optional<match_t> match;
+        for_each(text, from, text.size(), [&](size_t pos) {
+            match = match_t{ pos, _needle.size() };
+            return false;
+        });
+        return match;
+    }
+
+    // last match that ends at or before to
+    template <typename text_t>
+    std::optional<match_t> rfind(const text_t& text, size_t to) const {
+        size_t m = _needle.size();
+        if (!m || to < m) return std::nullopt;
+        std::string window;  // the first m - 1 bytes of the chunks after the current one
+        auto chunks = text.chunks(0, to);
+        for (auto itr = chunks.end(); itr != chunks.begin();) {
+            --itr;
+            std::string_view chunk = *itr;
+            size_t offset = itr.offset();
+            // matches that start in this chunk and end in a later one, they cant fit in the m - 1 bytes carried
+            if (!window.empty()) {
+                size_t tail = std::min(chunk.size(), m - 1);
+                window.insert(0, chunk.substr(chunk.size() - tail));
+                const char *begin = window.data(), *end = begin + window.size();
+                const char *p = _reverse.find(begin, end);
+                if (p != end) return match_t{ offset + chunk.size() - tail + (p - begin), m };
+                window.erase(0, tail);
+            }
+            const char *begin = chunk.data(), *end = begin + chunk.size();
+            const char *p = _reverse.find(begin, end);
+            if (p != end) return match_t{ offset + (p - begin), m };
+            window.insert(0, chunk.substr(0, std::min(chunk.size(), m - 1)));
+            window.resize(std::min(window.size(), m - 1));
+        }
+        return std::nullopt;
+    }
+
+    // non overlapping matches in order, atmost limit of them
+    template <typename text_t>
+    std::vector<match_t> find_all(const text_t& text, size_t limit = ~size_t{ 0 }) const {
+        std::vector<match_t> matches;
+        if (!limit) return matches;
+        size_t next = 0;
+        for_each(text, 0, text.size(), [&](size_t pos) {
+            if (pos < next) return true;
+            matches.push_back({ pos, _needle.size() });
+            next = pos + _needle.size();
+            return matches.size() < limit;
+        });
+        return matches;
+    }
+
+private:
+    std::string _needle;
+    utils::two_way_t<false> _forward;
+    utils::two_way_t<true> _reverse;
+};
+
+// regex search over a rope_t or a snapshot_t, leftmost longest, see core::regex_t for the syntax
+// the end of a match is found by running the dfa forward over the leaves, then its start by running the reversed regex backwards
+// from there, neither needs the text to be contiguous
+// not thread safe (the dfas are built lazily), every thread needs its own regex_search_t, they can share the core::regex_t
+class regex_search_t {
+public:
+    explicit regex_search_t(std::shared_ptr<const core::regex_t> regex) : _regex(regex), _forward(regex, false), _reverse(regex, true) {}
+
+    // throws std::runtime_error if the pattern is malformed
+    explicit regex_search_t(std::string_view pattern) : regex_search_t(std::make_shared<const core::regex_t>(pattern)) {}
+
+    const std::shared_ptr<const core::regex_t>& regex() const { return _regex; }
+
+    template <typename text_t>
+    std::optional<match_t> find(const text_t& text, size_t from = 0) {
+        return find(text, from, text.size());
+    }
+
+    // leftmost longest match inside [from, to)
+    template <typename text_t>
+    std::optional<match_t> find(const text_t& text, size_t from, size_t to) {
+        assert(from <= to && to <= text.size());  // bounds check
+        return find(text, from, to, to + 1);
+    }
+
+    // leftmost longest match starting inside [from, to), unlike find() it can run on past to
+    template <typename text_t>
+    std::optional<match_t> find_starting_in(const text_t& text, size_t from, size_t to) {
+        bool truncated;
+        return find_starting_in(text, from, to, text.size(), truncated);
+    }
+
+    // same but doesnt read past limit, if that wasnt enough to tell where the match ends it returns std::nullopt and sets o_truncated
+    template <typename text_t>
+    std::optional<match_t> find_starting_in(const text_t& text, size_t from, size_t to, size_t limit, bool& o_truncated) {
+        assert(from <= to && to <= limit && limit <= text.size());  // bounds check
+        o_truncated = false;
+        if (from == to) return std::nullopt;
+        return find(text, from, limit, to, &o_truncated);
+    }
+
+    // the match that ends last at or before to, it starts as early as possible
+    template <typename text_t>
+    std::optional<match_t> rfind(const text_t& text, size_t to) {
+        assert(to <= text.size());  // bounds check
+        core::dfa_t::scan_t scan = _reverse.start(false, to == text.size() || utils::byte_at(text, to) == '\n');
+        auto chunks = text.chunks(0, to);
+        for (auto itr = chunks.end(); itr != chunks.begin() && !scan.dead;) {
+            --itr;
+            std::string_view chunk = *itr;
+            _reverse.feed(scan, chunk.data(), chunk.size(), true);
+        }
+        _reverse.finish(scan, -1);
+        if (scan.last_match == core::dfa_t::npos) return std::nullopt;
+        size_t start = to - scan.last_match;
+        return match_t{ start, longest(_forward, text, start, to, false) };
+    }
+
+    // matches in order, atmost limit of them, an empty match is never reported right where the previous match ended
+    template <typename text_t>
+    std::vector<match_t> find_all(const text_t& text, size_t limit = ~size_t{ 0 }) {
+        std::vector<match_t> matches;
+        size_t from = 0;
+        while (matches.size() < limit && from <= text.size()) {
+            std::optional<match_t> match = find(text, from);
+            if (!match) break;
+            if (match->size || matches.empty() || matches.back().pos + matches.back().size != match->pos) matches.push_back(*match);
+            from = match->pos + std::max(match->size, size_t(1));
+        }
+        return matches;
+    }
+
+private:
+    // leftmost longest match inside [from, to) that starts before starts_before, o_truncated (if given) is set instead if the match
+    // could have gone on past to
+    template <typename text_t>
+    std::optional<match_t> find(const text_t& text, size_t from, size_t to, size_t starts_before, bool *o_truncated = nullptr) {
+        core::dfa_t::scan_t scan = _forward.start(false, from == 0 || utils::byte_at(text, from - 1) == '\n');
+        auto chunks = text.chunks(from, to - from);
+        for (auto itr = chunks.begin(); itr != chunks.end() && !scan.dead; ++itr) {
+            std::string_view chunk = *itr;
+            size_t offset = itr.offset();
+            if (offset < starts_before && offset + chunk.size() >= starts_before) {
+                size_t head = starts_before - offset;
+                _forward.feed(scan, chunk.data(), head);
+                _forward.stop_seeding(scan);
+                chunk.remove_prefix(head);
+            }
+            _forward.feed(scan, chunk.data(), chunk.size());
+        }
+        if (o_truncated && !scan.dead && to < text.size()) {
+            *o_truncated = true;
+            return std::nullopt;
+        }
+        _forward.finish(scan, utils::byte_at(text, to));
+        if (scan.last_match == core::dfa_t::npos) return std::nullopt;
+        size_t end = from + scan.last_match;
+        size_t size = longest(_reverse, text, from, end, true);
+        return match_t{ end - size, size };
+    }
+
+    // length of the longest anchored match of dfa in [from, to), from the start of the range or backwards from its end if reversed
+    template <typename text_t>
+    static size_t longest(core::dfa_t& dfa, const text_t& text, size_t from, size_t to, bool reversed) {
+        auto chunks = text.chunks(from, to - from);
+        core::dfa_t::scan_t scan = reversed ? dfa.start(true, to == text.size() || utils::byte_at(text, to) == '\n') : dfa.start(true, from == 0 || utils::byte_at(text, from - 1) == '\n');
+        if (reversed) {
+            for (auto itr = chunks.end(); itr != chunks.begin() && !scan.dead;) {
+                --itr;
+                std::string_view chunk = *itr;
+                dfa.feed(scan, chunk.data(), chunk.size(), true);
+            }
+            dfa.finish(scan, from ? utils::byte_at(text, from - 1) : -1);
+        } else {
+            for (std::string_view chunk : chunks) {
+                dfa.feed(scan, chunk.data(), chunk.size());
+                if (scan.dead) break;
+            }
+            dfa.finish(scan, utils::byte_at(text, to));
+        }
+        assert(scan.last_match != core::dfa_t::npos);  // only called where a match is known to exist
+        return scan.last_match;
+    }
+
+    std::shared_ptr<const core::regex_t> _regex;
+    core::dfa_t _forward;
+    core::dfa_t _reverse;
+};
+
+} // namespace rope
+
+#endif
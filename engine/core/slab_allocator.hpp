@@ -0,0 +1,105 @@
+#ifndef CORE_SLAB_ALLOCATOR_HPP
+#define CORE_SLAB_ALLOCATOR_HPP
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+
+namespace core {
+
+// fixed size block allocator, blocks are cache line aligned and carved out of big slabs
+// freed blocks go into a free list and get reused, all the slabs are freed at once by release() or the destructor
+// meant to be used as the node allocator of rope_t (rope::rope_t<1024, core::slab_allocator_t>)
+template <typename type>
+class slab_allocator_t {
+public:
+    using value_type = type;
+
+    static constexpr size_t cache_line_size = 64;
+    static constexpr size_t block_alignment = std::max(cache_line_size, alignof(type));
+    static constexpr size_t block_size = (sizeof(type) + block_alignment - 1) / block_alignment * block_alignment;
+    static constexpr size_t min_slab_blocks = 16;
+    static constexpr size_t max_slab_size = size_t(1) << 20;  // slabs grow geometrically upto this
+
+    slab_allocator_t() = default;
+    ~slab_allocator_t() { release(); }
+
+    // blocks are owned by the allocator, copying it would free them twice
+    slab_allocator_t(const slab_allocator_t&) = delete;
+    slab_allocator_t& operator=(const slab_allocator_t&) = delete;
+
+    type *allocate(size_t n) {
+        if (n != 1) return static_cast<type *>(::operator new(n * sizeof(type), std::align_val_t{ block_alignment }));
+        _allocated_blocks++;
+        if (_free_list) {
+            free_block_t *block = _free_list;
+            _free_list = block->next;
+            return reinterpret_cast<type *>(block);
+        }
+        if (_bump == _bump_end) new_slab();
+        type *block = reinterpret_cast<type *>(_bump);
+        _bump += block_size;
+        return block;
+    }
+
+    void deallocate(type *ptr, size_t n) {
+        if (n != 1) {
+            ::operator delete(ptr, std::align_val_t{ block_alignment });
+            return;
+        }
+        assert(_allocated_blocks);
+        _allocated_blocks--;
+        free_block_t *block = reinterpret_cast<free_block_t *>(ptr);
+        block->next = _free_list;
+        _free_list = block;
+    }
+
+    // frees every slab, every block handed out becomes invalid
+    void release() {
+        for (auto& slab : _slabs) ::operator delete(slab.data, std::align_val_t{ block_alignment });
+        _slabs.clear();
+        _free_list = nullptr;
+        _bump = _bump_end = nullptr;
+        _allocated_blocks = 0;
+    }
+
+    size_t allocated_blocks() const { return _allocated_blocks; }
+
+    size_t reserved_bytes() const {
+        size_t bytes = 0;
+        for (auto& slab : _slabs) bytes += slab.size;
+        return bytes;
+    }
+
+private:
+    struct free_block_t {
+        free_block_t *next;
+    };
+    static_assert(block_size >= sizeof(free_block_t));
+
+    struct slab_t {
+        std::byte *data;
+        size_t size;
+    };
+
+    void new_slab() {
+        size_t blocks = _slabs.empty() ? min_slab_blocks : std::max(size_t(1), std::min(_slabs.back().size * 2, max_slab_size) / block_size);
+        size_t size = blocks * block_size;
+        std::byte *data = static_cast<std::byte *>(::operator new(size, std::align_val_t{ block_alignment }));
+        _slabs.push_back({ data, size });
+        _bump = data;
+        _bump_end = data + size;
+    }
+
+    std::vector<slab_t> _slabs;
+    free_block_t *_free_list = nullptr;
+    std::byte *_bump = nullptr;
+    std::byte *_bump_end = nullptr;
+    size_t _allocated_blocks = 0;
+};
+
+} // namespace core
+
+#endif
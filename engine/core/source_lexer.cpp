@@ -0,0 +1,134 @@
+#include "source_lexer.hpp"
+
+#include <utility>
+#include <algorithm>
+
+namespace rope {
+
+source_lexer_t::language_t source_lexer_t::language_t::cpp() {
+    language_t language;
+    language.keywords = {
+        "alignas", "alignof", "auto", "break", "case", "catch", "class", "concept", "const", "consteval", "constexpr", "constinit",
+        "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do", "else", "enum", "explicit", "export",
+        "extern", "false", "for", "friend", "goto", "if", "inline", "mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+        "private", "protected", "public", "requires", "return", "sizeof", "static", "static_assert", "static_cast", "struct", "switch",
+        "template", "this", "throw", "true", "try", "typedef", "typename", "union", "using", "virtual", "volatile", "while",
+    };
+    language.types = {
+        "bool", "char", "char8_t", "char16_t", "char32_t", "double", "float", "int", "int8_t", "int16_t", "int32_t", "int64_t", "long",
+        "ptrdiff_t", "short", "signed", "size_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "unsigned", "void", "wchar_t",
+    };
+    language.line_comments = { "//" };
+    language.block_comment_begin = "/*";
+    language.block_comment_end = "*/";
+    language.quotes = "\"'";
+    language.preprocessor = true;
+    return language;
+}
+
+source_lexer_t::language_t source_lexer_t::language_t::config() {
+    language_t language;
+    language.keywords = { "false", "no", "off", "on", "true", "yes" };
+    language.line_comments = { "#", ";" };
+    language.quotes = "\"'";
+    return language;
+}
+
+source_lexer_t::source_lexer_t(language_t language) : _language(std::move(language)) {
+    std::sort(_language.keywords.begin(), _language.keywords.end());
+    std::sort(_language.types.begin(), _language.types.end());
+}
+
+source_lexer_t::state_t source_lexer_t::lex_line(state_t state, std::string_view line, std::vector<token_span_t>& o_spans) const {
+    const std::string_view block_begin = _language.block_comment_begin, block_end = _language.block_comment_end;
+    size_t i = 0;
+    // the comment left open by the lines before
+    if (state == state_t::block_comment) {
+        size_t end = line.find(block_end);
+        if (end == std::string_view::npos) {
+            if (!line.empty()) o_spans.push_back({ 0, line.size(), token_t::comment });
+            return state_t::block_comment;
+        }
+        i = end + block_end.size();
+        o_spans.push_back({ 0, i, token_t::comment });
+    }
+    bool line_start = !i;  // only whitespace so far
+    while (i < line.size()) {
+        char ch = line[i];
+        if (ch == ' ' || ch == '\t' || ch == '\r') {
+            i++;
+            continue;
+        }
+        size_t begin = i;
+        if (starts_line_comment(line.substr(i))) {
+            o_spans.push_back({ begin, line.size() - begin, token_t::comment });
+            return state_t::normal;
+        }
+        if (starts_block_comment(line.substr(i))) {
+            size_t end = line.find(block_end, i + block_begin.size());
+            if (end == std::string_view::npos) {
+                o_spans.push_back({ begin, line.size() - begin, token_t::comment });
+                return state_t::block_comment;
+            }
+            i = end + block_end.size();
+            o_spans.push_back({ begin, i - begin, token_t::comment });
+        } else if (_language.quotes.find(ch) != std::string::npos) {
+            // unterminated strings end with the line
+            for (i++; i < line.size() && line[i] != ch; i++) {
+                if (line[i] == '\\') i++;
+            }
+            i = std::min(i + 1, line.size());
+            o_spans.push_back({ begin, i - begin, token_t::string });
+        } else if (is_digit(ch) || (ch == '.' && i + 1 < line.size() && is_digit(line[i + 1]))) {
+            // hex, exponents, suffixes and digit separators, ex: 0x1fu, 1.5e-3f, 1'000
+            for (i++; i < line.size(); i++) {
+                if (is_ident(line[i]) || line[i] == '.' || line[i] == '\'') continue;
+                if ((line[i] == '-' || line[i] == '+') && (line[i - 1] == 'e' || line[i - 1] == 'E' || line[i - 1] == 'p' || line[i - 1] == 'P')) continue;
+                break;
+            }
+            o_spans.push_back({ begin, i - begin, token_t::number });
+        } else if (is_ident_start(ch)) {
+            while (i < line.size() && is_ident(line[i])) i++;
+            std::string_view word = line.substr(begin, i - begin);
+            if (contains(_language.keywords, word)) o_spans.push_back({ begin, i - begin, token_t::keyword });
+            else if (contains(_language.types, word)) o_spans.push_back({ begin, i - begin, token_t::type });
+        } else if (ch == '#' && line_start && _language.preprocessor) {
+            for (i++; i < line.size() && (line[i] == ' ' || line[i] == '\t'); i++);
+            while (i < line.size() && is_ident(line[i])) i++;
+            o_spans.push_back({ begin, i - begin, token_t::preprocessor });
+        } else if (is_symbol(ch)) {
+            // a run of them is one span, up to a comment
+            for (i++; i < line.size() && is_symbol(line[i]) && !starts_line_comment(line.substr(i)) && !starts_block_comment(line.substr(i)); i++);
+            o_spans.push_back({ begin, i - begin, token_t::symbol });
+        } else {
+            i++;
+        }
+        line_start = false;
+    }
+    return state_t::normal;
+}
+
+bool source_lexer_t::starts_line_comment(std::string_view str) const {
+    return std::any_of(_language.line_comments.begin(), _language.line_comments.end(), [&](const std::string& comment) { return str.starts_with(comment); });
+}
+
+bool source_lexer_t::starts_block_comment(std::string_view str) const {
+    return !_language.block_comment_begin.empty() && str.starts_with(_language.block_comment_begin);
+}
+
+bool source_lexer_t::is_symbol(char ch) {
+    switch (ch) {
+        case '+': case '-': case '*': case '/': case '%': case '=': case '<': case '>': case '!': case '&': case '|': case '^': case '~':
+        case '?': case ':':
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool source_lexer_t::contains(const std::vector<std::string>& sorted, std::string_view word) {
+    auto itr = std::lower_bound(sorted.begin(), sorted.end(), word, [](const std::string& a, std::string_view b) { return std::string_view(a) < b; });
+    return itr != sorted.end() && *itr == word;
+}
+
+} // namespace rope
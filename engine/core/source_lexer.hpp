@@ -0,0 +1,57 @@
+#ifndef CORE_SOURCE_LEXER_HPP
+#define CORE_SOURCE_LEXER_HPP
+
+#include "highlighter.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+namespace rope {
+
+// hand written lexer for c like source and config files, keywords, comments, strings and numbers, for highlighter_t
+// the only thing carried from one line to the next is an unterminated block comment
+class source_lexer_t {
+public:
+    enum class state_t : uint8_t {
+        normal,
+        block_comment,
+    };
+
+    struct language_t {
+        std::vector<std::string> keywords;
+        std::vector<std::string> types;
+        std::vector<std::string> line_comments;  // ex: "//", "#"
+        std::string block_comment_begin, block_comment_end;  // empty if there are none
+        std::string quotes;  // the chars that start (and end) a string
+        bool preprocessor = false;  // '#' first on a line starts a directive
+
+        static language_t cpp();
+        // ini, toml, .conf
+        static language_t config();
+    };
+
+    source_lexer_t() : source_lexer_t(language_t::cpp()) {}
+    explicit source_lexer_t(language_t language);
+
+    state_t lex_line(state_t state, std::string_view line, std::vector<token_span_t>& o_spans) const;
+
+    const language_t& language() const { return _language; }
+
+private:
+    static bool is_ident_start(char ch) { return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_'; }
+    static bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+    static bool is_ident(char ch) { return is_ident_start(ch) || is_digit(ch); }
+
+    bool starts_line_comment(std::string_view str) const;
+    bool starts_block_comment(std::string_view str) const;
+    static bool is_symbol(char ch);
+    static bool contains(const std::vector<std::string>& sorted, std::string_view word);
+
+    language_t _language;  // keywords and types sorted
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef CORE_STRUCTURE_HPP
+#define CORE_STRUCTURE_HPP
+
+#include "rope_summaries.hpp"
+
+#include <string>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+
+namespace rope {
+
+// bracket matching and folding by indentation, answered from the summaries the rope keeps per node instead of scanning out from
+// the cursor, so they are O(log n) (+ the leaves the answer is in) however far the other end is and however deep the nesting
+// text_t is a rope_t or its snapshot_t, indexed, with summary::brackets_t (for the bracket queries) or summary::indentation_t (for
+// the fold ones) in its summaries, the rope keeps them up to date on every edit so nothing here has to be told about edits
+
+// offsets of a bracket and the one closing it
+struct bracket_pair_t {
+    size_t open;
+    size_t close;
+    bool operator==(const bracket_pair_t&) const = default;
+};
+
+// line stays visible, the lines after it up to last_line are hidden
+struct fold_t {
+    size_t line;
+    size_t last_line;
+    bool operator==(const fold_t&) const = default;
+};
+
+// the offset of the bracket pairing with the one at pos, std::nullopt if there is no bracket at pos or it isnt closed (opened)
+template <typename text_t>
+std::optional<size_t> match_bracket(const text_t& text, size_t pos) {
+    using brackets_t = summary::brackets_t;
+    assert(pos < text.size());  // bounds check
+    char ch;
+    text.slice(pos, 1, &ch);
+    bool opening;
+    size_t k = brackets_t::kind(ch, opening);
+    if (k == brackets_t::kinds) return std::nullopt;
+    size_t match = opening
+        ? text.template find_summary<brackets_t>(pos + 1, [k](const brackets_t::value_t& value) { return value[k].min_prefix < 0; })
+        : text.template rfind_summary<brackets_t>(pos, [k](const brackets_t::value_t& value) { return value[k].max_suffix > 0; });
+    if (match == std::string::npos) return std::nullopt;
+    return opening ? match - 1 : match;
+}
+
+// the innermost pair of brackets around pos (pos after the opening one and not after the closing one), of any kind
+template <typename text_t>
+std::optional<bracket_pair_t> enclosing_brackets(const text_t& text, size_t pos) {
+    using brackets_t = summary::brackets_t;
+    assert(pos <= text.size());  // bounds check
+    std::optional<bracket_pair_t> pair;
+    for (size_t k = 0; k < brackets_t::kinds; k++) {
+        size_t open = text.template rfind_summary<brackets_t>(pos, [k](const brackets_t::value_t& value) { return value[k].max_suffix > 0; });
+        if (open == std::string::npos || (pair && pair->open > open)) continue;
+        size_t end = text.template find_summary<brackets_t>(pos, [k](const brackets_t::value_t& value) { return value[k].min_prefix < 0; });
+        if (end != std::string::npos) pair = bracket_pair_t{ open, end - 1 };
+    }
+    return pair;
+}
+
+// the leading whitespace of line in columns, std::nullopt if the line is blank
+template <typename indentation_summary_t = summary::indentation_t<>, typename text_t>
+std::optional<uint32_t> line_indent(const text_t& text, size_t line) {
+    assert(line < text.line_count());  // bounds check
+    size_t begin = text.line_to_offset(line);
+    size_t end = line + 1 < text.line_count() ? text.line_to_offset(line + 1) - 1 : text.size();
+    typename indentation_summary_t::value_t value = text.template summary<indentation_summary_t>(begin, end - begin);
+    if (value.head.blank) return std::nullopt;
+    return value.head.indent;
+}
+
+// the lines after line that are indented deeper than it, up to the first one that isnt, blank lines in between are part of the
+// fold but blank lines at its end arent, std::nullopt if the next line that isnt blank isnt indented deeper
+template <typename indentation_summary_t = summary::indentation_t<>, typename text_t>
+std::optional<fold_t> fold_region(const text_t& text, size_t line) {
+    using value_t = typename indentation_summary_t::value_t;
+    size_t line_count = text.line_count();
+    assert(line < line_count);  // bounds check
+    std::optional<uint32_t> indent = line_indent<indentation_summary_t>(text, line);
+    if (!indent || line + 1 == line_count) return std::nullopt;
+    // the first line after it that isnt blank or indented deeper, found when the walk reaches the '\n' ending it
+    size_t end = text.template find_summary<indentation_summary_t>(text.line_to_offset(line + 1), [limit = *indent](const value_t& value) {
+        return value.has_newline && ((!value.head.blank && value.head.indent <= limit) || value.min_indent <= limit);
+    });
+    size_t next;
+    if (end != std::string::npos) {
+        next = text.offset_to_line(end - 1);
+    } else {
+        // the last line has no '\n' to end it
+        next = line_count - 1;
+        std::optional<uint32_t> last_indent = line_indent<indentation_summary_t>(text, next);
+        if (!last_indent || *last_indent > *indent) next = line_count;
+    }
+    size_t last_line = next - 1;
+    while (last_line > line && !line_indent<indentation_summary_t>(text, last_line)) last_line--;
+    if (last_line == line) return std::nullopt;
+    return fold_t{ line, last_line };
+}
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef CORE_TEXT_BUFFER_HPP
+#define CORE_TEXT_BUFFER_HPP
+
+#include "rope.hpp"
+#include "gap_buffer.hpp"
+#include "piece_table.hpp"
+#include "text_storage.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <variant>
+#include <cassert>
+#include <iterator>
+#include <string_view>
+
+namespace rope {
+
+// the text of an open file, stored in whichever of gap_buffer_t, piece_table_t and rope_t suits it
+// small files get a gap buffer, mapped files a piece table (opening is O(1) and the original is never copied), the rest a rope
+// the edits are watched and the text moves to a rope once the pick stops paying off: a gap buffer that grew big or keeps moving
+// its gap far, or a piece table with too many pieces, it never moves back
+class text_buffer_t {
+public:
+    using rope_type = rope_t<1024>;
+
+    enum class backend_t {
+        gap_buffer,
+        piece_table,
+        rope,
+    };
+
+    static constexpr size_t small_file_size = size_t(256) << 10;
+    static constexpr size_t max_gap_buffer_size = size_t(4) << 20;
+    // averaged over edit_window edits, more than this means the edits jump around a file too big for memmoving it around
+    static constexpr size_t max_moved_per_edit = size_t(16) << 10;
+    static constexpr size_t edit_window = 1024;
+    // piece table edits are O(pieces)
+    static constexpr size_t max_pieces = size_t(16) << 10;
+
+    // chunks of whichever backend is in use
+    class chunk_iterator_t {
+    public:
+        using value_type = std::string_view;
+        using reference = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+
+        chunk_iterator_t() = default;
+        template <typename itr_t>
+        chunk_iterator_t(itr_t itr) : _itr(std::move(itr)) {}
+
+        std::string_view operator*() const { return std::visit([](const auto& itr) { return std::string_view(*itr); }, _itr); }
+        size_t offset() const { return std::visit([](const auto& itr) { return itr.offset(); }, _itr); }
+
+        chunk_iterator_t& operator++() {
+            std::visit([](auto& itr) { ++itr; }, _itr);
+            return *this;
+        }
+
+        chunk_iterator_t operator++(int) {
+            chunk_iterator_t itr = *this;
+            ++*this;
+            return itr;
+        }
+
+        chunk_iterator_t& operator--() {
+            std::visit([](auto& itr) { --itr; }, _itr);
+            return *this;
+        }
+
+        chunk_iterator_t operator--(int) {
+            chunk_iterator_t itr = *this;
+            --*this;
+            return itr;
+        }
+
+        bool operator==(const chunk_iterator_t& other) const { return _itr == other._itr; }
+
+    private:
+        std::variant<rope_type::chunk_iterator_t, segment_iterator_t<gap_buffer_t>, segment_iterator_t<piece_table_t>> _itr;
+    };
+
+    class chunks_t : public std::ranges::view_interface<chunks_t> {
+    public:
+        chunks_t() = default;
+        template <typename chunks_type>
+        chunks_t(const chunks_type& chunks) : _begin(chunks.begin()), _end(chunks.end()) {}
+
+        chunk_iterator_t begin() const { return _begin; }
+        chunk_iterator_t end() const { return _end; }
+
+    private:
+        chunk_iterator_t _begin, _end;
+    };
+
+    explicit text_buffer_t(std::string_view str) : _storage(pick(str)) {}
+
+    explicit text_buffer_t(std::shared_ptr<const core::mapped_file_t> mapped_file) : _storage(pick(std::move(mapped_file))) {}
+
+    void slice(size_t pos, size_t n, char *o_str) const {
+        std::visit([&](const auto& storage) { storage.slice(pos, n, o_str); }, _storage);
+    }
+
+    void set_slice(const char *str, size_t size, size_t pos, size_t n) {
+        std::visit([&](auto& storage) { storage.set_slice(str, size, pos, n); }, _storage);
+        edited();
+    }
+
+    void insert(const char *str, size_t size, size_t pos) {
+        set_slice(str, size, pos, 0);
+    }
+
+    void erase(size_t pos, size_t n) {
+        set_slice(nullptr, 0, pos, n);
+    }
+
+    chunks_t chunks() const {
+        return chunks(0, size());
+    }
+
+    chunks_t chunks(size_t pos, size_t n) const {
+        return std::visit([&](const auto& storage) { return chunks_t(storage.chunks(pos, n)); }, _storage);
+    }
+
+    std::string to_string() const {
+        return std::visit([](const auto& storage) { return storage.to_string(); }, _storage);
+    }
+
+    size_t size() const {
+        return std::visit([](const auto& storage) { return storage.size(); }, _storage);
+    }
+
+    size_t memory_usage() const {
+        return std::visit([](const auto& storage) { return storage.memory_usage(); }, _storage);
+    }
+
+    backend_t backend() const {
+        return backend_t(_storage.index());
+    }
+
+private:
+    using storage_t = std::variant<gap_buffer_t, piece_table_t, rope_type>;
+
+    static storage_t pick(std::string_view str) {
+        if (str.size() <= small_file_size) return storage_t(std::in_place_type<gap_buffer_t>, str);
+        return storage_t(std::in_place_type<rope_type>, std::string(str));
+    }
+
+    static storage_t pick(std::shared_ptr<const core::mapped_file_t> mapped_file) {
+        if (mapped_file->size() <= small_file_size) return storage_t(std::in_place_type<gap_buffer_t>, std::string_view(mapped_file->data(), mapped_file->size()));
+        return storage_t(std::in_place_type<piece_table_t>, std::move(mapped_file));
+    }
+
+    void edited() {
+        _edits++;
+        if (gap_buffer_t *gap_buffer = std::get_if<gap_buffer_t>(&_storage)) {
+            bool jumpy = false;
+            if (_edits % edit_window == 0) {
+                jumpy = gap_buffer->moved() - _moved > max_moved_per_edit * edit_window;
+                _moved = gap_buffer->moved();
+            }
+            if (jumpy || gap_buffer->size() > max_gap_buffer_size) _storage = storage_t(std::in_place_type<rope_type>, gap_buffer->to_string());
+        } else if (piece_table_t *piece_table = std::get_if<piece_table_t>(&_storage)) {
+            if (piece_table->piece_count() > max_pieces) _storage = storage_t(std::in_place_type<rope_type>, to_rope(*piece_table));
+        }
+    }
+
+    // the original pieces are in order, so the piece table is the original with a sorted list of edits applied to it, a rope over
+    // the original (still mapped if it was) takes them as one rope_t::apply()
+    static rope_type to_rope(const piece_table_t& piece_table) {
+        std::string_view original = piece_table.original();
+        rope_type rope = piece_table.mapped_file() ? rope_type{ piece_table.mapped_file() } : rope_type{ std::string(original) };
+        std::vector<rope_type::edit_t> edits;
+        size_t pos = 0;  // in the original
+        for (std::string_view piece : piece_table.chunks()) {
+            if (!piece_table.is_original(piece)) {
+                edits.push_back({ pos, 0, piece });
+                continue;
+            }
+            size_t offset = size_t(piece.data() - original.data());
+            if (offset > pos) edits.push_back({ pos, offset - pos, {} });
+            pos = offset + piece.size();
+        }
+        if (pos < original.size()) edits.push_back({ pos, original.size() - pos, {} });
+        rope.apply(edits);
+        return rope;
+    }
+
+    storage_t _storage;
+    size_t _edits = 0;
+    size_t _moved = 0;  // gap_buffer_t::moved() at the start of the window
+};
+
+static_assert(text_storage_c<gap_buffer_t>);
+static_assert(text_storage_c<piece_table_t>);
+static_assert(text_storage_c<text_buffer_t::rope_type>);
+static_assert(text_storage_c<text_buffer_t>);
+
+} // namespace rope
+
+#endif
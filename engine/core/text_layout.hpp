@@ -0,0 +1,130 @@
+#ifndef CORE_TEXT_LAYOUT_HPP
+#define CORE_TEXT_LAYOUT_HPP
+
+#include <string>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+
+namespace rope {
+
+// the part of a text that is on screen, in pixels, the document starts at 0, 0 and y grows down
+struct viewport_t {
+    float scroll_x = 0, scroll_y = 0;
+    float width = 0, height = 0;
+    float line_height = 1;
+    uint32_t tab_width = 4;  // in spaces
+};
+
+// glyphs of one line drawn one after the other from x, y is the top of the line, both relative to the top left of the viewport
+struct glyph_run_t {
+    size_t line;
+    float x, y;
+    std::string_view glyphs;
+};
+
+// what a layout looked at
+struct layout_stats_t {
+    size_t first_line = 0;
+    size_t lines = 0;
+    size_t bytes = 0;  // read from the text
+    size_t glyphs = 0;
+};
+
+// lays out the lines of text (a rope_t or a snapshot_t, indexed) that are inside viewport, one line a glyph per byte
+// the first visible line is found through the line index of the rope, from there the chunks are walked once down to the last
+// visible line, and the part of a line past the right edge is skipped to the next '\n' in the chunk, or through the line index if
+// the line goes on past the chunk, so the cost is the same for a 10 line file and a 10m line one, it only grows with the viewport
+// and with scroll_x (the start of a line scrolled out on the left is still read to know where the rest goes)
+// advance(ch) is the width of the glyph of ch, 0 if the font has none, then it is drawn as '?', tabs go to the next tab stop as
+// spaces, '\r' and utf8 continuation bytes take no space and other bytes outside of ascii are drawn as '?'
+// emit(const glyph_run_t&) is called with the visible glyphs of every line that has any, the run is only valid during the call
+template <typename text_t, typename advance_fn_t, typename emit_fn_t>
+layout_stats_t layout_visible_lines(const text_t& text, const viewport_t& viewport, advance_fn_t&& advance, emit_fn_t&& emit) {
+    assert(viewport.line_height > 0 && viewport.tab_width > 0);
+    layout_stats_t stats;
+    size_t line_count = text.line_count();
+    stats.first_line = std::min(line_count, size_t(std::max(0.f, viewport.scroll_y) / viewport.line_height));
+    if (stats.first_line == line_count) return stats;
+    const float space = advance(' '), unknown = advance('?');
+
+    decltype(text.chunks(0, 0)) chunks;
+    decltype(chunks.begin()) itr;
+    std::string_view chunk;  // the part of *itr not read yet
+    auto seek = [&](size_t pos) {
+        chunks = text.chunks(pos, text.size() - pos);
+        itr = chunks.begin();
+        chunk = itr != chunks.end() ? *itr : std::string_view{};
+    };
+    seek(text.line_to_offset(stats.first_line));
+
+    std::string glyphs;  // of the line being laid out, reused
+    float y = float(stats.first_line) * viewport.line_height - viewport.scroll_y;
+    for (size_t line = stats.first_line; line < line_count && y < viewport.height; line++, y += viewport.line_height) {
+        glyphs.clear();
+        float x = -viewport.scroll_x, run_x = 0;
+        size_t column = 0;
+        bool past_right = false;
+        // x is where the next glyph goes, it is only added once it reaches into the viewport
+        auto add = [&](char glyph, float width) {
+            if (x >= viewport.width) {
+                past_right = true;
+                return;
+            }
+            if (x + width > 0) {
+                if (glyphs.empty()) run_x = x;
+                glyphs += glyph;
+            }
+            x += width;
+            column++;
+        };
+        while (true) {
+            if (chunk.empty()) {
+                if (itr == chunks.end() || ++itr == chunks.end()) break;
+                chunk = *itr;
+            }
+            if (past_right) {
+                // nothing else of the line is visible
+                size_t newline = chunk.find('\n');
+                if (newline != std::string_view::npos) {
+                    stats.bytes += newline + 1;
+                    chunk.remove_prefix(newline + 1);
+                } else if (line + 1 < line_count) {
+                    seek(text.line_to_offset(line + 1));
+                } else {
+                    // the last line, nothing is read after it
+                    itr = chunks.end();
+                    chunk = {};
+                }
+                break;
+            }
+            unsigned char ch = static_cast<unsigned char>(chunk.front());
+            chunk.remove_prefix(1);
+            stats.bytes++;
+            if (ch == '\n') {
+                break;
+            } else if (ch == '\t') {
+                for (size_t spaces = viewport.tab_width - column % viewport.tab_width; spaces-- && !past_right;) add(' ', space);
+            } else if (ch == '\r' || (ch & 0xc0) == 0x80) {
+                continue;
+            } else if (ch >= 0x80) {
+                add('?', unknown);
+            } else {
+                float width = advance(char(ch));
+                if (width > 0) add(char(ch), width);
+                else add('?', unknown);
+            }
+        }
+        stats.lines++;
+        if (!glyphs.empty()) {
+            stats.glyphs += glyphs.size();
+            emit(glyph_run_t{ line, run_x, y, glyphs });
+        }
+    }
+    return stats;
+}
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef CORE_TEXT_STORAGE_HPP
+#define CORE_TEXT_STORAGE_HPP
+
+#include <string>
+#include <cstddef>
+#include <cassert>
+#include <concepts>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace rope {
+
+// what rope_t, btree_rope_t, gap_buffer_t, piece_table_t and text_buffer_t have in common, the searches and the undo free parts of
+// the editor only use this
+// chunks(pos, n) walks [pos, pos + n) as string_views into the storage, its iterators are bidirectional and know the offset() of the
+// chunk they are at, any edit invalidates them
+template <typename text_t>
+concept text_storage_c = requires(text_t& text, const text_t& const_text, const char *str, char *o_str, size_t n) {
+    { const_text.size() } -> std::same_as<size_t>;
+    { const_text.slice(n, n, o_str) };
+    { text.set_slice(str, n, n, n) };
+    { text.insert(str, n, n) };
+    { text.erase(n, n) };
+    { const_text.to_string() } -> std::same_as<std::string>;
+    { const_text.memory_usage() } -> std::same_as<size_t>;
+    { *const_text.chunks(n, n).begin() } -> std::convertible_to<std::string_view>;
+    { const_text.chunks(n, n).begin().offset() } -> std::same_as<size_t>;
+};
+
+// chunk iterator for storages that are a short list of contiguous segments (a gap buffer has 2, a piece table one per piece)
+// segments_t has segment_count(), segment(i) (a string_view, never empty), segment_start(i) and find_segment(pos), the segment
+// with pos in it
+template <typename segments_t>
+class segment_iterator_t {
+public:
+    using value_type = std::string_view;
+    using reference = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    segment_iterator_t() = default;
+
+    // pos == end is the end iterator
+    segment_iterator_t(const segments_t *segments, size_t begin, size_t end, size_t pos) : _segments(segments), _begin(begin), _end(end) {
+        if (pos < end) _index = segments->find_segment(pos);
+    }
+
+    std::string_view operator*() const {
+        std::string_view segment = _segments->segment(_index);
+        size_t start = _segments->segment_start(_index);
+        size_t from = std::max(_begin, start), to = std::min(_end, start + segment.size());
+        return segment.substr(from - start, to - from);
+    }
+
+    size_t offset() const {
+        return std::max(_begin, _segments->segment_start(_index));
+    }
+
+    segment_iterator_t& operator++() {
+        assert(_index != npos);  // cant go past the end
+        if (_segments->segment_start(_index) + _segments->segment(_index).size() >= _end) _index = npos;
+        else _index++;
+        return *this;
+    }
+
+    segment_iterator_t operator++(int) {
+        segment_iterator_t itr = *this;
+        ++*this;
+        return itr;
+    }
+
+    segment_iterator_t& operator--() {
+        if (_index == npos) {
+            assert(_begin < _end);  // cant go before the begining
+            _index = _segments->find_segment(_end - 1);
+        } else {
+            assert(_segments->segment_start(_index) > _begin);  // cant go before the begining
+            _index--;
+        }
+        return *this;
+    }
+
+    segment_iterator_t operator--(int) {
+        segment_iterator_t itr = *this;
+        --*this;
+        return itr;
+    }
+
+    bool operator==(const segment_iterator_t& other) const {
+        return _index == other._index;
+    }
+
+private:
+    static constexpr size_t npos = ~size_t{ 0 };
+
+    const segments_t *_segments = nullptr;
+    size_t _begin = 0, _end = 0;
+    size_t _index = npos;  // npos is the end iterator
+};
+
+template <typename segments_t>
+class segments_view_t {
+public:
+    segments_view_t() = default;
+    segments_view_t(const segments_t *segments, size_t begin, size_t end) : _segments(segments), _begin(begin), _end(end) {}
+
+    segment_iterator_t<segments_t> begin() const { return { _segments, _begin, _end, _begin }; }
+    segment_iterator_t<segments_t> end() const { return { _segments, _begin, _end, _end }; }
+
+private:
+    const segments_t *_segments = nullptr;
+    size_t _begin = 0, _end = 0;
+};
+
+} // namespace rope
+
+#endif
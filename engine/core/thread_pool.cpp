@@ -0,0 +1,44 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace core {
+
+thread_pool_t::thread_pool_t(size_t thread_count) {
+    if (!thread_count) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    _threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) _threads.emplace_back([this] { run(); });
+}
+
+thread_pool_t::~thread_pool_t() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _condition.notify_all();
+    for (std::thread& thread : _threads) thread.join();
+}
+
+void thread_pool_t::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void thread_pool_t::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+            if (_tasks.empty()) return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace core
@@ -0,0 +1,41 @@
+#ifndef CORE_THREAD_POOL_HPP
+#define CORE_THREAD_POOL_HPP
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace core {
+
+// fixed set of worker threads running tasks in the order they were submitted
+// tasks cant be taken back once submitted, long running ones should check a cancellation flag of their own
+class thread_pool_t {
+public:
+    // 0 picks one thread per core
+    explicit thread_pool_t(size_t thread_count = 0);
+    // waits for every task submitted, cancel long running ones first
+    ~thread_pool_t();
+
+    thread_pool_t(const thread_pool_t&) = delete;
+    thread_pool_t& operator=(const thread_pool_t&) = delete;
+
+    void submit(std::function<void()> task);
+
+    size_t thread_count() const { return _threads.size(); }
+
+private:
+    void run();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _stopping = false;
+};
+
+} // namespace core
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef CORE_UNDO_TREE_HPP
+#define CORE_UNDO_TREE_HPP
+
+#include "rope.hpp"
+
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cassert>
+
+namespace rope {
+
+// history of a rope as a tree of snapshots, undoing and then editing starts a new branch instead of throwing the redo away
+// every version is a rope snapshot, so undo, redo and jumping to any version are O(1) and versions share all unchanged nodes
+// consecutive typing (or backspacing) is coalesced into a single version
+// versions are pruned (oldest dead branches first, then the oldest history) once the estimated memory goes over the budget, which
+// counts the bookkeeping of every version too, the slot of a pruned version is reused by a later one so its id can come back
+template <typename rope_type>
+class undo_tree_t {
+public:
+    using snapshot_t = typename rope_type::snapshot_t;
+    using version_id_t = size_t;
+    using clock_t = std::chrono::steady_clock;
+
+    static constexpr version_id_t invalid_version = ~version_id_t{ 0 };
+
+    // what an edit did, replaced erased bytes at pos with inserted bytes
+    struct edit_t {
+        size_t pos;
+        size_t erased;
+        size_t inserted;
+    };
+
+    struct version_t {
+        std::optional<snapshot_t> snapshot;  // empty once pruned
+        version_id_t parent;
+        version_id_t redo_child;  // the child redo goes to, the most recently created or visited one
+        std::vector<version_id_t> children;
+        edit_t edit;  // accumulated edit, for coalescing
+        clock_t::time_point time;
+        size_t bytes;  // estimated memory only this version holds on to
+        bool on_path;  // ancestor of (or) the current version, these are never pruned
+        size_t sequence;  // creation order, ids dont follow it once slots are reused
+        version_id_t older;  // the live versions in creation order
+        version_id_t newer;
+    };
+
+    undo_tree_t(const rope_type& rope, size_t byte_budget = size_t(64) << 20, clock_t::duration coalesce_timeout = std::chrono::seconds(1))
+      : _byte_budget(byte_budget), _coalesce_timeout(coalesce_timeout) {
+        _versions.push_back(version_t{ .snapshot = rope.snapshot(), .parent = invalid_version, .redo_child = invalid_version, .edit = {}, .time = clock_t::now(), .bytes = version_overhead, .on_path = true, .sequence = 0, .older = invalid_version, .newer = invalid_version });
+        _root = _current = _oldest = _newest = 0;
+        _bytes = version_overhead;
+        _memory_usage_at_current = rope.memory_usage();
+    }
+
+    // records the state of the rope after an edit
+    void commit(const rope_type& rope, const edit_t& edit, clock_t::time_point now = clock_t::now()) {
+        size_t memory_usage = rope.memory_usage();
+        version_t& current = _versions[_current];
+        if (_coalesce && should_coalesce(current, edit, now)) {
+            current.snapshot = rope.snapshot();
+            current.edit = coalesce(current.edit, edit);
+            current.time = now;
+            _bytes -= current.bytes;
+            current.bytes = memory_usage - std::min(memory_usage, _memory_usage_at_parent) + version_overhead;
+            _bytes += current.bytes;
+            _memory_usage_at_current = memory_usage;
+        } else {
+            size_t bytes = memory_usage - std::min(memory_usage, _memory_usage_at_current) + version_overhead;
+            version_id_t id = add(version_t{ .snapshot = rope.snapshot(), .parent = _current, .redo_child = invalid_version, .edit = edit, .time = now, .bytes = bytes, .on_path = true, .sequence = _sequence++, .older = _newest, .newer = invalid_version });
+            _versions[_current].children.push_back(id);
+            _versions[_current].redo_child = id;
+            _bytes += bytes;
+            _version_count++;
+            _memory_usage_at_parent = _memory_usage_at_current;
+            _memory_usage_at_current = memory_usage;
+            _current = id;
+            _coalesce = true;
+        }
+        prune();
+    }
+
+    // the next commit starts a new version even if it would coalesce, ex: when the cursor is moved by the user
+    void break_coalescing() {
+        _coalesce = false;
+    }
+
+    bool undo(rope_type& rope) {
+        version_id_t parent = _versions[_current].parent;
+        if (parent == invalid_version) return false;
+        _versions[parent].redo_child = _current;
+        _versions[_current].on_path = false;
+        if (_scan == invalid_version || _versions[_current].sequence < _versions[_scan].sequence) _scan = _current;
+        move_to(parent, rope);
+        return true;
+    }
+
+    bool redo(rope_type& rope) {
+        version_id_t child = _versions[_current].redo_child;
+        if (child == invalid_version) return false;
+        _versions[child].on_path = true;
+        move_to(child, rope);
+        return true;
+    }
+
+    // O(1), the path to the new version is only worked out once pruning needs it, false if version was pruned (and its slot not
+    // reused since)
+    bool jump(version_id_t version, rope_type& rope) {
+        if (version >= _versions.size() || !_versions[version].snapshot) return false;
+        _path_dirty = true;
+        move_to(version, rope);
+        return true;
+    }
+
+    version_id_t current() const { return _current; }
+    version_id_t root() const { return _root; }
+    const version_t& version(version_id_t version) const { return _versions[version]; }
+
+    size_t version_count() const { return _version_count; }
+
+    // estimated bytes held only by the history, with the bookkeeping of the versions
+    size_t memory_usage() const { return _bytes; }
+
+    void set_byte_budget(size_t byte_budget) {
+        _byte_budget = byte_budget;
+        prune();
+    }
+
+private:
+    void move_to(version_id_t version, rope_type& rope) {
+        rope = rope_type(*_versions[version].snapshot);
+        _current = version;
+        _coalesce = false;
+        _memory_usage_at_current = rope.memory_usage();
+        _memory_usage_at_parent = _memory_usage_at_current;
+    }
+
+    bool should_coalesce(const version_t& current, const edit_t& edit, clock_t::time_point now) const {
+        if (current.parent == invalid_version || !current.children.empty()) return false;
+        if (now - current.time > _coalesce_timeout) return false;
+        const edit_t& last = current.edit;
+        bool typing = !last.erased && !edit.erased && edit.pos == last.pos + last.inserted;
+        bool backspacing = !last.inserted && !edit.inserted && edit.pos + edit.erased == last.pos;
+        bool deleting = !last.inserted && !edit.inserted && edit.pos == last.pos;
+        return typing || backspacing || deleting;
+    }
+
+    static edit_t coalesce(const edit_t& last, const edit_t& edit) {
+        if (!last.erased && !edit.erased) return { last.pos, 0, last.inserted + edit.inserted };
+        return { std::min(last.pos, edit.pos), last.erased + edit.erased, 0 };
+    }
+
+    // a slot on the free list if there is one, linked in as the newest version
+    version_id_t add(version_t&& version) {
+        version_id_t id;
+        if (_free.empty()) {
+            id = _versions.size();
+            _versions.push_back(std::move(version));
+        } else {
+            id = _free.back();
+            _free.pop_back();
+            _versions[id] = std::move(version);
+        }
+        if (_newest != invalid_version) _versions[_newest].newer = id;
+        else _oldest = id;
+        _newest = id;
+        return id;
+    }
+
+    void mark_path() {
+        for (version_id_t v = _oldest; v != invalid_version; v = _versions[v].newer) _versions[v].on_path = false;
+        for (version_id_t v = _current; v != invalid_version; v = _versions[v].parent) _versions[v].on_path = true;
+        _scan = _oldest;
+        _path_dirty = false;
+    }
+
+    // removes a version and all of its descendants, their slots go on the free list
+    void remove_branch(version_id_t id) {
+        version_id_t parent = _versions[id].parent;
+        std::vector<version_id_t> stack{ id };
+        while (!stack.empty()) {
+            version_id_t removed = stack.back();
+            version_t& version = _versions[removed];
+            stack.pop_back();
+            stack.insert(stack.end(), version.children.begin(), version.children.end());
+            std::vector<version_id_t>().swap(version.children);
+            version.redo_child = invalid_version;
+            version.snapshot.reset();
+            _bytes -= std::min(_bytes, version.bytes);
+            _version_count--;
+            if (version.older != invalid_version) _versions[version.older].newer = version.newer;
+            else _oldest = version.newer;
+            if (version.newer != invalid_version) _versions[version.newer].older = version.older;
+            else _newest = version.older;
+            _free.push_back(removed);
+        }
+        if (parent != invalid_version) {
+            std::erase(_versions[parent].children, id);
+            if (_versions[parent].redo_child == id) _versions[parent].redo_child = _versions[parent].children.empty() ? invalid_version : _versions[parent].children.back();
+        }
+    }
+
+    void prune() {
+        while (_bytes > _byte_budget && _version_count > 1) {
+            if (_path_dirty) mark_path();
+            // the first live version in creation order that is not on the path is the root of the oldest branch
+            // everything older than _scan is on the path, that only changes when the path changes
+            while (_scan != invalid_version && _versions[_scan].on_path) _scan = _versions[_scan].newer;
+            if (_scan != invalid_version) {
+                version_id_t older = _versions[_scan].older;  // on the path, so not in the branch
+                remove_branch(_scan);
+                _scan = older == invalid_version ? _oldest : _versions[older].newer;
+                continue;
+            }
+            // only the current branch is left, drop its oldest version
+            assert(_versions[_root].children.size() == 1);
+            version_id_t new_root = _versions[_root].children.front();
+            _versions[_root].children.clear();
+            remove_branch(_root);
+            _versions[new_root].parent = invalid_version;
+            _root = new_root;
+        }
+    }
+
+    // what a version costs on top of the rope nodes it holds, its slot and its entry in the parent's children
+    static constexpr size_t version_overhead = sizeof(version_t) + sizeof(version_id_t);
+
+    std::vector<version_t> _versions;
+    std::vector<version_id_t> _free;  // slots of pruned versions
+    version_id_t _root;
+    version_id_t _current;
+    version_id_t _oldest;  // the ends of the creation order list
+    version_id_t _newest;
+    size_t _sequence = 1;
+    bool _coalesce = false;
+    size_t _byte_budget;
+    clock_t::duration _coalesce_timeout;
+    size_t _bytes = 0;
+    size_t _version_count = 1;
+    version_id_t _scan = 0;  // no live version older than this one is off the path, invalid_version past the newest
+    bool _path_dirty = false;
+    size_t _memory_usage_at_current;  // rope memory usage when the current version was created
+    size_t _memory_usage_at_parent = 0;  // rope memory usage when the parent of the current version was created
+};
+
+} // namespace rope
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ROPE_BENCH_HPP
+#define ROPE_BENCH_HPP
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <iterator>
+
+// keeps the optimizer from throwing away queries whose result is unused
+inline volatile size_t sink;
+
+// words of random letters, with a '\n' every 64 chars on average
+inline std::string random_text(size_t size, std::mt19937_64& rng) {
+    std::string str(size, ' ');
+    for (size_t i = 0; i < size; i++) {
+        uint64_t r = rng() % 64;
+        str[i] = r == 0 ? '\n' : r < 10 ? ' ' : char('a' + r % 26);
+    }
+    return str;
+}
+
+// c like lines (declarations, calls, strings, line and block comments, directives), for the highlighting benches
+inline std::string random_source(size_t lines, std::mt19937_64& rng) {
+    static const char *templates[] = {
+        "#include <vector>\n",
+        "    int value = 42;\n",
+        "    size_t count = items.size() * 2 + 1;\n",
+        "    if (count > limit) return \"too many\";\n",
+        "    // walks the list and sums the weights\n",
+        "    for (size_t i = 0; i < count; i++) total += weights[i];\n",
+        "    /* kept for the old format,\n       remove once nothing writes it */\n",
+        "}\n",
+        "static bool check(const char *name, double ratio) {\n",
+        "    return std::strcmp(name, \"config\") == 0 && ratio >= 0.5;\n",
+        "\n",
+    };
+    std::string str;
+    for (size_t i = 0; i < lines; i++) str += templates[rng() % std::size(templates)];
+    return str;
+}
+
+template <typename fn_t>
+double ns_per_op(size_t ops, fn_t&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < ops; i++) fn(i);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(ops);
+}
+
+template <typename fn_t>
+double ms(fn_t&& fn) {
+    return ns_per_op(1, fn) / 1e6;
+}
+
+#endif
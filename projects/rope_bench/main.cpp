@@ -0,0 +1,659 @@
+#include "core/rope.hpp"
+#include "core/btree_rope.hpp"
+#include "core/slab_allocator.hpp"
+#include "core/undo_tree.hpp"
+#include "core/anchor_set.hpp"
+#include "core/decoration_set.hpp"
+#include "core/highlighter.hpp"
+#include "core/source_lexer.hpp"
+#include "core/grammar.hpp"
+#include "core/structure.hpp"
+#include "core/text_layout.hpp"
+#include "core/file.hpp"
+#include "core/search.hpp"
+#include "core/parallel_search.hpp"
+
+#include "bench.hpp"
+#include "traces.hpp"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <optional>
+#include <iostream>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+/*
+
+per keystroke latency of rope_t for different document sizes, if the tree stays balanced the numbers should stay flat,
+with and without a cursor
+and build/edit/teardown time of std::allocator vs core::slab_allocator_t
+and memory per undo step of undo_tree_t replaying a 100k edit trace
+and time/resident memory to open a file by reading it into a rope vs mapping it, and save throughput
+and literal/regex search throughput over the allocator document, on one thread and on a thread pool
+and how full the leaves stay after scattered small edits, with and without compact()
+and the binary rope_t against btree_rope_t, depth, edit latency, random reads and memory per byte
+and the per keystroke cost of keeping 1m anchors in sync with the rope
+and the same for 1m token sized decorations, and the time to find the ones on a screen full of text
+and the cost of keeping the syntax highlighting of a 100k line file up to date while typing
+and tokenizing throughput of the compiled grammar dfa against the hand written lexer, and the grammar compile and cache load time,
+and the time for a rule that never accepts to lex long lines
+and matching brackets and folding by indentation from the rope summaries against scanning, on a minified file and a deep fold
+and the time to lay out a screen full of text for a 10 line file, a 1k and a 10m line one and a 16mb line, scrolled anywhere
+usage: rope_bench [max document size in bytes, default 1gb] [allocator document size in bytes, default 100mb] [open file size in bytes, default 1gb]
+
+rope_bench --json [max document size in bytes, default 64mb] replays the editing traces in traces.cpp instead and prints json
+
+*/
+
+using rope_type_t = rope::rope_t<1024>;
+
+static void keystroke_bench(size_t max_size) {
+    constexpr size_t ops = 100000;
+
+    std::mt19937_64 rng(0);
+    std::cout << "size\tdepth\ttype ns\tappend ns\terase ns\tgoto line ns\tsnapshot + type ns\tcursor type ns\tcursor backspace ns\n";
+    for (size_t size = 1024; size <= max_size; size *= 32) {
+        rope_type_t rope{ random_text(size, rng) };
+
+        // a user typing a word at a random spot, then moving somewhere else
+        size_t cursor = 0;
+        double type_ns = ns_per_op(ops, [&](size_t i) {
+            if (i % 16 == 0) cursor = rng() % (rope.size() + 1);
+            rope.insert("x", 1, cursor++);
+        });
+
+        double append_ns = ns_per_op(ops, [&](size_t) {
+            rope.insert("x", 1, rope.size());
+        });
+
+        double erase_ns = ns_per_op(ops, [&](size_t) {
+            rope.erase(rng() % rope.size(), 1);
+        });
+
+        double goto_line_ns = ns_per_op(ops, [&](size_t) {
+            size_t line = rng() % rope.line_count();
+            sink = rope.line_to_offset(line) + rope.offset_to_line(rng() % rope.size());
+        });
+
+        // every keystroke is made while a snapshot is alive, so each edit has to path copy
+        double snapshot_type_ns = ns_per_op(ops, [&](size_t i) {
+            if (i % 16 == 0) cursor = rng() % (rope.size() + 1);
+            auto snapshot = rope.snapshot();
+            rope.insert("x", 1, cursor++);
+        });
+
+        // the same typing and backspacing through a cursor, most keystrokes land in the leaf the cursor is already at
+        rope_type_t::cursor_t finger;
+        double cursor_type_ns = ns_per_op(ops, [&](size_t i) {
+            if (i % 16 == 0) cursor = rng() % (rope.size() + 1);
+            rope.insert(finger, "x", 1, cursor++);
+        });
+        double cursor_erase_ns = ns_per_op(ops, [&](size_t i) {
+            if (i % 16 == 0) cursor = 16 + rng() % (rope.size() - 15);
+            rope.erase(finger, --cursor, 1);
+        });
+
+        std::cout << size << '\t' << rope.depth() << '\t' << type_ns << '\t' << append_ns << '\t' << erase_ns << '\t' << goto_line_ns << '\t' << snapshot_type_ns << '\t' << cursor_type_ns << '\t' << cursor_erase_ns << '\n';
+    }
+}
+
+// random 1 byte reads are a walk from the root with a cache miss per level once the tree is bigger than the cache, so they show
+// the difference in depth, run under perf stat -e cache-misses to see the misses themselves
+template <typename rope_type>
+static void tree_bench(const char *name, size_t max_size) {
+    constexpr size_t ops = 100000;
+
+    std::mt19937_64 rng(0);
+    for (size_t size = 1024; size <= max_size; size *= 32) {
+        rope_type rope{ random_text(size, rng) };
+
+        size_t cursor = 0;
+        double type_ns = ns_per_op(ops, [&](size_t i) {
+            if (i % 16 == 0) cursor = rng() % (rope.size() + 1);
+            rope.insert("x", 1, cursor++);
+        });
+
+        double erase_ns = ns_per_op(ops, [&](size_t) {
+            rope.erase(rng() % rope.size(), 1);
+        });
+
+        double read_ns = ns_per_op(ops, [&](size_t) {
+            char c;
+            rope.slice(rng() % rope.size(), 1, &c);
+            sink = size_t(c);
+        });
+
+        double goto_line_ns = ns_per_op(ops, [&](size_t) {
+            size_t line = rng() % rope.line_count();
+            sink = rope.line_to_offset(line) + rope.offset_to_line(rng() % rope.size());
+        });
+
+        double scan_ms = ms([&](size_t) {
+            size_t bytes = 0;
+            for (std::string_view chunk : rope.chunks()) bytes += chunk.size();
+            sink = bytes;
+        });
+
+        std::cout << name << '\t' << size << '\t' << rope.depth() << '\t' << type_ns << '\t' << erase_ns << '\t' << read_ns << '\t' << goto_line_ns << '\t' << scan_ms << '\t'
+                  << double(rope.memory_usage()) / double(rope.size()) << '\n';
+    }
+}
+
+template <template <typename type> typename allocator>
+static void allocator_bench(const char *name, const std::string& text) {
+    using rope_type = rope::rope_t<1024, allocator>;
+    constexpr size_t ops = 1000000;
+    constexpr size_t chunk = 4096;
+
+    std::mt19937_64 rng(0);
+    rope_type *rope;
+    // built the way a file gets loaded, in chunks, so every leaf is its own allocation
+    double build_ms = ms([&](size_t) {
+        rope = new rope_type{ "" };
+        for (size_t pos = 0; pos < text.size(); pos += chunk) rope->insert(text.data() + pos, std::min(chunk, text.size() - pos), pos);
+    });
+    double edit_ms = ms([&](size_t) {
+        for (size_t i = 0; i < ops; i++) {
+            if (i & 1) {
+                size_t pos = rng() % rope->size();
+                rope->erase(pos, std::min(1 + rng() % 2048, rope->size() - pos));
+            } else {
+                rope->insert(text.data(), 1 + rng() % 2048, rng() % (rope->size() + 1));
+            }
+        }
+    });
+    double teardown_ms = ms([&](size_t) {
+        delete rope;
+    });
+    std::cout << name << '\t' << build_ms << '\t' << edit_ms << '\t' << teardown_ms << '\n';
+}
+
+static void search_bench(const std::string& text) {
+    rope_type_t rope{ text };
+    double gb = double(text.size()) / double(1 << 30);
+
+    std::cout << "\nsearch\tmatches\tgb/s\n";
+    // none of these occur in random_text, so every byte gets scanned
+    for (const char *needle : { "#", "needle", "a much longer needle that never matches" }) {
+        rope::literal_search_t search{ needle };
+        size_t matches = 0;
+        double seconds = ms([&](size_t) { matches = search.find_all(rope).size(); }) / 1e3;
+        std::cout << "literal \"" << needle << "\"\t" << matches << '\t' << gb / seconds << '\n';
+    }
+    for (const char *pattern : { "[0-9]+", "foo|bar|baz", "^x.*y$" }) {
+        rope::regex_search_t search{ pattern };
+        size_t matches = 0;
+        double seconds = ms([&](size_t) { matches = search.find_all(rope).size(); }) / 1e3;
+        std::cout << "regex \"" << pattern << "\"\t" << matches << '\t' << gb / seconds << '\n';
+    }
+
+    core::thread_pool_t pool;
+    std::cout << "\nparallel search (" << pool.thread_count() << " threads)\tmatches\tgb/s\tfirst batch ms\tcancel ms\n";
+    auto parallel = [&](const std::string& name, const auto& search) {
+        std::vector<rope::match_t> matches;
+        double first_batch_ms = 0;
+        double seconds = ms([&](size_t) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto job = rope::find_all_parallel(pool, rope.snapshot(), search);
+            while (!job->done()) {
+                if (job->take(matches) && !first_batch_ms) first_batch_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                std::this_thread::yield();
+            }
+            job->take(matches);
+        }) / 1e3;
+        // a keystroke in the search box, the job is replaced right after it starts
+        double cancel_ms = ms([&](size_t) {
+            auto job = rope::find_all_parallel(pool, rope.snapshot(), search);
+            job->cancel();
+            job->wait();
+        });
+        std::cout << name << '\t' << matches.size() << '\t' << gb / seconds << '\t' << first_batch_ms << '\t' << cancel_ms << '\n';
+    };
+    for (const char *needle : { "#", "needle", "a" }) parallel(std::string("literal \"") + needle + '"', rope::literal_search_t{ needle });
+    for (const char *pattern : { "[0-9]+", "foo|bar|baz", "^x.*y$" }) parallel(std::string("regex \"") + pattern + '"', rope::regex_search_t{ pattern });
+}
+
+// fill ratio and full scan time of a rope after lots of small scattered edits, before and after compact()
+static void compact_bench(const std::string& text) {
+    constexpr size_t ops = 1000000;
+
+    std::mt19937_64 rng(0);
+    rope_type_t rope{ text };
+    double fresh_fill = rope.fill_ratio();
+    for (size_t i = 0; i < ops; i++) {
+        size_t pos = rng() % rope.size();
+        if (i & 1) rope.erase(pos, std::min(size_t(1 + rng() % 8), rope.size() - pos));
+        else rope.insert(text.data(), 1 + rng() % 8, pos);
+    }
+    auto scan_ms = [&] {
+        return ms([&](size_t) {
+            size_t bytes = 0;
+            for (std::string_view chunk : rope.chunks()) bytes += chunk.size();
+            sink = bytes;
+        });
+    };
+    double edited_fill = rope.fill_ratio();
+    double edited_scan_ms = scan_ms();
+    size_t edited_memory = rope.memory_usage();
+    double compact_ms = ms([&](size_t) { rope.compact(); });
+    std::cout << "\nfill fresh\tfill edited\tfill compacted\tscan ms edited\tscan ms compacted\tmb edited\tmb compacted\tcompact ms\n";
+    std::cout << fresh_fill << '\t' << edited_fill << '\t' << rope.fill_ratio() << '\t' << edited_scan_ms << '\t' << scan_ms() << '\t' << double(edited_memory) / double(1 << 20) << '\t' << double(rope.memory_usage()) / double(1 << 20) << '\t' << compact_ms << '\n';
+}
+
+// resident set size of the process, linux only
+static size_t rss() {
+    size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+}
+
+static void open_bench(size_t size) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "rope_bench_open.txt";
+    {
+        std::mt19937_64 rng(0);
+        std::string block = random_text(size_t(1) << 20, rng);
+        std::ofstream file(path, std::ios::binary);
+        for (size_t written = 0; written < size; written += block.size()) file.write(block.data(), std::min(block.size(), size - written));
+    }
+
+    std::cout << "\nopen\tms\trss mb\tfirst edit us\tindex ms\n";
+    {
+        // the mapping is opened first, the read below would leave the file in the page cache but that doesnt count towards rss
+        size_t rss_before = rss();
+        rope_type_t *rope;
+        double open_ms = ms([&](size_t) {
+            rope = new rope_type_t{ core::mapped_file_t::open(path) };
+        });
+        double edit_us = ms([&](size_t) { rope->insert("x", 1, rope->size() / 2); }) * 1e3;
+        size_t rss_after = rss();
+        double index_ms = ms([&](size_t) { rope->build_index(); });
+        std::cout << "mapped\t" << open_ms << '\t' << double(rss_after - std::min(rss_after, rss_before)) / double(1 << 20) << '\t' << edit_us << '\t' << index_ms << '\n';
+        delete rope;
+    }
+    {
+        size_t rss_before = rss();
+        rope_type_t *rope;
+        double open_ms = ms([&](size_t) {
+            std::ifstream file(path, std::ios::binary);
+            std::string str(size, '\0');
+            file.read(str.data(), size);
+            rope = new rope_type_t{ str };
+        });
+        double edit_us = ms([&](size_t) { rope->insert("x", 1, rope->size() / 2); }) * 1e3;
+        size_t rss_after = rss();
+        std::cout << "read\t" << open_ms << '\t' << double(rss_after - std::min(rss_after, rss_before)) / double(1 << 20) << '\t' << edit_us << '\t' << 0 << '\n';
+
+        // streamed straight out of the leaves, rss shouldnt grow
+        rss_before = rss();
+        double save_ms = ms([&](size_t) { rope->save(path); });
+        double save_sync_ms = ms([&](size_t) { rope->save(path, true); });
+        rss_after = rss();
+        std::cout << "\nsave mb/s\tsave + fsync mb/s\trss growth mb\n";
+        std::cout << double(size) / double(1 << 20) / (save_ms / 1e3) << '\t' << double(size) / double(1 << 20) / (save_sync_ms / 1e3) << '\t' << double(rss_after - std::min(rss_after, rss_before)) / double(1 << 20) << '\n';
+        delete rope;
+    }
+    std::filesystem::remove(path);
+}
+
+static void undo_bench() {
+    constexpr size_t edits = 100000;
+    using undo_tree_type = rope::undo_tree_t<rope_type_t>;
+
+    std::mt19937_64 rng(0);
+    rope_type_t rope{ random_text(size_t(1) << 20, rng) };
+    undo_tree_type undo_tree{ rope, ~size_t{ 0 } };
+    std::string paste = random_text(4096, rng);
+
+    // bursts of typing at random spots, some backspacing and the odd paste, 100ms between keystrokes
+    auto now = undo_tree_type::clock_t::now();
+    size_t cursor = 0;
+    double commit_ns = ns_per_op(edits, [&](size_t i) {
+        now += std::chrono::milliseconds(100);
+        if (i % 32 == 0) {
+            cursor = rng() % (rope.size() + 1);
+            undo_tree.break_coalescing();
+        }
+        uint64_t r = rng() % 100;
+        if (r < 85) {
+            rope.insert("x", 1, cursor);
+            undo_tree.commit(rope, { cursor++, 0, 1 }, now);
+        } else if (r < 99) {
+            if (!cursor) return;
+            rope.erase(--cursor, 1);
+            undo_tree.commit(rope, { cursor, 1, 0 }, now);
+        } else {
+            rope.insert(paste.data(), paste.size(), cursor);
+            undo_tree.commit(rope, { cursor, 0, paste.size() }, now);
+            cursor += paste.size();
+        }
+    });
+
+    size_t versions = undo_tree.version_count();
+    size_t bytes = undo_tree.memory_usage();
+    double undo_ns = ns_per_op(versions - 1, [&](size_t) { undo_tree.undo(rope); });
+    double redo_ns = ns_per_op(versions - 1, [&](size_t) { undo_tree.redo(rope); });
+    double jump_ns = ns_per_op(edits, [&](size_t) { undo_tree.jump(rng() % versions, rope); });
+
+    std::cout << "\nedits\tversions\thistory bytes\tbytes/version\tbytes/edit\tcommit ns\tundo ns\tredo ns\tjump ns\n";
+    std::cout << edits << '\t' << versions << '\t' << bytes << '\t' << bytes / versions << '\t' << bytes / edits << '\t' << commit_ns << '\t' << undo_ns << '\t' << redo_ns << '\t' << jump_ns << '\n';
+}
+
+static void anchor_bench() {
+    constexpr size_t anchors = 1000000;
+    constexpr size_t keystrokes = 1000000;
+
+    std::mt19937_64 rng(0);
+    rope_type_t rope{ random_text(size_t(16) << 20, rng) };
+    rope::anchor_set_t anchor_set;
+    std::vector<rope::anchor_set_t::anchor_id_t> ids(anchors);
+    double insert_ns = ns_per_op(anchors, [&](size_t i) {
+        ids[i] = anchor_set.insert(rng() % (rope.size() + 1), i & 1 ? rope::anchor_set_t::gravity_t::right : rope::anchor_set_t::gravity_t::left);
+    });
+
+    // typing with a caret anchor, jumping somewhere else every 32 keystrokes
+    rope::anchor_set_t::anchor_id_t caret = anchor_set.insert(0, rope::anchor_set_t::gravity_t::right);
+    double rope_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 32 == 0) anchor_set.move(caret, rng() % (rope.size() + 1));
+        rope.insert("x", 1, anchor_set.offset(caret));
+    });
+    double anchors_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 32 == 0) anchor_set.move(caret, rng() % (rope.size() + 1));
+        size_t pos = anchor_set.offset(caret);
+        rope.insert("x", 1, pos);
+        anchor_set.edit(pos, 0, 1);
+    });
+    double offset_ns = ns_per_op(anchors, [&](size_t) { anchor_set.offset(ids[rng() % anchors]); });
+    // the anchors on a screen full of text
+    size_t visited = 0;
+    double window_ns = ns_per_op(10000, [&](size_t) {
+        size_t pos = rng() % rope.size();
+        anchor_set.for_each(pos, pos + 4096, [&](rope::anchor_set_t::anchor_id_t, size_t) { visited++; });
+    });
+
+    std::cout << "\nanchors\tinsert ns\tkeystroke ns\tkeystroke + anchors ns\toffset ns\t4kb window us\tbytes/anchor\n";
+    std::cout << anchors << '\t' << insert_ns << '\t' << rope_ns << '\t' << anchors_ns << '\t' << offset_ns << '\t' << window_ns / 1e3 << '\t' << anchor_set.memory_usage() / anchors << '\n';
+}
+
+static void decoration_bench() {
+    constexpr size_t decorations = 1000000;
+    constexpr size_t keystrokes = 1000000;
+
+    std::mt19937_64 rng(0);
+    rope_type_t rope{ random_text(size_t(16) << 20, rng) };
+    rope::decoration_set_t<uint32_t> decoration_set;
+    // syntax colour sized ranges, ex: a token every 16 bytes
+    double insert_ns = ns_per_op(decorations, [&](size_t) {
+        size_t begin = rng() % rope.size();
+        decoration_set.insert(begin, std::min(rope.size(), begin + 1 + rng() % 16), uint32_t(rng() % 32));
+    });
+
+    // typing, jumping somewhere else every 32 keystrokes
+    size_t pos = 0;
+    double decorations_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 32 == 0) pos = rng() % (rope.size() + 1);
+        rope.insert("x", 1, pos);
+        decoration_set.edit(pos, 0, 1);
+        pos++;
+    });
+    // the decorations on a screen full of text
+    size_t visited = 0;
+    double window_ns = ns_per_op(10000, [&](size_t) {
+        pos = rng() % rope.size();
+        decoration_set.query(pos, pos + 4096, [&](rope::decoration_set_t<uint32_t>::decoration_id_t, size_t, size_t, uint32_t) { visited++; });
+    });
+
+    std::cout << "\ndecorations\tinsert ns\tkeystroke + decorations ns\t4kb window us\tdecorations/window\tbytes/decoration\n";
+    std::cout << decorations << '\t' << insert_ns << '\t' << decorations_ns << '\t' << window_ns / 1e3 << '\t' << visited / 10000 << '\t' << decoration_set.memory_usage() / decorations << '\n';
+}
+
+static void highlight_bench() {
+    constexpr size_t lines = 100000;
+    constexpr size_t keystrokes = 10000;
+    constexpr size_t viewport = 60;
+
+    std::mt19937_64 rng(0);
+    rope_type_t rope{ random_source(lines, rng) };
+    rope::highlighter_t<rope_type_t, rope::source_lexer_t> highlighter;
+    std::vector<rope::token_span_t> spans;
+    double full_ms = ms([&](size_t) { highlighter.update(rope); });
+
+    // typing, jumping somewhere else every 16 keystrokes, and colouring the lines around the caret after every one
+    // quotes, slashes, stars and newlines change the state of the line, the rest only its spans
+    static const char keys[] = "abc x=;\"/*\n";
+    size_t pos = 0;
+    double max_ns = 0;
+    double keystroke_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 16 == 0) pos = rng() % (rope.size() + 1);
+        auto start = std::chrono::high_resolution_clock::now();
+        rope.insert(&keys[rng() % (sizeof(keys) - 1)], 1, pos++);
+        size_t line = rope.offset_to_line(pos);
+        spans.clear();
+        highlighter.highlight(rope, line - std::min(line, viewport / 2), line + viewport / 2, spans);
+        max_ns = std::max(max_ns, std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count());
+    });
+
+    // a block comment opened on the first line, everything down to the next "*/" changes state, but only the viewport is re-lexed
+    // right away
+    double open_comment_ns = ns_per_op(1, [&](size_t) {
+        rope.insert("/*", 2, 0);
+        spans.clear();
+        highlighter.highlight(rope, 0, viewport, spans);
+    });
+
+    std::cout << "\nlines\tfull lex ms\tkeystroke + viewport us\tmax us\topen comment at the top us\tbytes/line\n";
+    std::cout << lines << '\t' << full_ms << '\t' << keystroke_ns / 1e3 << '\t' << max_ns / 1e3 << '\t' << open_comment_ns / 1e3 << '\t' << highlighter.memory_usage() / lines << '\n';
+}
+
+template <typename lexer_t>
+static void tokenize_bench(const char *name, const lexer_t& lexer, const std::string& text, double compile_ms, double load_ms, size_t dfa_states) {
+    std::vector<rope::token_span_t> spans;
+    size_t tokens = 0;
+    double tokenize_ms = ms([&](size_t) {
+        typename lexer_t::state_t state{};
+        for (size_t pos = 0; pos < text.size();) {
+            size_t end = std::min(text.find('\n', pos), text.size());
+            spans.clear();
+            state = lexer.lex_line(state, std::string_view(text).substr(pos, end - pos), spans);
+            tokens += spans.size();
+            pos = end + 1;
+        }
+    });
+    // the same through highlighter_t, lines read from the rope leaves
+    rope_type_t rope{ text };
+    rope::highlighter_t<rope_type_t, lexer_t> highlighter{ lexer };
+    double highlight_ms = ms([&](size_t) { highlighter.update(rope); });
+    sink = tokens;
+
+    double mb = double(text.size()) / double(1 << 20);
+    std::cout << name << '\t' << compile_ms << '\t' << load_ms << '\t' << dfa_states << '\t' << mb / (tokenize_ms / 1e3) << '\t' << mb / (highlight_ms / 1e3) << '\n';
+}
+
+static void grammar_bench() {
+    std::mt19937_64 rng(0);
+    std::string text = random_source(200000, rng);
+
+    std::filesystem::path cache_dir = std::filesystem::temp_directory_path() / "rope_bench_grammars";
+    std::filesystem::remove_all(cache_dir);
+    std::optional<rope::grammar_t> grammar;
+    double compile_ms = ms([&](size_t) { grammar = rope::grammar_t::load(rope::grammar_t::cpp_source(), cache_dir); });
+    double load_ms = ms([&](size_t) { grammar = rope::grammar_t::load(rope::grammar_t::cpp_source(), cache_dir); });
+    std::filesystem::remove_all(cache_dir);
+
+    std::cout << "\nlexer\tcompile ms\tcache load ms\tdfa states\ttokenize mb/s\thighlight mb/s\n";
+    tokenize_bench("grammar_t", *grammar, text, compile_ms, load_ms, grammar->dfa_state_count());
+    tokenize_bench("source_lexer_t", rope::source_lexer_t{}, text, 0, 0, 0);
+
+    // a rule that runs to the end of the line without accepting, every scan after the first has to stop where the first one failed
+    // or the line is quadratic
+    rope::grammar_t backtracking = rope::grammar_t::compile("state s\nkeyword a+b\n");
+    std::cout << "\n'a+b' over a line of 'a', bytes\tms\n";
+    for (size_t size : { size_t(10000), size_t(100000), size_t(1000000) }) {
+        std::string line(size, 'a');
+        std::vector<rope::token_span_t> spans;
+        double line_ms = ms([&](size_t) {
+            spans.clear();
+            backtracking.lex_line(0, line, spans);
+            sink = spans.size();
+        });
+        std::cout << size << '\t' << line_ms << '\n';
+    }
+}
+
+static void structure_bench() {
+    using structure_rope_t = rope::rope_t<1024, std::allocator, rope::summary::brackets_t, rope::summary::indentation_t<>>;
+    constexpr size_t size = size_t(16) << 20;
+    constexpr size_t keystrokes = 1000000;
+
+    // minified, one line of nested brackets all inside the first one
+    std::mt19937_64 rng(0);
+    std::string text = "{";
+    size_t depth = 1;
+    while (text.size() < size - depth) {
+        uint64_t r = rng() % 8;
+        if (r == 0) text += "{[", depth += 2;
+        else if (r == 1 && depth > 2) text += "]}", depth -= 2;
+        else text += char('a' + r);
+    }
+    while (depth > 1) text += "]}", depth -= 2;
+    text += "}";
+
+    std::optional<rope_type_t> plain;
+    std::optional<structure_rope_t> rope;
+    double plain_build_ms = ms([&](size_t) { plain.emplace(text); });
+    double build_ms = ms([&](size_t) { rope.emplace(text); });
+
+    // the summaries are redone for the leaf and the path to it on every edit
+    size_t pos = 0;
+    double plain_keystroke_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 32 == 0) pos = rng() % (plain->size() + 1);
+        plain->insert("x", 1, pos++);
+    });
+    double keystroke_ns = ns_per_op(keystrokes, [&](size_t i) {
+        if (i % 32 == 0) pos = rng() % (rope->size() + 1);
+        rope->insert("x", 1, pos++);
+    });
+
+    // the closing bracket of the first one is the last byte
+    double match_ns = ns_per_op(1000, [&](size_t) { sink = *rope::match_bracket(*rope, 0); });
+    double scan_ms = ms([&](size_t) {
+        int32_t depth = 0;
+        size_t offset = 0;
+        for (std::string_view chunk : rope->chunks()) {
+            for (size_t i = 0; i < chunk.size(); i++) {
+                depth += chunk[i] == '{';
+                depth -= chunk[i] == '}';
+                if (!depth) sink = offset + i;
+            }
+            offset += chunk.size();
+        }
+    });
+    double enclosing_ns = ns_per_op(10000, [&](size_t) { sink = rope::enclosing_brackets(*rope, rng() % rope->size())->open; });
+
+    // a namespace around 100k lines, folding its first line hides the rest of the file
+    std::string source = "namespace app {\n";
+    for (char ch : random_source(100000, rng)) {
+        if (source.back() == '\n') source += "    ";
+        source += ch;
+    }
+    structure_rope_t source_rope(source + "}\n");
+    double fold_ns = ns_per_op(1000, [&](size_t) { sink = rope::fold_region(source_rope, 0)->last_line; });
+    double line_fold_ns = ns_per_op(10000, [&](size_t) {
+        std::optional<rope::fold_t> fold = rope::fold_region(source_rope, rng() % source_rope.line_count());
+        sink = fold ? fold->last_line : 0;
+    });
+
+    std::cout << "\nstructure\tbuild ms\tplain build ms\tkeystroke ns\tplain keystroke ns\tmatch across the file us\tscan ms\tenclosing us\tfold 100k lines us\tfold a line us\n";
+    std::cout << size << '\t' << build_ms << '\t' << plain_build_ms << '\t' << keystroke_ns << '\t' << plain_keystroke_ns << '\t' << match_ns / 1e3 << '\t' << scan_ms << '\t' << enclosing_ns / 1e3 << '\t' << fold_ns / 1e3 << '\t' << line_fold_ns / 1e3 << '\n';
+}
+
+static void text_view_bench() {
+    constexpr size_t frames = 10000;
+    // 1200x800 pixels, a 9x20 pixel font
+    const rope::viewport_t screen{ .width = 1200, .height = 800, .line_height = 20 };
+    auto advance = [](char) { return 9.f; };
+
+    std::cout << "\ntext view\tsize\tframe us\tlines/frame\tbytes read/frame\n";
+    auto bench = [&](const char *name, const std::string& text, float max_scroll_x) {
+        std::mt19937_64 rng(0);
+        rope_type_t rope{ text };
+        size_t lines = 0, bytes = 0;
+        double frame_ns = ns_per_op(frames, [&](size_t) {
+            rope::viewport_t viewport = screen;
+            // anywhere the screen stays full
+            size_t visible = size_t(viewport.height / viewport.line_height);
+            viewport.scroll_y = float(rng() % std::max<size_t>(1, rope.line_count() - std::min(rope.line_count(), visible) + 1)) * viewport.line_height;
+            viewport.scroll_x = max_scroll_x ? float(rng() % size_t(max_scroll_x)) : 0.f;
+            rope::layout_stats_t stats = rope::layout_visible_lines(rope, viewport, advance, [](const rope::glyph_run_t& run) { sink = run.glyphs.size(); });
+            lines += stats.lines;
+            bytes += stats.bytes;
+        });
+        std::cout << name << '\t' << text.size() << '\t' << frame_ns / 1e3 << '\t' << lines / frames << '\t' << bytes / frames << '\n';
+    };
+
+    std::string text;
+    for (size_t i = 0; i < 10; i++) text += "\tint value = " + std::to_string(i) + ";\n";
+    bench("10 lines", text, 0);
+    for (size_t i = 10; i < 1000; i++) text += "\tint value = " + std::to_string(i) + ";\n";
+    bench("1k lines", text, 0);
+    text.clear();
+    for (size_t i = 0; i < 10000000; i++) text += "\tint value = " + std::to_string(i) + ";\n";
+    bench("10m lines", text, 0);
+    // the start of the line scrolled out on the left is still read
+    std::mt19937_64 rng(0);
+    text = random_text(size_t(16) << 20, rng);
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    bench("16mb line", text, 0);
+    bench("16mb line, scrolled 10k px", text, 10000);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "--json") {
+        trace_bench(std::cout, argc > 2 ? std::strtoull(argv[2], nullptr, 10) : size_t(64) << 20);
+        return 0;
+    }
+
+    size_t max_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(1) << 30;
+    size_t allocator_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : size_t(100) << 20;
+    size_t open_size = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : size_t(1) << 30;
+
+    keystroke_bench(max_size);
+
+    std::cout << "\ntree\tsize\tdepth\ttype ns\terase ns\tread ns\tgoto line ns\tscan ms\tbytes/byte\n";
+    tree_bench<rope_type_t>("binary", max_size);
+    tree_bench<rope::btree_rope_t<1024, 8>>("btree 8", max_size);
+    tree_bench<rope::btree_rope_t<1024, 16>>("btree 16", max_size);
+
+    std::mt19937_64 rng(0);
+    std::string text = random_text(allocator_size, rng);
+    std::cout << "\nallocator\tbuild ms\tedit ms\tteardown ms\n";
+    allocator_bench<std::allocator>("std::allocator", text);
+    allocator_bench<core::slab_allocator_t>("slab_allocator_t", text);
+
+    search_bench(text);
+
+    compact_bench(text);
+
+    undo_bench();
+
+    anchor_bench();
+
+    decoration_bench();
+
+    highlight_bench();
+
+    grammar_bench();
+
+    structure_bench();
+
+    text_view_bench();
+
+    open_bench(open_size);
+
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include "traces.hpp"
+#include "bench.hpp"
+
+#include "core/rope.hpp"
+#include "core/search.hpp"
+#include "core/text_buffer.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/*
+
+every trace starts from a fresh rope over random_text(document size) and is timed as a whole
+typing         bursts of typing at a random spot with the odd backspace
+typing_cursor  the same through a rope_t::cursor_t
+random         inserts and erases of 1 to 64 bytes anywhere
+paste          1mb pastes (or the whole document if it is smaller) anywhere
+replace        every "ab" replaced by "xyz", back to front, an op is one replacement (the search is included)
+replace_batch  the same replacements as a single rope_t::apply()
+append         64 byte log lines appended at the end
+a result is { trace, buffer_length, document_size, ops, ns_per_op, allocations_per_op, depth, memory_per_byte, fill_ratio }, depth
+and memory are taken at the end of the trace, memory_per_byte is bytes of nodes per byte of text
+
+the same traces (but typing_cursor) are also replayed over every text storage, rope_t<1024>, gap_buffer_t, piece_table_t and the
+automatic text_buffer_t, upto 4mb since a gap buffer moves its gap across the whole document on the random traces
+a storage result is { storage, trace, document_size, ops, ns_per_op, memory_per_byte }
+
+*/
+
+namespace {
+
+size_t allocations = 0;
+
+// std::allocator that counts the calls to allocate
+template <typename type>
+struct counting_allocator_t {
+    using value_type = type;
+
+    counting_allocator_t() = default;
+    template <typename other_t>
+    counting_allocator_t(const counting_allocator_t<other_t>&) {}
+
+    type *allocate(size_t n) {
+        allocations++;
+        return std::allocator<type>{}.allocate(n);
+    }
+
+    void deallocate(type *pointer, size_t n) {
+        std::allocator<type>{}.deallocate(pointer, n);
+    }
+};
+
+struct result_t {
+    const char *trace;
+    size_t buffer_length;
+    size_t document_size;
+    size_t ops;
+    double ns_per_op;
+    double allocations_per_op;
+    size_t depth;
+    double memory_per_byte;
+    double fill_ratio;
+};
+
+template <size_t BUFFER_LENGTH>
+void run(size_t size, std::vector<result_t>& o_results) {
+    using rope_type = rope::rope_t<BUFFER_LENGTH, counting_allocator_t>;
+
+    std::mt19937_64 rng(size);
+    std::string text = random_text(size, rng);
+    std::string line = random_text(63, rng) + '\n';
+
+    // edit(rope, i) is op i of the trace, it returns the number of ops it did (replace does them all at once)
+    auto replay = [&](const char *trace, size_t ops, auto&& edit) {
+        rope_type rope{ text };
+        allocations = 0;
+        size_t done = 0;
+        double total_ns = ns_per_op(ops, [&](size_t i) { done += edit(rope, i); });
+        done = std::max(done, size_t(1));
+        o_results.push_back({ trace, BUFFER_LENGTH, size, done, total_ns * double(ops) / double(done), double(allocations) / double(done), rope.depth(),
+                              double(rope.memory_usage()) / double(std::max(rope.size(), size_t(1))), rope.fill_ratio() });
+    };
+
+    size_t cursor = 0;
+    auto type = [&](rope_type& rope, size_t i, auto&&... finger) {
+        if (i % 32 == 0) cursor = rng() % (rope.size() + 1);
+        if (i % 8 == 7 && cursor) rope.erase(finger..., --cursor, 1);
+        else rope.insert(finger..., "e", 1, cursor++);
+        return size_t(1);
+    };
+    replay("typing", 100000, [&](rope_type& rope, size_t i) { return type(rope, i); });
+    typename rope_type::cursor_t finger;
+    replay("typing_cursor", 100000, [&](rope_type& rope, size_t i) { return type(rope, i, finger); });
+
+    replay("random", 100000, [&](rope_type& rope, size_t i) {
+        size_t pos = rng() % (rope.size() + 1);
+        if (i & 1) rope.erase(pos, std::min(size_t(1 + rng() % 64), rope.size() - pos));
+        else rope.insert(text.data(), 1 + rng() % 64, pos);
+        return size_t(1);
+    });
+
+    size_t paste = std::min(size, size_t(1) << 20);
+    replay("paste", 64, [&](rope_type& rope, size_t) {
+        rope.insert(text.data(), paste, rng() % (rope.size() + 1));
+        return size_t(1);
+    });
+
+    replay("replace", 1, [&](rope_type& rope, size_t) {
+        std::vector<rope::match_t> matches = rope::literal_search_t{ "ab" }.find_all(rope);
+        for (auto itr = matches.rbegin(); itr != matches.rend(); ++itr) rope.set_slice("xyz", 3, itr->pos, itr->size);
+        return matches.size();
+    });
+
+    replay("replace_batch", 1, [&](rope_type& rope, size_t) {
+        std::vector<rope::match_t> matches = rope::literal_search_t{ "ab" }.find_all(rope);
+        std::vector<typename rope_type::edit_t> edits;
+        edits.reserve(matches.size());
+        for (const rope::match_t& match : matches) edits.push_back({ match.pos, match.size, "xyz" });
+        rope.apply(edits);
+        return matches.size();
+    });
+
+    replay("append", 100000, [&](rope_type& rope, size_t) {
+        rope.insert(line.data(), line.size(), rope.size());
+        return size_t(1);
+    });
+}
+
+struct storage_result_t {
+    const char *storage;
+    const char *trace;
+    size_t document_size;
+    size_t ops;
+    double ns_per_op;
+    double memory_per_byte;
+};
+
+template <typename storage_t, typename make_t>
+void run_storage(const char *name, size_t size, make_t&& make, std::vector<storage_result_t>& o_results) {
+    constexpr size_t ops = 20000;
+
+    std::mt19937_64 rng(size);
+    std::string text = random_text(size, rng);
+    std::string line = random_text(63, rng) + '\n';
+
+    auto replay = [&](const char *trace, size_t ops, auto&& edit) {
+        storage_t storage = make(text);
+        size_t done = 0;
+        double total_ns = ns_per_op(ops, [&](size_t i) { done += edit(storage, i); });
+        done = std::max(done, size_t(1));
+        o_results.push_back({ name, trace, size, done, total_ns * double(ops) / double(done), double(storage.memory_usage()) / double(std::max(storage.size(), size_t(1))) });
+    };
+
+    size_t cursor = 0;
+    replay("typing", ops, [&](storage_t& storage, size_t i) {
+        if (i % 32 == 0) cursor = rng() % (storage.size() + 1);
+        if (i % 8 == 7 && cursor) storage.erase(--cursor, 1);
+        else storage.insert("e", 1, cursor++);
+        return size_t(1);
+    });
+
+    replay("random", ops, [&](storage_t& storage, size_t i) {
+        size_t pos = rng() % (storage.size() + 1);
+        if (i & 1) storage.erase(pos, std::min(size_t(1 + rng() % 64), storage.size() - pos));
+        else storage.insert(text.data(), 1 + rng() % 64, pos);
+        return size_t(1);
+    });
+
+    size_t paste = std::min(size, size_t(1) << 20);
+    replay("paste", 64, [&](storage_t& storage, size_t) {
+        storage.insert(text.data(), paste, rng() % (storage.size() + 1));
+        return size_t(1);
+    });
+
+    replay("replace", 1, [&](storage_t& storage, size_t) {
+        std::vector<rope::match_t> matches = rope::literal_search_t{ "ab" }.find_all(storage);
+        for (auto itr = matches.rbegin(); itr != matches.rend(); ++itr) storage.set_slice("xyz", 3, itr->pos, itr->size);
+        return matches.size();
+    });
+
+    replay("append", ops, [&](storage_t& storage, size_t) {
+        storage.insert(line.data(), line.size(), storage.size());
+        return size_t(1);
+    });
+}
+
+} // namespace
+
+void trace_bench(std::ostream& o, size_t max_size) {
+    std::vector<result_t> results;
+    for (size_t size = size_t(64) << 10; size <= max_size; size *= 16) {
+        run<64>(size, results);
+        run<256>(size, results);
+        run<1024>(size, results);
+        run<4096>(size, results);
+    }
+
+    std::vector<storage_result_t> storage_results;
+    for (size_t size = size_t(64) << 10; size <= std::min(max_size, size_t(4) << 20); size *= 4) {
+        run_storage<rope::text_buffer_t::rope_type>("rope", size, [](const std::string& text) { return rope::text_buffer_t::rope_type{ text }; }, storage_results);
+        run_storage<rope::gap_buffer_t>("gap_buffer", size, [](const std::string& text) { return rope::gap_buffer_t{ text }; }, storage_results);
+        run_storage<rope::piece_table_t>("piece_table", size, [](const std::string& text) { return rope::piece_table_t{ text }; }, storage_results);
+        run_storage<rope::text_buffer_t>("auto", size, [](const std::string& text) { return rope::text_buffer_t{ text }; }, storage_results);
+    }
+
+    o << "{\n  \"benchmark\": \"rope_traces\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const result_t& result = results[i];
+        o << "    { \"trace\": \"" << result.trace << "\", \"buffer_length\": " << result.buffer_length << ", \"document_size\": " << result.document_size
+          << ", \"ops\": " << result.ops << ", \"ns_per_op\": " << result.ns_per_op << ", \"allocations_per_op\": " << result.allocations_per_op
+          << ", \"depth\": " << result.depth << ", \"memory_per_byte\": " << result.memory_per_byte << ", \"fill_ratio\": " << result.fill_ratio << " }"
+          << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    o << "  ],\n  \"storage_results\": [\n";
+    for (size_t i = 0; i < storage_results.size(); i++) {
+        const storage_result_t& result = storage_results[i];
+        o << "    { \"storage\": \"" << result.storage << "\", \"trace\": \"" << result.trace << "\", \"document_size\": " << result.document_size << ", \"ops\": " << result.ops
+          << ", \"ns_per_op\": " << result.ns_per_op << ", \"memory_per_byte\": " << result.memory_per_byte << " }" << (i + 1 < storage_results.size() ? ",\n" : "\n");
+    }
+    o << "  ]\n}\n";
+}
@@ -0,0 +1,11 @@
+#ifndef ROPE_BENCH_TRACES_HPP
+#define ROPE_BENCH_TRACES_HPP
+
+#include <cstddef>
+#include <ostream>
+
+// replays the editing traces for every BUFFER_LENGTH tried at document sizes upto max_size, and over every text storage, the
+// results go to o as json
+void trace_bench(std::ostream& o, size_t max_size);
+
+#endif
@@ -7,26 +7,106 @@ I know the way I write code here is bad, I cant have multiple app instances, thi
 */
 
 #include "renderer.hpp"
+#include "text_view.hpp"
 
 #include "core/imgui_utils.hpp"
+#include "core/analyzer.hpp"
+#include "core/search.hpp"
+#include "core/rope.hpp"
 #include "ui.hpp"
 
 #include <cmath>
+#include <string>
+#include <vector>
 
 namespace app {
 
 using namespace renderer;
 
+using rope_type = rope::rope_t<1024>;
+using snapshot_t = rope_type::snapshot_t;
+
 static surface_t screen;
 static font_t font;
 
+// the passes check the stop token every chunk, a stopped pass returns whatever it has, it is thrown away anyway
+static size_t count_words(const snapshot_t& snapshot, std::stop_token stop) {
+    size_t words = 0;
+    bool in_word = false;
+    for (std::string_view chunk : snapshot.chunks()) {
+        if (stop.stop_requested()) break;
+        for (char ch : chunk) {
+            bool space = ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+            words += !space && !in_word;
+            in_word = !space;
+        }
+    }
+    return words;
+}
+
+// offsets of the brackets that dont have a pair
+static std::vector<size_t> unmatched_brackets(const snapshot_t& snapshot, std::stop_token stop) {
+    std::vector<size_t> open, unmatched;
+    std::vector<char> open_chars;
+    auto chunks = snapshot.chunks();
+    for (auto itr = chunks.begin(); itr != chunks.end() && !stop.stop_requested(); ++itr) {
+        std::string_view chunk = *itr;
+        for (size_t i = 0; i < chunk.size(); i++) {
+            char ch = chunk[i];
+            if (ch == '(' || ch == '[' || ch == '{') {
+                open.push_back(itr.offset() + i);
+                open_chars.push_back(ch);
+            } else if (ch == ')' || ch == ']' || ch == '}') {
+                char pair = ch == ')' ? '(' : ch == ']' ? '[' : '{';
+                if (!open_chars.empty() && open_chars.back() == pair) {
+                    open.pop_back();
+                    open_chars.pop_back();
+                } else {
+                    unmatched.push_back(itr.offset() + i);
+                }
+            }
+        }
+    }
+    unmatched.insert(unmatched.end(), open.begin(), open.end());
+    return unmatched;
+}
+
+// the document and the passes analyzing it, the pool is created first and destroyed last, it waits for the runs still stopping
+static core::thread_pool_t *pool;
+static rope_type *document;
+static rope::analyzer_t<rope_type> *analyzer;
+static std::shared_ptr<rope::analysis_pass_t<rope_type, size_t>> word_count;
+static std::shared_ptr<rope::analysis_pass_t<rope_type, std::vector<size_t>>> brackets;
+static std::shared_ptr<rope::analysis_pass_t<rope_type, size_t>> todos;
+static text_view_t view;
+
 app_t *app_t::create() {
     font = create_font(64.f, "../../assets/fonts/static/EBGaramond-Regular.ttf");
     ui::init();
+
+    pool = new core::thread_pool_t;
+    document = new rope_type("int main() {\n    // TODO: say hi\n    return 0;\n}\n");
+    analyzer = new rope::analyzer_t<rope_type>(*pool);
+    word_count = analyzer->add<size_t>(count_words);
+    brackets = analyzer->add<std::vector<size_t>>(unmatched_brackets);
+    todos = analyzer->add<size_t>([search = rope::literal_search_t("TODO")](const snapshot_t& snapshot, std::stop_token stop) {
+        size_t count = 0;
+        search.for_each(snapshot, 0, snapshot.size(), [&](size_t) {
+            count++;
+            return !stop.stop_requested();
+        });
+        return count;
+    });
     return new app_t;
 }    
 
 void app_t::destroy(app_t *app) {
+    word_count.reset();
+    brackets.reset();
+    todos.reset();
+    delete analyzer;
+    delete document;
+    delete pool;
     ui::destroy();
     delete app;
 }      
@@ -34,6 +114,10 @@ void app_t::destroy(app_t *app) {
 void app_t::draw(float dt) {
     screen = get_screen_surface();
 
+    // never waits on the workers, the results shown are the ones that finished by this frame
+    analyzer->update(*document);
+    analyzer->publish();
+
     static float clock = 0;
     clock += dt / 1000.f;
     
@@ -41,6 +125,9 @@ void app_t::draw(float dt) {
 
     draw_text(screen, font, "example text", {1, 1, 1, 1}, {0, 300}, 64.f + (std::sin(clock) * 48.f));
 
+    view.rect = { .position = { 0, 400 }, .size = { screen.size().x, screen.size().y - 400 } };
+    rope::layout_stats_t stats = draw_text_view(screen, font, *document, view);
+
     ui::start_frame(renderer::get_window_ptr());
 
     ui::begin("test");
@@ -50,9 +137,25 @@ void app_t::draw(float dt) {
 
     ui::end_frame(screen);
 
-    imgui_draw_callback([dt]() {
+    imgui_draw_callback([dt, stats]() {
         ImGui::Begin("temp");
         ImGui::Text("%f", dt);
+        if (ImGui::Button("insert")) {
+            std::string text = "void f() { /* TODO */ }\n";
+            document->insert(text.data(), text.size(), document->size());
+        }
+        // the text view should take as long with them as without
+        if (ImGui::Button("insert 1m lines")) {
+            std::string text;
+            for (size_t i = 0; i < 1000000; i++) text += "\tint value = " + std::to_string(i) + ";\n";
+            document->insert(text.data(), text.size(), document->size());
+        }
+        ImGui::DragFloat2("scroll", &view.scroll.x, 4.f, 0.f, 1e9f);
+        ImGui::Text("lines %zu to %zu, %zu glyphs from %zu bytes", stats.first_line, stats.first_line + stats.lines, stats.glyphs, stats.bytes);
+        ImGui::Text("version %llu", (unsigned long long)analyzer->version());
+        if (word_count->result()) ImGui::Text("words %zu (version %llu)", *word_count->result(), (unsigned long long)word_count->version());
+        if (brackets->result()) ImGui::Text("unmatched brackets %zu", brackets->result()->size());
+        if (todos->result()) ImGui::Text("todos %zu", *todos->result());
         ImGui::End();
     });
 }
@@ -17,6 +17,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <msdf-atlas-gen/msdf-atlas-gen.h>
 
+#include <deque>
+#include <cstring>
+
 namespace renderer {
 
 struct glyph_data_t {
@@ -63,6 +66,7 @@ struct command_draw_text_t {
     surface_t surface;
     font_t font;
     const char *text;
+    size_t size;
     glm::vec4 color;
     glm::vec2 position;
     float font_size;
@@ -144,6 +148,7 @@ struct renderer_data_t {
     uint32_t _pipeline_swaps = 0;
 
     std::vector<command_t> _commands;
+    std::deque<std::string> _command_texts;  // copies of the text drawn this frame, a deque so they never move
 
     surface_t _screen_surface;
 
@@ -402,6 +407,14 @@ float font_t::line_height(float target_font_size) const {
     return _line_height * target_font_size;
 }
 
+float font_t::advance(char ch, float target_font_size) const {
+    VIZON_PROFILE_FUNCTION();
+    assert(s_renderer_data._initialized);
+    auto glyph = geometry().getGlyph(ch);
+    if (!glyph) return 0;
+    return glyph->getAdvance() * target_font_size;
+}
+
 surface_t create_surface(const glm::vec2& size) {
     VIZON_PROFILE_FUNCTION();
     assert(s_renderer_data._initialized);
@@ -675,6 +688,7 @@ glm::vec2 draw_text(const surface_t& surface, const font_t& font, const char *te
     draw_text.surface = surface;
     draw_text.font = font;
     draw_text.text = text;
+    draw_text.size = std::strlen(text);
     draw_text.color = color;
     draw_text.position = position;
     draw_text.font_size = font_size;
@@ -684,51 +698,24 @@ glm::vec2 draw_text(const surface_t& surface, const font_t& font, const char *te
     float target_font_size = draw_text.font_size;
     double x_pos = draw_text.position.x;
     double y_pos = draw_text.position.y;
-    double scale = target_font_size / draw_text.font._original_font_size;   
 
-    size_t index = 0;
-    while (draw_text.text[index]) {
+    for (size_t index = 0; index < draw_text.size; index++) {
         auto glyph = draw_text.font.geometry().getGlyph(draw_text.text[index]);
         assert(glyph);
-        auto glyph_data = _get_data_from_glyph(glyph, draw_text.font._original_font_size);
-
-        double x0 = x_pos + glyph_data.plane_bounds.x * target_font_size;
-        double y0 = y_pos - glyph_data.plane_bounds.y * target_font_size;
-
-        auto [atlas_width, atlas_height] = draw_text.font.atlas()->dimensions();
-
-        double s0 = glyph_data.atlas_bounds.x / float(atlas_width);
-        double t0 = glyph_data.atlas_bounds.w / float(atlas_height);
-        double s1 = glyph_data.atlas_bounds.z / float(atlas_width);
-        double t1 = glyph_data.atlas_bounds.y / float(atlas_height);
-
-        rect_t rect{};
-        glm::vec2 pos = glm::vec2{ x0, y0 + std::round(draw_text.font._max_height * scale) - (glyph_data.height * scale)};
-        rect.position = pos;
-        rect.size = { glyph_data.width * scale, glyph_data.height * scale };
-        rect = _transform_coordinate_system(surface, rect);
-        text_push_constant_t push{};
-        transform_2d_t transform{};
-        transform.position = { rect.position, 0 };
-        transform.scale = rect.size;
-        push.model_matrix = transform.matrix();
-        push.color = draw_text.color;
-
-        float texel_width = 1.0f / float(atlas_width);
-        float texel_height = 1.0f / float(atlas_height);
-        glm::vec2 texel_dims(texel_width, texel_height);
-
-        push.tex_coord_min = glm::vec2{ glyph_data.atlas_bounds.x, glyph_data.atlas_bounds.y } * texel_dims;
-        push.tex_coord_max = glm::vec2{ glyph_data.atlas_bounds.z, glyph_data.atlas_bounds.w } * texel_dims;
-
-        double advance = glyph_data.advance_x * target_font_size;
+        double advance = glyph->getAdvance() * target_font_size;
         x_pos += advance;
-        index++;
     }
 
     return {x_pos, y_pos};
 }
 
+glm::vec2 draw_text(const surface_t& surface, const font_t& font, std::string_view text, const glm::vec4& color, const glm::vec2& position, float font_size) {
+    VIZON_PROFILE_FUNCTION();
+    assert(s_renderer_data._initialized);
+    const std::string& copy = s_renderer_data._command_texts.emplace_back(text);
+    return draw_text(surface, font, copy.c_str(), color, position, font_size);
+}
+
 void imgui_draw_callback(std::function<void(void)> fn) {
     VIZON_PROFILE_FUNCTION();
     assert(s_renderer_data._initialized);
@@ -932,8 +919,7 @@ void _command_draw_text(VkCommandBuffer commandbuffer, const command_draw_text_t
     double y_pos = draw_text.position.y;
     double scale = target_font_size / draw_text.font._original_font_size;   
 
-    size_t index = 0;
-    while (draw_text.text[index]) {
+    for (size_t index = 0; index < draw_text.size; index++) {
         auto glyph = draw_text.font.geometry().getGlyph(draw_text.text[index]);
         assert(glyph);
         auto glyph_data = _get_data_from_glyph(glyph, draw_text.font._original_font_size);
@@ -971,7 +957,6 @@ void _command_draw_text(VkCommandBuffer commandbuffer, const command_draw_text_t
         vkCmdDraw(commandbuffer, 6, 1, 0, 0);
         double advance = glyph_data.advance_x * target_font_size;
         x_pos += advance;
-        index++;
     }
 }
 
@@ -1069,6 +1054,7 @@ void render() {
         s_renderer_data._gfx_context->end_frame(commandbuffer);
 
         s_renderer_data._commands.clear();
+        s_renderer_data._command_texts.clear();
         s_renderer_data._imgui_draw_callbacks.clear();
         s_renderer_data._surface_swaps = 0;
         s_renderer_data._pipeline_swaps = 0;
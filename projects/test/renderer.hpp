@@ -9,6 +9,7 @@
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdint.h>
 
 // forward declaration
@@ -84,6 +85,8 @@ struct font_t {
     core::ref<gfx::vulkan::image_t> atlas() const;
     core::ref<gfx::vulkan::descriptor_set_t> descriptor_set() const;
     float line_height(float target_font_size) const;
+    // how far the pen moves after ch, 0 if the font doesnt have it
+    float advance(char ch, float target_font_size) const;
 
     uint32_t _font_id;
     float _original_font_size;
@@ -103,6 +106,8 @@ void draw_circle(const surface_t& surface, const circle_t& circle, const glm::ve
 void fill_surface(const surface_t& surface, const glm::vec4& color);
 void draw_surface(const surface_t& surface, const surface_t& other_surface, const rect_t& rect);
 glm::vec2 draw_text(const surface_t& surface, const font_t& font, const char *text, const glm::vec4& color, const glm::vec2& position, float font_size = 1.f);  // str should be /0 terminated
+// text is copied till the frame is rendered, so it can point into something that changes before that (ex: a chunk of a rope)
+glm::vec2 draw_text(const surface_t& surface, const font_t& font, std::string_view text, const glm::vec4& color, const glm::vec2& position, float font_size = 1.f);
 // void draw_text(const surface_t& surface, const font_t& font, const char *str, const glm::vec4& color, const glm::vec2& position, float scale = 1.f)
 
 void imgui_draw_callback(std::function<void(void)> fn);
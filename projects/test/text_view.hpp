@@ -0,0 +1,42 @@
+#ifndef TEXT_VIEW_HPP
+#define TEXT_VIEW_HPP
+
+#include "renderer.hpp"
+
+#include "core/text_layout.hpp"
+
+namespace renderer {
+
+// a window into a rope (or a snapshot of one), drawn straight from its chunks, see rope::layout_visible_lines()
+// the document is never copied out as a whole, only the glyphs of the lines on screen are, so a frame costs the same whatever the
+// size of the file
+struct text_view_t {
+    rect_t rect;  // on the surface
+    glm::vec2 scroll{ 0, 0 };  // pixels, from the top left of the document
+    float font_size = 24.f;
+    glm::vec4 color{ 1, 1, 1, 1 };
+    uint32_t tab_width = 4;
+};
+
+// text has to be indexed
+template <typename text_t>
+rope::layout_stats_t draw_text_view(const surface_t& surface, const font_t& font, const text_t& text, const text_view_t& view) {
+    rope::viewport_t viewport{
+        .scroll_x = view.scroll.x,
+        .scroll_y = view.scroll.y,
+        .width = view.rect.size.x,
+        .height = view.rect.size.y,
+        .line_height = font.line_height(view.font_size),
+        .tab_width = view.tab_width,
+    };
+    // ascii only, so a table is cheaper than asking the font for every glyph
+    float advances[128];
+    for (int ch = 0; ch < 128; ch++) advances[ch] = font.advance(char(ch), view.font_size);
+    return rope::layout_visible_lines(text, viewport, [&](char ch) { return advances[static_cast<unsigned char>(ch) & 0x7f]; }, [&](const rope::glyph_run_t& run) {
+        draw_text(surface, font, run.glyphs, view.color, view.rect.position + glm::vec2{ run.x, run.y }, view.font_size);
+    });
+}
+
+} // namespace renderer
+
+#endif